@@ -0,0 +1,990 @@
+﻿//------------------------------------------
+//	AllocationProfiler.hpp
+//	Copyright (c) 2014 Reputeless
+//	<reputeless@gmail.com>
+//	Distributed under the MIT license.
+//------------------------------------------
+//
+//	Opt-in: in exactly one translation unit,
+//
+//		# define SIV_ALLOCATION_PROFILER_IMPLEMENTATION	// replaces global operator new / delete
+//		# define SIV_ALLOCATION_PROFILER_HOOK_MALLOC		// also replaces malloc / free (glibc)
+//		# include <siv/AllocationProfiler.hpp>
+//
+//	and call siv::SetAllocationProfiling(true).
+//
+
+# pragma once
+# include <cstdlib>
+# include <cstring>
+# include <cstdint>
+# include <atomic>
+# include <new>
+# include <string>
+# include <vector>
+# include <algorithm>
+# include <ostream>
+# include <cstdio>
+# include <cerrno>
+# include <thread>
+# include "ProfileZone.hpp"
+# include "LatencyHistogram.hpp"
+
+# if defined(__APPLE__)
+#	include <malloc/malloc.h>
+# else
+#	include <malloc.h>
+# endif
+
+# ifndef SIV_ALLOCATION_MAX_THREADS
+#	define SIV_ALLOCATION_MAX_THREADS 256
+# endif
+
+// zones tracked per thread; must be a power of two
+# ifndef SIV_ALLOCATION_MAX_ZONES
+#	define SIV_ALLOCATION_MAX_ZONES 128
+# endif
+
+namespace siv
+{
+	//
+	//	Counters of one zone on one thread. Written only by the owning thread
+	//	(relaxed load + store, no locked instruction); read by reporters.
+	//
+	struct AllocationCounters
+	{
+		std::atomic<const char*> zone;
+
+		std::atomic<unsigned long long> allocations;
+
+		std::atomic<unsigned long long> frees;
+
+		std::atomic<unsigned long long> bytesAllocated;
+
+		std::atomic<unsigned long long> bytesFreed;
+
+		// net bytes allocated by the zone on this thread, and its maximum
+		std::atomic<long long> liveBytes;
+
+		std::atomic<long long> peakBytes;
+	};
+
+	namespace detail
+	{
+		template <class Type>
+		inline void AddRelaxed(std::atomic<Type>& counter, Type value)
+		{
+			counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+		}
+
+		//
+		//	Zone table of one thread: open addressing on the zone's string literal, index 0 is "no zone"
+		//
+		struct ThreadAllocationTable
+		{
+			// owned by a running thread; released tables are zeroed and reused
+			std::atomic<bool> inUse;
+
+			AllocationCounters zones[SIV_ALLOCATION_MAX_ZONES];
+
+			// local change of the live heap not yet published to the global counter
+			long long pendingLiveBytes;
+
+			AllocationCounters& find(const char* zone)
+			{
+				if (!zone)
+				{
+					return zones[0];
+				}
+
+				size_t index = (reinterpret_cast<std::uintptr_t>(zone) >> 3) & (SIV_ALLOCATION_MAX_ZONES - 1);
+
+				for (size_t probe = 0; probe < SIV_ALLOCATION_MAX_ZONES; ++probe, index = (index + 1) & (SIV_ALLOCATION_MAX_ZONES - 1))
+				{
+					if (index == 0)
+					{
+						continue;
+					}
+
+					const char* key = zones[index].zone.load(std::memory_order_relaxed);
+
+					if (key == zone)
+					{
+						return zones[index];
+					}
+
+					if (!key)
+					{
+						zones[index].zone.store(zone, std::memory_order_release);
+
+						return zones[index];
+					}
+				}
+
+				// table full: count as "no zone"
+				return zones[0];
+			}
+		};
+
+		//
+		//	Static pool: claiming a table never allocates, so it is safe inside operator new.
+		//	A thread's table returns to the pool when the thread exits, its totals folded into retired.
+		//
+		struct AllocationProfilerState
+		{
+			std::atomic<bool> enabled;
+
+			std::atomic<long long> liveBytes;
+
+			std::atomic<long long> peakLiveBytes;
+
+			// allocations while all SIV_ALLOCATION_MAX_THREADS tables are owned by running threads
+			std::atomic<unsigned long long> untrackedAllocations;
+
+			// guards retired and table release against reporters; never taken on the allocation path of a live thread
+			std::atomic<bool> retireLock;
+
+			ThreadAllocationTable retired;
+
+			ThreadAllocationTable threads[SIV_ALLOCATION_MAX_THREADS];
+		};
+
+		class AllocationRetireLock
+		{
+		public:
+
+			explicit AllocationRetireLock(AllocationProfilerState& state)
+				: m_state(state)
+			{
+				while (m_state.retireLock.exchange(true, std::memory_order_acquire))
+				{
+					std::this_thread::yield();
+				}
+			}
+
+			~AllocationRetireLock()
+			{
+				m_state.retireLock.store(false, std::memory_order_release);
+			}
+
+			AllocationRetireLock(const AllocationRetireLock&) = delete;
+
+			AllocationRetireLock& operator=(const AllocationRetireLock&) = delete;
+
+		private:
+
+			AllocationProfilerState& m_state;
+		};
+
+		inline AllocationProfilerState& GetAllocationProfilerState()
+		{
+			// zero-initialized static storage; no constructor runs
+			static AllocationProfilerState state;
+
+			return state;
+		}
+
+		struct ThreadAllocationContext
+		{
+			ThreadAllocationTable* table;
+
+			bool claimed;
+
+			// the table went back to the pool: events of the exiting thread go to retired
+			bool released;
+
+			bool reentered;
+		};
+
+		inline ThreadAllocationContext& GetThreadAllocationContext()
+		{
+			static thread_local ThreadAllocationContext context;
+
+			return context;
+		}
+
+		// published to the global live counter in batches, so the global high-water mark is
+		// exact to within this many bytes per thread
+		const long long LiveBytesBatch = 64 * 1024;
+
+		inline void PublishLiveBytes(AllocationProfilerState& state, ThreadAllocationTable& table)
+		{
+			const long long live = state.liveBytes.fetch_add(table.pendingLiveBytes, std::memory_order_relaxed) + table.pendingLiveBytes;
+
+			table.pendingLiveBytes = 0;
+
+			long long peak = state.peakLiveBytes.load(std::memory_order_relaxed);
+
+			while (live > peak && !state.peakLiveBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {}
+		}
+
+		inline void CountAllocationEvent(AllocationCounters& counters, long long bytes)
+		{
+			if (bytes >= 0)
+			{
+				AddRelaxed(counters.allocations, 1ULL);
+
+				AddRelaxed(counters.bytesAllocated, static_cast<unsigned long long>(bytes));
+			}
+			else
+			{
+				AddRelaxed(counters.frees, 1ULL);
+
+				AddRelaxed(counters.bytesFreed, static_cast<unsigned long long>(-bytes));
+			}
+
+			const long long live = counters.liveBytes.load(std::memory_order_relaxed) + bytes;
+
+			counters.liveBytes.store(live, std::memory_order_relaxed);
+
+			if (live > counters.peakBytes.load(std::memory_order_relaxed))
+			{
+				counters.peakBytes.store(live, std::memory_order_relaxed);
+			}
+		}
+
+		//
+		//	Folds the exiting thread's counters into retired and returns its table to the pool
+		//
+		inline void ReleaseThreadAllocationTable()
+		{
+			AllocationProfilerState& state = GetAllocationProfilerState();
+
+			ThreadAllocationContext& context = GetThreadAllocationContext();
+
+			ThreadAllocationTable* table = context.table;
+
+			if (!table)
+			{
+				return;
+			}
+
+			// allocations made while folding are the pool's own business
+			const bool reentered = context.reentered;
+
+			context.reentered = true;
+
+			{
+				AllocationRetireLock lock(state);
+
+				for (auto& counters : table->zones)
+				{
+					const unsigned long long allocations = counters.allocations.load(std::memory_order_relaxed);
+
+					const unsigned long long frees = counters.frees.load(std::memory_order_relaxed);
+
+					if (allocations || frees)
+					{
+						AllocationCounters& retired = state.retired.find(counters.zone.load(std::memory_order_relaxed));
+
+						AddRelaxed(retired.allocations, allocations);
+						AddRelaxed(retired.frees, frees);
+						AddRelaxed(retired.bytesAllocated, counters.bytesAllocated.load(std::memory_order_relaxed));
+						AddRelaxed(retired.bytesFreed, counters.bytesFreed.load(std::memory_order_relaxed));
+						AddRelaxed(retired.liveBytes, counters.liveBytes.load(std::memory_order_relaxed));
+
+						retired.peakBytes.store(std::max(retired.peakBytes.load(std::memory_order_relaxed),
+							counters.peakBytes.load(std::memory_order_relaxed)), std::memory_order_relaxed);
+					}
+
+					counters.zone.store(nullptr, std::memory_order_relaxed);
+					counters.allocations.store(0, std::memory_order_relaxed);
+					counters.frees.store(0, std::memory_order_relaxed);
+					counters.bytesAllocated.store(0, std::memory_order_relaxed);
+					counters.bytesFreed.store(0, std::memory_order_relaxed);
+					counters.liveBytes.store(0, std::memory_order_relaxed);
+					counters.peakBytes.store(0, std::memory_order_relaxed);
+				}
+
+				PublishLiveBytes(state, *table);
+			}
+
+			table->inUse.store(false, std::memory_order_release);
+
+			context.table = nullptr;
+
+			context.released = true;
+
+			context.reentered = reentered;
+		}
+
+		struct ThreadAllocationTableReleaser
+		{
+			~ThreadAllocationTableReleaser()
+			{
+				ReleaseThreadAllocationTable();
+			}
+		};
+
+		inline ThreadAllocationTable* ClaimThreadAllocationTable(AllocationProfilerState& state, ThreadAllocationContext& context)
+		{
+			if (!context.claimed)
+			{
+				context.claimed = true;
+
+				for (auto& table : state.threads)
+				{
+					bool expected = false;
+
+					if (!table.inUse.load(std::memory_order_relaxed)
+						&& table.inUse.compare_exchange_strong(expected, true, std::memory_order_acquire))
+					{
+						context.table = &table;
+
+						break;
+					}
+				}
+
+				if (context.table)
+				{
+					// registering the exit hook may allocate; the caller has set reentered
+					static thread_local ThreadAllocationTableReleaser releaser;
+
+					(void)releaser;
+				}
+			}
+
+			return context.table;
+		}
+
+		inline void RecordAllocationEvent(long long bytes)
+		{
+			AllocationProfilerState& state = GetAllocationProfilerState();
+
+			if (!state.enabled.load(std::memory_order_relaxed))
+			{
+				return;
+			}
+
+			ThreadAllocationContext& context = GetThreadAllocationContext();
+
+			if (context.reentered)
+			{
+				return;
+			}
+
+			context.reentered = true;
+
+			const ZoneBuffer* buffer = ThreadZoneBufferPtr();
+
+			const char* zone = buffer ? buffer->currentZone() : nullptr;
+
+			if (ThreadAllocationTable* table = ClaimThreadAllocationTable(state, context))
+			{
+				CountAllocationEvent(table->find(zone), bytes);
+
+				table->pendingLiveBytes += bytes;
+
+				if (table->pendingLiveBytes >= LiveBytesBatch || table->pendingLiveBytes <= -LiveBytesBatch)
+				{
+					PublishLiveBytes(state, *table);
+				}
+			}
+			else if (context.released)
+			{
+				// thread-exit destructors running after the table was released
+				AllocationRetireLock lock(state);
+
+				CountAllocationEvent(state.retired.find(zone), bytes);
+
+				state.retired.pendingLiveBytes += bytes;
+
+				PublishLiveBytes(state, state.retired);
+			}
+			else
+			{
+				state.untrackedAllocations.fetch_add(bytes >= 0, std::memory_order_relaxed);
+			}
+
+			context.reentered = false;
+		}
+
+		inline size_t UsableSize(void* p)
+		{
+#if defined(_MSC_VER)
+
+			return ::_msize(p);
+
+#elif defined(__APPLE__)
+
+			return ::malloc_size(p);
+
+#else
+
+			return ::malloc_usable_size(p);
+
+#endif
+		}
+	}
+
+	inline void SetAllocationProfiling(bool enabled)
+	{
+		detail::GetAllocationProfilerState().enabled.store(enabled);
+	}
+
+	inline bool IsAllocationProfilingEnabled()
+	{
+		return detail::GetAllocationProfilerState().enabled.load();
+	}
+
+	//
+	//	Called by the replaced allocation functions; also usable by custom allocators
+	//
+	inline void RecordAllocation(void* p)
+	{
+		if (p)
+		{
+			detail::RecordAllocationEvent(static_cast<long long>(detail::UsableSize(p)));
+		}
+	}
+
+	inline void RecordFree(void* p)
+	{
+		if (p)
+		{
+			detail::RecordAllocationEvent(-static_cast<long long>(detail::UsableSize(p)));
+		}
+	}
+
+	struct AllocationReport
+	{
+		std::string zone;
+
+		unsigned long long allocations = 0;
+
+		unsigned long long frees = 0;
+
+		unsigned long long bytesAllocated = 0;
+
+		unsigned long long bytesFreed = 0;
+
+		// largest net bytes the zone held on one thread
+		long long peakBytes = 0;
+	};
+
+	//
+	//	Per-zone totals over every thread, most allocations first; allocations outside any zone are "(none)"
+	//
+	inline std::vector<AllocationReport> GetAllocationReports()
+	{
+		detail::AllocationProfilerState& state = detail::GetAllocationProfilerState();
+
+		std::vector<AllocationReport> reports;
+
+		// the report's own allocations are not counted, and must not take the retire lock again
+		detail::ThreadAllocationContext& context = detail::GetThreadAllocationContext();
+
+		const bool reentered = context.reentered;
+
+		context.reentered = true;
+
+		{
+			detail::AllocationRetireLock lock(state);
+
+			std::vector<const detail::ThreadAllocationTable*> tables(1, &state.retired);
+
+			for (const auto& table : state.threads)
+			{
+				if (table.inUse.load(std::memory_order_acquire))
+				{
+					tables.push_back(&table);
+				}
+			}
+
+			for (const auto* table : tables)
+			{
+				for (const auto& counters : table->zones)
+				{
+					const unsigned long long allocations = counters.allocations.load(std::memory_order_relaxed);
+
+					const unsigned long long frees = counters.frees.load(std::memory_order_relaxed);
+
+					if (allocations == 0 && frees == 0)
+					{
+						continue;
+					}
+
+					const char* zone = counters.zone.load(std::memory_order_acquire);
+
+					const std::string name = zone ? zone : "(none)";
+
+					auto it = std::find_if(reports.begin(), reports.end(), [&](const AllocationReport& r)
+					{
+						return r.zone == name;
+					});
+
+					if (it == reports.end())
+					{
+						reports.emplace_back();
+
+						it = reports.end() - 1;
+
+						it->zone = name;
+					}
+
+					it->allocations += allocations;
+					it->frees += frees;
+					it->bytesAllocated += counters.bytesAllocated.load(std::memory_order_relaxed);
+					it->bytesFreed += counters.bytesFreed.load(std::memory_order_relaxed);
+					it->peakBytes = std::max(it->peakBytes, counters.peakBytes.load(std::memory_order_relaxed));
+				}
+			}
+		}
+
+		context.reentered = reentered;
+
+		std::sort(reports.begin(), reports.end(), [](const AllocationReport& a, const AllocationReport& b)
+		{
+			return a.allocations > b.allocations;
+		});
+
+		return reports;
+	}
+
+	//
+	//	Process-wide live heap and its high-water mark (batched; see detail::LiveBytesBatch)
+	//
+	inline long long GetLiveHeapBytes()
+	{
+		return detail::GetAllocationProfilerState().liveBytes.load();
+	}
+
+	inline long long GetPeakHeapBytes()
+	{
+		return detail::GetAllocationProfilerState().peakLiveBytes.load();
+	}
+
+	//
+	//	Latency percentiles and allocation counts side by side, joined on the zone name
+	//
+	inline void WriteZoneReport(std::ostream& os, const std::vector<LatencyReport>& latencies, const std::vector<AllocationReport>& allocations)
+	{
+		os << "zone\tcount\tp50(us)\tp99(us)\tallocs\tallocs/call\tbytes\tpeak bytes\n";
+
+		std::vector<std::string> names;
+
+		for (const auto& l : latencies)
+		{
+			names.push_back(l.name);
+		}
+
+		for (const auto& a : allocations)
+		{
+			if (std::find(names.begin(), names.end(), a.zone) == names.end())
+			{
+				names.push_back(a.zone);
+			}
+		}
+
+		for (const auto& name : names)
+		{
+			const auto l = std::find_if(latencies.begin(), latencies.end(), [&](const LatencyReport& r) { return r.name == name; });
+
+			const auto a = std::find_if(allocations.begin(), allocations.end(), [&](const AllocationReport& r) { return r.zone == name; });
+
+			char line[256];
+
+			std::snprintf(line, sizeof(line), "\t%llu\t%.1f\t%.1f\t%llu\t%.2f\t%llu\t%lld\n",
+				l != latencies.end() ? l->count : 0ULL,
+				l != latencies.end() ? l->p50 / 1000.0 : 0.0,
+				l != latencies.end() ? l->p99 / 1000.0 : 0.0,
+				a != allocations.end() ? a->allocations : 0ULL,
+				(a != allocations.end() && l != latencies.end() && l->count) ? static_cast<double>(a->allocations) / l->count : 0.0,
+				a != allocations.end() ? a->bytesAllocated : 0ULL,
+				a != allocations.end() ? a->peakBytes : 0LL);
+
+			os << name << line;
+		}
+	}
+}
+
+# if defined(SIV_ALLOCATION_PROFILER_IMPLEMENTATION)
+
+#	if defined(SIV_ALLOCATION_PROFILER_HOOK_MALLOC) && defined(__GLIBC__)
+
+extern "C"
+{
+	void* __libc_malloc(size_t);
+	void* __libc_calloc(size_t, size_t);
+	void* __libc_realloc(void*, size_t);
+	void* __libc_memalign(size_t, size_t);
+	void __libc_free(void*);
+
+	void* malloc(size_t size)
+	{
+		void* p = __libc_malloc(size);
+
+		siv::RecordAllocation(p);
+
+		return p;
+	}
+
+	void* calloc(size_t count, size_t size)
+	{
+		void* p = __libc_calloc(count, size);
+
+		siv::RecordAllocation(p);
+
+		return p;
+	}
+
+	void* realloc(void* old, size_t size)
+	{
+		siv::RecordFree(old);
+
+		void* p = __libc_realloc(old, size);
+
+		if (p)
+		{
+			siv::RecordAllocation(p);
+		}
+		else if (old && size)
+		{
+			// realloc failed: the old block is still allocated
+			siv::RecordAllocation(old);
+		}
+
+		return p;
+	}
+
+	void* memalign(size_t alignment, size_t size)
+	{
+		void* p = __libc_memalign(alignment, size);
+
+		siv::RecordAllocation(p);
+
+		return p;
+	}
+
+	void* aligned_alloc(size_t alignment, size_t size)
+	{
+		return memalign(alignment, size);
+	}
+
+	int posix_memalign(void** result, size_t alignment, size_t size)
+	{
+		if (alignment < sizeof(void*) || (alignment & (alignment - 1)))
+		{
+			return EINVAL;
+		}
+
+		void* p = memalign(alignment, size);
+
+		if (!p)
+		{
+			return ENOMEM;
+		}
+
+		*result = p;
+
+		return 0;
+	}
+
+	void free(void* p)
+	{
+		siv::RecordFree(p);
+
+		__libc_free(p);
+	}
+}
+
+namespace siv
+{
+	namespace detail
+	{
+		// operator new goes straight to glibc; the malloc hook would otherwise count it twice
+		inline void* RawAllocate(size_t size)
+		{
+			return __libc_malloc(size);
+		}
+
+		inline void RawFree(void* p)
+		{
+			__libc_free(p);
+		}
+
+		inline void* RawAllocateAligned(size_t size, size_t alignment)
+		{
+			return __libc_memalign(alignment, size);
+		}
+
+		inline void RawFreeAligned(void* p)
+		{
+			__libc_free(p);
+		}
+	}
+}
+
+#	else
+
+namespace siv
+{
+	namespace detail
+	{
+		inline void* RawAllocate(size_t size)
+		{
+			return std::malloc(size);
+		}
+
+		inline void RawFree(void* p)
+		{
+			std::free(p);
+		}
+
+		inline void* RawAllocateAligned(size_t size, size_t alignment)
+		{
+#if defined(_MSC_VER)
+
+			return ::_aligned_malloc(size, alignment);
+
+#else
+
+			void* p = nullptr;
+
+			return ::posix_memalign(&p, alignment, size) == 0 ? p : nullptr;
+
+#endif
+		}
+
+		inline void RawFreeAligned(void* p)
+		{
+#if defined(_MSC_VER)
+
+			::_aligned_free(p);
+
+#else
+
+			std::free(p);
+
+#endif
+		}
+	}
+}
+
+#	endif
+
+namespace siv
+{
+	namespace detail
+	{
+		inline void* ProfiledNew(size_t size)
+		{
+			for (;;)
+			{
+				if (void* p = RawAllocate(size ? size : 1))
+				{
+					RecordAllocation(p);
+
+					return p;
+				}
+
+				std::new_handler handler = std::get_new_handler();
+
+				if (!handler)
+				{
+					throw std::bad_alloc();
+				}
+
+				handler();
+			}
+		}
+
+		inline void ProfiledDelete(void* p)
+		{
+			RecordFree(p);
+
+			RawFree(p);
+		}
+
+#if defined(__cpp_aligned_new)
+
+		// _msize does not understand _aligned_malloc blocks
+		inline long long AlignedUsableSize(void* p, size_t alignment)
+		{
+#if defined(_MSC_VER)
+
+			return static_cast<long long>(::_aligned_msize(p, alignment, 0));
+
+#else
+
+			(void)alignment;
+
+			return static_cast<long long>(UsableSize(p));
+
+#endif
+		}
+
+		inline void* ProfiledAlignedNew(size_t size, std::align_val_t alignment)
+		{
+			for (;;)
+			{
+				if (void* p = RawAllocateAligned(size ? size : 1, static_cast<size_t>(alignment)))
+				{
+					RecordAllocationEvent(AlignedUsableSize(p, static_cast<size_t>(alignment)));
+
+					return p;
+				}
+
+				std::new_handler handler = std::get_new_handler();
+
+				if (!handler)
+				{
+					throw std::bad_alloc();
+				}
+
+				handler();
+			}
+		}
+
+		inline void ProfiledAlignedDelete(void* p, std::align_val_t alignment)
+		{
+			if (p)
+			{
+				RecordAllocationEvent(-AlignedUsableSize(p, static_cast<size_t>(alignment)));
+			}
+
+			RawFreeAligned(p);
+		}
+
+#endif
+	}
+}
+
+void* operator new(size_t size)
+{
+	return siv::detail::ProfiledNew(size);
+}
+
+void* operator new[](size_t size)
+{
+	return siv::detail::ProfiledNew(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+	try
+	{
+		return siv::detail::ProfiledNew(size);
+	}
+	catch (...)
+	{
+		return nullptr;
+	}
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+	try
+	{
+		return siv::detail::ProfiledNew(size);
+	}
+	catch (...)
+	{
+		return nullptr;
+	}
+}
+
+void operator delete(void* p) noexcept
+{
+	siv::detail::ProfiledDelete(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+	siv::detail::ProfiledDelete(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept
+{
+	siv::detail::ProfiledDelete(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept
+{
+	siv::detail::ProfiledDelete(p);
+}
+
+#	if defined(__cpp_sized_deallocation)
+
+void operator delete(void* p, size_t) noexcept
+{
+	siv::detail::ProfiledDelete(p);
+}
+
+void operator delete[](void* p, size_t) noexcept
+{
+	siv::detail::ProfiledDelete(p);
+}
+
+#	endif
+
+#	if defined(__cpp_aligned_new)
+
+// over-aligned types (alignas(64) and up) bypass the plain forms
+void* operator new(size_t size, std::align_val_t alignment)
+{
+	return siv::detail::ProfiledAlignedNew(size, alignment);
+}
+
+void* operator new[](size_t size, std::align_val_t alignment)
+{
+	return siv::detail::ProfiledAlignedNew(size, alignment);
+}
+
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	try
+	{
+		return siv::detail::ProfiledAlignedNew(size, alignment);
+	}
+	catch (...)
+	{
+		return nullptr;
+	}
+}
+
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	try
+	{
+		return siv::detail::ProfiledAlignedNew(size, alignment);
+	}
+	catch (...)
+	{
+		return nullptr;
+	}
+}
+
+void operator delete(void* p, std::align_val_t alignment) noexcept
+{
+	siv::detail::ProfiledAlignedDelete(p, alignment);
+}
+
+void operator delete[](void* p, std::align_val_t alignment) noexcept
+{
+	siv::detail::ProfiledAlignedDelete(p, alignment);
+}
+
+void operator delete(void* p, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	siv::detail::ProfiledAlignedDelete(p, alignment);
+}
+
+void operator delete[](void* p, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	siv::detail::ProfiledAlignedDelete(p, alignment);
+}
+
+void operator delete(void* p, size_t, std::align_val_t alignment) noexcept
+{
+	siv::detail::ProfiledAlignedDelete(p, alignment);
+}
+
+void operator delete[](void* p, size_t, std::align_val_t alignment) noexcept
+{
+	siv::detail::ProfiledAlignedDelete(p, alignment);
+}
+
+#	endif
+
+# endif
@@ -0,0 +1,668 @@
+﻿//------------------------------------------
+//	AsyncSpan.hpp
+//	Copyright (c) 2014 Reputeless
+//	<reputeless@gmail.com>
+//	Distributed under the MIT license.
+//------------------------------------------
+
+# pragma once
+# include <cstdint>
+# include <cstdio>
+# include <string>
+# include <vector>
+# include <memory>
+# include <atomic>
+# include <mutex>
+# include <algorithm>
+# include <unordered_map>
+# include <ostream>
+# include "ProfileZone.hpp"
+# include "TraceExport.hpp"
+
+# ifndef SIV_SPAN_BUFFER_CAPACITY
+#	define SIV_SPAN_BUFFER_CAPACITY 4096
+# endif
+
+namespace siv
+{
+	enum class SpanKind : std::uint8_t
+	{
+		Work,
+
+		// waiting in a queue or for a hand-off; reported separately on the critical path
+		Queue,
+	};
+
+	//
+	//	What a child span needs from its parent; cheap to copy into a task or message
+	//
+	struct SpanContext
+	{
+		// span id of the request's root span
+		std::uint64_t traceId = 0;
+
+		std::uint64_t spanId = 0;
+
+		explicit operator bool() const
+		{
+			return spanId != 0;
+		}
+	};
+
+	//
+	//	Timestamps are TSC ticks, as RDTSCClock; spans crossing cores assume an invariant, synchronized TSC (see GetTSCInfo)
+	//
+	struct SpanRecord
+	{
+		const char* name;
+
+		std::uint64_t traceId;
+
+		std::uint64_t spanId;
+
+		// 0 for a root span
+		std::uint64_t parentId;
+
+		unsigned long long begin;
+
+		unsigned long long end;
+
+		// thread indices (see detail::SpanThreadIndex) of the threads that opened and closed the span
+		unsigned beginThread;
+
+		unsigned endThread;
+
+		SpanKind kind;
+	};
+
+	namespace detail
+	{
+		//
+		//	Unique, nonzero ids: each thread takes blocks of 4096 from a shared counter
+		//
+		inline std::uint64_t NextSpanId()
+		{
+			static std::atomic<std::uint64_t> source{ 1 };
+
+			static thread_local std::uint64_t next = 0, last = 0;
+
+			if (next == last)
+			{
+				next = source.fetch_add(4096, std::memory_order_relaxed);
+
+				last = next + 4096;
+			}
+
+			return next++;
+		}
+
+		//
+		//	Single-producer / single-consumer ring of ended spans, as ZoneBuffer: written by one thread, drained by collect()
+		//
+		class SpanBuffer
+		{
+		public:
+
+			static const size_t Capacity = SIV_SPAN_BUFFER_CAPACITY;
+
+			static_assert((Capacity & (Capacity - 1)) == 0, "SIV_SPAN_BUFFER_CAPACITY must be a power of two");
+
+			SpanBuffer() = default;
+
+			SpanBuffer(const SpanBuffer&) = delete;
+
+			SpanBuffer& operator=(const SpanBuffer&) = delete;
+
+			void push(const SpanRecord& record)
+			{
+				const size_t head = m_head.load(std::memory_order_relaxed);
+
+				if (head - m_cachedTail >= Capacity)
+				{
+					m_cachedTail = m_tail.load(std::memory_order_acquire);
+
+					if (head - m_cachedTail >= Capacity)
+					{
+						m_dropped.store(m_dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+						return;
+					}
+				}
+
+				m_records[head & (Capacity - 1)] = record;
+
+				m_head.store(head + 1, std::memory_order_release);
+			}
+
+			//
+			//	Consumer side
+			//
+			void drain(std::vector<SpanRecord>& spans)
+			{
+				const size_t tail = m_tail.load(std::memory_order_relaxed);
+				const size_t head = m_head.load(std::memory_order_acquire);
+
+				for (size_t i = tail; i != head; ++i)
+				{
+					spans.push_back(m_records[i & (Capacity - 1)]);
+				}
+
+				m_tail.store(head, std::memory_order_release);
+			}
+
+			unsigned long long dropped() const
+			{
+				return m_dropped.load(std::memory_order_relaxed);
+			}
+
+			bool retired() const
+			{
+				return m_retired.load(std::memory_order_acquire);
+			}
+
+			void retire()
+			{
+				m_retired.store(true, std::memory_order_release);
+			}
+
+		private:
+
+			alignas(64) std::atomic<size_t> m_head{ 0 };
+
+			size_t m_cachedTail = 0;
+
+			std::atomic<unsigned long long> m_dropped{ 0 };
+
+			alignas(64) std::atomic<size_t> m_tail{ 0 };
+
+			std::atomic<bool> m_retired{ false };
+
+			alignas(64) SpanRecord m_records[Capacity];
+		};
+
+		//
+		//	The calling thread's buffers, one per collector it submitted to
+		//
+		struct ThreadSpanBuffers
+		{
+			std::vector<std::pair<std::uint64_t, std::shared_ptr<SpanBuffer>>> buffers;
+
+			unsigned threadIndex = ~0u;
+
+			~ThreadSpanBuffers()
+			{
+				for (const auto& entry : buffers)
+				{
+					entry.second->retire();
+				}
+			}
+		};
+
+		inline ThreadSpanBuffers& GetThreadSpanBuffers()
+		{
+			static thread_local ThreadSpanBuffers buffers;
+
+			return buffers;
+		}
+
+		const unsigned SpanOnlyThreadBase = 0x80000000u;
+
+		//
+		//	The ZoneBuffer index of a thread that already profiles zones, so that its spans and zones share a track;
+		//	otherwise an index from SpanOnlyThreadBase up, without registering the thread with the ZoneCollector.
+		//	Fixed at the thread's first span.
+		//
+		inline unsigned SpanThreadIndex()
+		{
+			unsigned& index = GetThreadSpanBuffers().threadIndex;
+
+			if (index == ~0u)
+			{
+				static std::atomic<unsigned> next{ SpanOnlyThreadBase };
+
+				const ZoneBuffer* buffer = ThreadZoneBufferPtr();
+
+				index = buffer ? buffer->threadIndex() : next.fetch_add(1, std::memory_order_relaxed);
+			}
+
+			return index;
+		}
+	}
+
+	//
+	//	Ended spans go to a lock-free ring of the ending thread and are gathered by collect().
+	//	A full ring drops spans (see dropped()) rather than block the ending thread.
+	//
+	class SpanCollector
+	{
+	public:
+
+		SpanCollector()
+			: m_id(NextCollectorId()) {}
+
+		SpanCollector(const SpanCollector&) = delete;
+
+		SpanCollector& operator=(const SpanCollector&) = delete;
+
+		void submit(const SpanRecord& record)
+		{
+			threadBuffer().push(record);
+		}
+
+		//
+		//	Moves the spans ended so far into the collector
+		//
+		void collect()
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			for (auto it = m_buffers.begin(); it != m_buffers.end();)
+			{
+				// check before draining so that spans pushed just before retirement are not lost
+				const bool retired = (*it)->retired();
+
+				(*it)->drain(m_spans);
+
+				if (retired)
+				{
+					m_retiredDropped += (*it)->dropped();
+
+					it = m_buffers.erase(it);
+				}
+				else
+				{
+					++it;
+				}
+			}
+		}
+
+		//
+		//	Spans lost to full buffers
+		//
+		unsigned long long dropped() const
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			unsigned long long dropped = m_retiredDropped;
+
+			for (const auto& buffer : m_buffers)
+			{
+				dropped += buffer->dropped();
+			}
+
+			return dropped;
+		}
+
+		std::vector<SpanRecord> getSpans() const
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			return m_spans;
+		}
+
+		void clear()
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			m_spans.clear();
+		}
+
+	private:
+
+		// identifies the collector in threads' buffer lists; an address could be reused by a later collector
+		const std::uint64_t m_id;
+
+		mutable std::mutex m_mutex;
+
+		std::vector<std::shared_ptr<detail::SpanBuffer>> m_buffers;
+
+		unsigned long long m_retiredDropped = 0;
+
+		std::vector<SpanRecord> m_spans;
+
+		static std::uint64_t NextCollectorId()
+		{
+			static std::atomic<std::uint64_t> id{ 0 };
+
+			return ++id;
+		}
+
+		detail::SpanBuffer& threadBuffer()
+		{
+			auto& buffers = detail::GetThreadSpanBuffers().buffers;
+
+			for (const auto& entry : buffers)
+			{
+				if (entry.first == m_id)
+				{
+					return *entry.second;
+				}
+			}
+
+			// buffers only this thread still holds belong to destroyed collectors
+			buffers.erase(std::remove_if(buffers.begin(), buffers.end(), [](const std::pair<std::uint64_t, std::shared_ptr<detail::SpanBuffer>>& entry)
+			{
+				return entry.second.use_count() == 1;
+			}), buffers.end());
+
+			// shared with the collector, so spans ended just before the thread exits are still collected
+			auto buffer = std::make_shared<detail::SpanBuffer>();
+
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+
+				m_buffers.push_back(buffer);
+			}
+
+			buffers.emplace_back(m_id, buffer);
+
+			return *buffer;
+		}
+	};
+
+	inline SpanCollector& GetSpanCollector()
+	{
+		static SpanCollector collector;
+
+		return collector;
+	}
+
+	//
+	//	Span that may be moved to another thread and ended there.
+	//	Ends on destruction if end() was not called.
+	//
+	class AsyncSpan
+	{
+	public:
+
+		AsyncSpan() = default;
+
+		explicit AsyncSpan(const char* name, SpanContext parent = SpanContext(), SpanKind kind = SpanKind::Work)
+			: m_active(true)
+		{
+			m_record.name = name;
+			m_record.spanId = detail::NextSpanId();
+			m_record.traceId = parent ? parent.traceId : m_record.spanId;
+			m_record.parentId = parent.spanId;
+			m_record.beginThread = detail::SpanThreadIndex();
+			m_record.endThread = m_record.beginThread;
+			m_record.kind = kind;
+			m_record.end = 0;
+			m_record.begin = detail::ReadTSC();
+		}
+
+		AsyncSpan(AsyncSpan&& another) noexcept
+			: m_record(another.m_record)
+			, m_active(another.m_active)
+		{
+			another.m_active = false;
+		}
+
+		AsyncSpan& operator=(AsyncSpan&& another) noexcept
+		{
+			if (this != &another)
+			{
+				end();
+
+				m_record = another.m_record;
+
+				m_active = another.m_active;
+
+				another.m_active = false;
+			}
+
+			return *this;
+		}
+
+		~AsyncSpan()
+		{
+			end();
+		}
+
+		AsyncSpan(const AsyncSpan&) = delete;
+
+		AsyncSpan& operator=(const AsyncSpan&) = delete;
+
+		SpanContext context() const
+		{
+			SpanContext context;
+
+			context.traceId = m_record.traceId;
+
+			context.spanId = m_record.spanId;
+
+			return context;
+		}
+
+		bool active() const
+		{
+			return m_active;
+		}
+
+		void end()
+		{
+			if (!m_active)
+			{
+				return;
+			}
+
+			m_record.end = detail::ReadTSC();
+
+			m_record.endThread = detail::SpanThreadIndex();
+
+			m_active = false;
+
+			GetSpanCollector().submit(m_record);
+		}
+
+	private:
+
+		SpanRecord m_record = SpanRecord();
+
+		bool m_active = false;
+	};
+
+	struct CriticalPathSegment
+	{
+		const char* name;
+
+		std::uint64_t spanId;
+
+		SpanKind kind;
+
+		unsigned long long begin;
+
+		unsigned long long end;
+	};
+
+	//
+	//	Chain of spans that determined a request's end-to-end latency, in time order
+	//
+	struct CriticalPath
+	{
+		std::uint64_t traceId = 0;
+
+		const char* name = nullptr;
+
+		unsigned long long totalNanosec = 0;
+
+		// part of totalNanosec spent in SpanKind::Queue spans
+		unsigned long long queueNanosec = 0;
+
+		std::vector<CriticalPathSegment> segments;
+	};
+
+	namespace detail
+	{
+		// children of each span (span ids are unique across traces), latest end first
+		typedef std::unordered_map<std::uint64_t, std::vector<const SpanRecord*>> SpanChildren;
+
+		inline void WalkCriticalPath(const SpanChildren& spanChildren, const SpanRecord& span, unsigned long long until, std::vector<CriticalPathSegment>& reversed)
+		{
+			static const std::vector<const SpanRecord*> none;
+
+			const auto found = spanChildren.find(span.spanId);
+
+			const std::vector<const SpanRecord*>& children = (found != spanChildren.end()) ? found->second : none;
+
+			unsigned long long cursor = std::min(span.end, until);
+
+			// from the end backwards: the last child to finish before the cursor is what the span waited for
+			for (const SpanRecord* child : children)
+			{
+				if (child->end > cursor || child->end <= span.begin)
+				{
+					continue;
+				}
+
+				if (child->end < cursor)
+				{
+					reversed.push_back(CriticalPathSegment{ span.name, span.spanId, span.kind, child->end, cursor });
+				}
+
+				WalkCriticalPath(spanChildren, *child, cursor, reversed);
+
+				cursor = std::max(child->begin, span.begin);
+			}
+
+			if (cursor > span.begin)
+			{
+				reversed.push_back(CriticalPathSegment{ span.name, span.spanId, span.kind, span.begin, cursor });
+			}
+		}
+	}
+
+	//
+	//	Critical path of every root span in spans; spans of one trace may come from any thread
+	//
+	inline std::vector<CriticalPath> ComputeCriticalPaths(const std::vector<SpanRecord>& spans)
+	{
+		std::vector<CriticalPath> paths;
+
+		// one pass to bucket spans by parent, instead of a scan of every span per span
+		detail::SpanChildren spanChildren;
+
+		for (const auto& s : spans)
+		{
+			if (s.parentId != 0 && s.parentId != s.spanId)
+			{
+				spanChildren[s.parentId].push_back(&s);
+			}
+		}
+
+		for (auto& entry : spanChildren)
+		{
+			std::sort(entry.second.begin(), entry.second.end(), [](const SpanRecord* a, const SpanRecord* b)
+			{
+				return a->end > b->end;
+			});
+		}
+
+		for (const auto& root : spans)
+		{
+			if (root.parentId != 0)
+			{
+				continue;
+			}
+
+			CriticalPath path;
+
+			path.traceId = root.traceId;
+
+			path.name = root.name;
+
+			path.totalNanosec = TSCToNanosec(root.end - root.begin);
+
+			detail::WalkCriticalPath(spanChildren, root, root.end, path.segments);
+
+			std::reverse(path.segments.begin(), path.segments.end());
+
+			unsigned long long queueTicks = 0;
+
+			for (const auto& segment : path.segments)
+			{
+				if (segment.kind == SpanKind::Queue)
+				{
+					queueTicks += segment.end - segment.begin;
+				}
+			}
+
+			path.queueNanosec = TSCToNanosec(queueTicks);
+
+			paths.push_back(std::move(path));
+		}
+
+		return paths;
+	}
+
+	inline void WriteCriticalPath(std::ostream& os, const CriticalPath& path)
+	{
+		char line[256];
+
+		std::snprintf(line, sizeof(line), "%s (trace %llu): %.1fus, %.1fus queued\n", path.name,
+			static_cast<unsigned long long>(path.traceId), path.totalNanosec / 1000.0, path.queueNanosec / 1000.0);
+
+		os << line;
+
+		const unsigned long long origin = path.segments.empty() ? 0 : path.segments.front().begin;
+
+		for (const auto& segment : path.segments)
+		{
+			std::snprintf(line, sizeof(line), "  +%10.1fus %10.1fus  %s%s\n",
+				TSCToNanosec(segment.begin - origin) / 1000.0, TSCToNanosec(segment.end - segment.begin) / 1000.0,
+				segment.name, segment.kind == SpanKind::Queue ? " (queue)" : "");
+
+			os << line;
+		}
+	}
+
+	//
+	//	Chrome trace_event async events: one track per request (id = trace id), spans nested by time
+	//
+	inline void WriteSpanChromeTrace(std::ostream& os, const std::vector<SpanRecord>& spans, unsigned processID = 1)
+	{
+		TraceChunkWriter writer(os);
+
+		unsigned long long base = ~0ULL;
+
+		for (const auto& s : spans)
+		{
+			base = std::min(base, s.begin);
+		}
+
+		writer.write("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+
+		bool first = true;
+
+		for (const auto& s : spans)
+		{
+			for (int phase = 0; phase < 2; ++phase)
+			{
+				writer.write(first ? "\n" : ",\n");
+
+				first = false;
+
+				writer.write(phase == 0 ? "{\"ph\":\"b\"" : "{\"ph\":\"e\"");
+				writer.write(",\"cat\":\"request\",\"name\":");
+				writer.writeJSONString(s.name);
+				writer.write(",\"id\":");
+				writer.writeUInt(s.traceId);
+				writer.write(",\"pid\":");
+				writer.writeUInt(processID);
+				writer.write(",\"tid\":");
+				writer.writeUInt(phase == 0 ? s.beginThread : s.endThread);
+				writer.write(",\"ts\":");
+				writer.writeMicrosec(TSCToNanosec((phase == 0 ? s.begin : s.end) - base));
+				writer.write(",\"args\":{\"span\":");
+				writer.writeUInt(s.spanId);
+				writer.write(",\"parent\":");
+				writer.writeUInt(s.parentId);
+				writer.write(s.kind == SpanKind::Queue ? ",\"kind\":\"queue\"}}" : ",\"kind\":\"work\"}}");
+			}
+		}
+
+		writer.write("\n]}\n");
+
+		writer.flush();
+	}
+}
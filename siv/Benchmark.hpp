@@ -0,0 +1,1080 @@
+﻿//------------------------------------------
+//	Benchmark.hpp
+//	Copyright (c) 2014 Reputeless
+//	<reputeless@gmail.com>
+//	Distributed under the MIT license.
+//------------------------------------------
+
+# pragma once
+# include <cmath>
+# include <cstdlib>
+# include <cstring>
+# include <cctype>
+# include <string>
+# include <iterator>
+# include <vector>
+# include <algorithm>
+# include <functional>
+# include <ostream>
+# include <fstream>
+# include <iostream>
+# include <cstdio>
+# include "Profiler.hpp"
+
+# if defined(_MSC_VER)
+#	include <intrin.h>
+# endif
+
+# define SIV_BENCHMARK_CAT_IMPL(a, b) a##b
+# define SIV_BENCHMARK_CAT(a, b) SIV_BENCHMARK_CAT_IMPL(a, b)
+
+//
+//	SIV_BENCHMARK(Name)
+//	{
+//		while (state.keepRunning()) { ... }
+//	}
+//
+# define SIV_BENCHMARK(name)																\
+	static void SIV_BENCHMARK_CAT(SivBenchmark_, name)(siv::BenchmarkState&);				\
+	static const siv::BenchmarkRegistrar SIV_BENCHMARK_CAT(sivBenchmarkRegistrar_, name)	\
+		(#name, &SIV_BENCHMARK_CAT(SivBenchmark_, name));									\
+	static void SIV_BENCHMARK_CAT(SivBenchmark_, name)(siv::BenchmarkState& state)
+
+# define SIV_BENCHMARK_MAIN()							\
+	int main(int argc, char** argv)						\
+	{													\
+		return siv::RunBenchmarksMain(argc, argv);		\
+	}
+
+namespace siv
+{
+	//
+	//	Keeps value (and everything it depends on) from being optimized away
+	//
+	template <class Type>
+	inline void DoNotOptimize(const Type& value)
+	{
+#if defined(_MSC_VER)
+
+		static volatile const void* sink;
+
+		sink = &value;
+
+		::_ReadWriteBarrier();
+
+#else
+
+		asm volatile("" : : "r,m"(value) : "memory");
+
+#endif
+	}
+
+	//
+	//	Forces pending memory writes to be considered observable
+	//
+	inline void ClobberMemory()
+	{
+#if defined(_MSC_VER)
+
+		::_ReadWriteBarrier();
+
+#else
+
+		asm volatile("" : : : "memory");
+
+#endif
+	}
+
+	class BenchmarkState
+	{
+	public:
+
+		explicit BenchmarkState(unsigned long long iterations)
+			: m_iterations(iterations)
+			, m_remaining(iterations) {}
+
+		bool keepRunning()
+		{
+			if (m_remaining)
+			{
+				--m_remaining;
+
+				return true;
+			}
+
+			return false;
+		}
+
+		unsigned long long iterations() const
+		{
+			return m_iterations;
+		}
+
+	private:
+
+		const unsigned long long m_iterations;
+
+		unsigned long long m_remaining;
+	};
+
+	typedef void(*BenchmarkFunction)(BenchmarkState&);
+
+	struct BenchmarkEntry
+	{
+		std::string name;
+
+		BenchmarkFunction function;
+	};
+
+	inline std::vector<BenchmarkEntry>& GetBenchmarkRegistry()
+	{
+		static std::vector<BenchmarkEntry> registry;
+
+		return registry;
+	}
+
+	struct BenchmarkRegistrar
+	{
+		BenchmarkRegistrar(const char* name, BenchmarkFunction function)
+		{
+			GetBenchmarkRegistry().push_back(BenchmarkEntry{ name, function });
+		}
+	};
+
+	struct BenchmarkOptions
+	{
+		// warmup before the iteration count is chosen
+		unsigned long long warmupMillisec = 100;
+
+		// wall time spent measuring each benchmark
+		unsigned long long minMillisec = 500;
+
+		unsigned sampleCount = 30;
+
+		// samples further than this many scaled MADs from the median are rejected
+		double outlierThreshold = 3.0;
+
+		std::string filter;
+	};
+
+	struct BenchmarkResult
+	{
+		std::string name;
+
+		unsigned long long iterationsPerSample = 0;
+
+		// per-iteration nanoseconds of each sample, in measurement order
+		std::vector<double> samples;
+
+		double median = 0.0;
+
+		// median absolute deviation, scaled to estimate the standard deviation
+		double mad = 0.0;
+
+		double mean = 0.0;
+
+		double min = 0.0;
+
+		double max = 0.0;
+
+		double cyclesPerIteration = 0.0;
+
+		size_t outliers = 0;
+	};
+
+	namespace detail
+	{
+		inline double Median(std::vector<double> values)
+		{
+			if (values.empty())
+			{
+				return 0.0;
+			}
+
+			const size_t half = values.size() / 2;
+
+			std::nth_element(values.begin(), values.begin() + half, values.end());
+
+			const double upper = values[half];
+
+			if (values.size() % 2)
+			{
+				return upper;
+			}
+
+			return (*std::max_element(values.begin(), values.begin() + half) + upper) / 2.0;
+		}
+
+		inline double MedianAbsoluteDeviation(const std::vector<double>& values, double median)
+		{
+			std::vector<double> deviations;
+
+			for (double v : values)
+			{
+				deviations.push_back(std::fabs(v - median));
+			}
+
+			return 1.4826 * Median(deviations);
+		}
+
+		inline unsigned long long RunBenchmarkOnce(BenchmarkFunction function, unsigned long long iterations)
+		{
+			BenchmarkState state(iterations);
+
+			const RDTSCClock cycles;
+
+			function(state);
+
+#if SIV_HAS_PROPERTY
+			return cycles.elapsed;
+#else
+			return cycles.elapsed();
+#endif
+		}
+
+		inline unsigned long long ElapsedMillisec(const MicrosecClock& clock)
+		{
+#if SIV_HAS_PROPERTY
+			return clock.elapsed / 1000ULL;
+#else
+			return clock.elapsed() / 1000ULL;
+#endif
+		}
+	}
+
+	inline void ComputeBenchmarkStatistics(BenchmarkResult& result, double outlierThreshold)
+	{
+		result.median = detail::Median(result.samples);
+
+		result.mad = detail::MedianAbsoluteDeviation(result.samples, result.median);
+
+		std::vector<double> kept;
+
+		for (double v : result.samples)
+		{
+			if (result.mad == 0.0 || std::fabs(v - result.median) <= outlierThreshold * result.mad)
+			{
+				kept.push_back(v);
+			}
+		}
+
+		result.outliers = result.samples.size() - kept.size();
+
+		if (kept.empty())
+		{
+			return;
+		}
+
+		result.median = detail::Median(kept);
+
+		result.mad = detail::MedianAbsoluteDeviation(kept, result.median);
+
+		double sum = 0.0;
+
+		for (double v : kept)
+		{
+			sum += v;
+		}
+
+		result.mean = sum / kept.size();
+
+		result.min = *std::min_element(kept.begin(), kept.end());
+
+		result.max = *std::max_element(kept.begin(), kept.end());
+	}
+
+	inline BenchmarkResult RunBenchmark(const BenchmarkEntry& entry, const BenchmarkOptions& options)
+	{
+		const unsigned long long sampleCount = std::max(1u, options.sampleCount);
+
+		const unsigned long long sampleNanosec = std::max(1000ULL, options.minMillisec * 1000000ULL / sampleCount);
+
+		// in double: nanoseconds times Hz overflows 64 bits past about 6 seconds at 3GHz
+		const unsigned long long sampleTicks = std::max(1ULL, static_cast<unsigned long long>(
+			static_cast<double>(sampleNanosec) * GetTSCFrequency().frequency / 1.0e9));
+
+		unsigned long long iterations = 1;
+
+		// warmup, doubling the iteration count so that slow benchmarks are not run for long
+		{
+			const MicrosecClock warmup;
+
+			do
+			{
+				detail::RunBenchmarkOnce(entry.function, iterations);
+
+				if (iterations < (1ULL << 40))
+				{
+					iterations *= 2;
+				}
+			}
+			while (detail::ElapsedMillisec(warmup) < options.warmupMillisec);
+		}
+
+		// scale until one sample takes sampleNanosec
+		iterations = 1;
+
+		for (;;)
+		{
+			const unsigned long long ticks = detail::RunBenchmarkOnce(entry.function, iterations);
+
+			if (ticks >= sampleTicks || iterations >= (1ULL << 40))
+			{
+				break;
+			}
+
+			const double scale = ticks ? 1.4 * sampleTicks / ticks : 10.0;
+
+			iterations = static_cast<unsigned long long>(iterations * std::min(10.0, std::max(1.1, scale))) + 1;
+		}
+
+		BenchmarkResult result;
+
+		result.name = entry.name;
+
+		result.iterationsPerSample = iterations;
+
+		unsigned long long totalTicks = 0;
+
+		for (unsigned long long i = 0; i < sampleCount; ++i)
+		{
+			const unsigned long long ticks = detail::RunBenchmarkOnce(entry.function, iterations);
+
+			totalTicks += ticks;
+
+			result.samples.push_back(static_cast<double>(TSCToNanosec(ticks)) / iterations);
+		}
+
+		result.cyclesPerIteration = static_cast<double>(totalTicks) / (sampleCount * iterations);
+
+		ComputeBenchmarkStatistics(result, options.outlierThreshold);
+
+		return result;
+	}
+
+	inline std::vector<BenchmarkResult> RunBenchmarks(const BenchmarkOptions& options, std::ostream* progress = nullptr)
+	{
+		std::vector<BenchmarkResult> results;
+
+		for (const auto& entry : GetBenchmarkRegistry())
+		{
+			if (!options.filter.empty() && entry.name.find(options.filter) == std::string::npos)
+			{
+				continue;
+			}
+
+			results.push_back(RunBenchmark(entry, options));
+
+			if (progress)
+			{
+				const BenchmarkResult& r = results.back();
+
+				char line[256];
+
+				std::snprintf(line, sizeof(line), "%-32s %12.2f ns  (MAD %.2f, %llu iterations x %u, %u outliers)\n",
+					r.name.c_str(), r.median, r.mad, r.iterationsPerSample,
+					static_cast<unsigned>(r.samples.size()), static_cast<unsigned>(r.outliers));
+
+				*progress << line << std::flush;
+			}
+		}
+
+		return results;
+	}
+
+	inline void WriteBenchmarkJSON(std::ostream& os, const std::vector<BenchmarkResult>& results)
+	{
+		const auto number = [](double value)
+		{
+			char buffer[32];
+
+			std::snprintf(buffer, sizeof(buffer), "%.6g", value);
+
+			return std::string(buffer);
+		};
+
+		os << "{\n\t\"tscFrequency\": " << GetTSCFrequency().frequency << ",\n\t\"benchmarks\": [";
+
+		for (size_t i = 0; i < results.size(); ++i)
+		{
+			const BenchmarkResult& r = results[i];
+
+			os << (i ? ",\n" : "\n") << "\t\t{ \"name\": \"";
+
+			for (char ch : r.name)
+			{
+				if (ch == '"' || ch == '\\')
+				{
+					os << '\\';
+				}
+
+				os << ch;
+			}
+
+			os << "\", \"unit\": \"ns\""
+				<< ", \"iterationsPerSample\": " << r.iterationsPerSample
+				<< ", \"median\": " << number(r.median)
+				<< ", \"mad\": " << number(r.mad)
+				<< ", \"mean\": " << number(r.mean)
+				<< ", \"min\": " << number(r.min)
+				<< ", \"max\": " << number(r.max)
+				<< ", \"cyclesPerIteration\": " << number(r.cyclesPerIteration)
+				<< ", \"outliers\": " << r.outliers
+				<< ", \"samples\": [";
+
+			for (size_t k = 0; k < r.samples.size(); ++k)
+			{
+				os << (k ? ", " : "") << number(r.samples[k]);
+			}
+
+			os << "] }";
+		}
+
+		os << "\n\t]\n}\n";
+	}
+
+	namespace detail
+	{
+		//
+		//	Just enough JSON to read back WriteBenchmarkJSON output; unknown keys are skipped
+		//
+		class BenchmarkJSONReader
+		{
+		public:
+
+			explicit BenchmarkJSONReader(const std::string& text)
+				: m_text(text) {}
+
+			bool read(std::vector<BenchmarkResult>& results)
+			{
+				return parseValue([&](const std::string& key)
+				{
+					if (key != "benchmarks")
+					{
+						return parseValue(nullptr);
+					}
+
+					return parseArray([&]()
+					{
+						results.emplace_back();
+
+						return parseResult(results.back());
+					});
+				}) && (skipSpace(), m_pos == m_text.size());
+			}
+
+		private:
+
+			const std::string& m_text;
+
+			size_t m_pos = 0;
+
+			void skipSpace()
+			{
+				while (m_pos < m_text.size() && std::isspace(static_cast<unsigned char>(m_text[m_pos])))
+				{
+					++m_pos;
+				}
+			}
+
+			bool consume(char ch)
+			{
+				skipSpace();
+
+				if (m_pos < m_text.size() && m_text[m_pos] == ch)
+				{
+					++m_pos;
+
+					return true;
+				}
+
+				return false;
+			}
+
+			bool parseString(std::string& s)
+			{
+				if (!consume('"'))
+				{
+					return false;
+				}
+
+				for (; m_pos < m_text.size(); ++m_pos)
+				{
+					char ch = m_text[m_pos];
+
+					if (ch == '"')
+					{
+						++m_pos;
+
+						return true;
+					}
+
+					if (ch == '\\' && ++m_pos < m_text.size())
+					{
+						ch = m_text[m_pos];
+
+						ch = ch == 'n' ? '\n' : ch == 't' ? '\t' : ch;
+					}
+
+					s += ch;
+				}
+
+				return false;
+			}
+
+			bool parseNumber(double& value)
+			{
+				skipSpace();
+
+				const char* begin = m_text.c_str() + m_pos;
+
+				char* end;
+
+				value = std::strtod(begin, &end);
+
+				m_pos += end - begin;
+
+				return end != begin;
+			}
+
+			template <class Function>
+			bool parseArray(Function element)
+			{
+				if (!consume('['))
+				{
+					return false;
+				}
+
+				if (consume(']'))
+				{
+					return true;
+				}
+
+				do
+				{
+					if (!element())
+					{
+						return false;
+					}
+				}
+				while (consume(','));
+
+				return consume(']');
+			}
+
+			//
+			//	Object whose members are handed to member(key), or any other value when member is null
+			//
+			bool parseValue(std::function<bool(const std::string&)> member)
+			{
+				skipSpace();
+
+				if (m_pos >= m_text.size())
+				{
+					return false;
+				}
+
+				const char ch = m_text[m_pos];
+
+				if (ch == '{')
+				{
+					++m_pos;
+
+					if (consume('}'))
+					{
+						return true;
+					}
+
+					do
+					{
+						std::string key;
+
+						if (!parseString(key) || !consume(':') || !(member ? member(key) : parseValue(nullptr)))
+						{
+							return false;
+						}
+					}
+					while (consume(','));
+
+					return consume('}');
+				}
+
+				if (ch == '[')
+				{
+					return parseArray([&]() { return parseValue(nullptr); });
+				}
+
+				if (ch == '"')
+				{
+					std::string s;
+
+					return parseString(s);
+				}
+
+				for (const char* literal : { "true", "false", "null" })
+				{
+					if (m_text.compare(m_pos, std::strlen(literal), literal) == 0)
+					{
+						m_pos += std::strlen(literal);
+
+						return true;
+					}
+				}
+
+				double value;
+
+				return parseNumber(value);
+			}
+
+			bool parseResult(BenchmarkResult& r)
+			{
+				return parseValue([&](const std::string& key)
+				{
+					double value = 0.0;
+
+					if (key == "name")
+					{
+						return parseString(r.name);
+					}
+					else if (key == "samples")
+					{
+						return parseArray([&]()
+						{
+							r.samples.push_back(0.0);
+
+							return parseNumber(r.samples.back());
+						});
+					}
+
+					double* const field = key == "median" ? &r.median
+						: key == "mad" ? &r.mad
+						: key == "mean" ? &r.mean
+						: key == "min" ? &r.min
+						: key == "max" ? &r.max
+						: key == "cyclesPerIteration" ? &r.cyclesPerIteration
+						: (key == "iterationsPerSample" || key == "outliers") ? &value
+						: nullptr;
+
+					if (!field)
+					{
+						return parseValue(nullptr);
+					}
+
+					if (!parseNumber(*field))
+					{
+						return false;
+					}
+
+					if (key == "iterationsPerSample")
+					{
+						r.iterationsPerSample = static_cast<unsigned long long>(value);
+					}
+					else if (key == "outliers")
+					{
+						r.outliers = static_cast<size_t>(value);
+					}
+
+					return true;
+				});
+			}
+		};
+	}
+
+	//
+	//	Loads results written by WriteBenchmarkJSON (e.g. a stored baseline); false on a malformed document
+	//
+	inline bool ReadBenchmarkJSON(std::istream& is, std::vector<BenchmarkResult>& results)
+	{
+		const std::string text((std::istreambuf_iterator<char>(is)), std::istreambuf_iterator<char>());
+
+		results.clear();
+
+		return detail::BenchmarkJSONReader(text).read(results);
+	}
+
+	inline bool ReadBenchmarkJSON(const std::string& path, std::vector<BenchmarkResult>& results)
+	{
+		std::ifstream ifs(path);
+
+		return ifs && ReadBenchmarkJSON(ifs, results);
+	}
+
+	struct MannWhitneyResult
+	{
+		// U statistic of the first sample set
+		double u = 0.0;
+
+		// normal approximation with tie and continuity correction
+		double z = 0.0;
+
+		// two-sided
+		double pValue = 1.0;
+	};
+
+	inline MannWhitneyResult MannWhitneyU(const std::vector<double>& a, const std::vector<double>& b)
+	{
+		MannWhitneyResult result;
+
+		const double n1 = static_cast<double>(a.size()), n2 = static_cast<double>(b.size());
+
+		if (a.empty() || b.empty())
+		{
+			return result;
+		}
+
+		std::vector<std::pair<double, bool>> all;
+
+		for (double v : a)
+		{
+			all.emplace_back(v, true);
+		}
+
+		for (double v : b)
+		{
+			all.emplace_back(v, false);
+		}
+
+		std::sort(all.begin(), all.end());
+
+		double rankSumA = 0.0, tieTerm = 0.0;
+
+		for (size_t i = 0; i < all.size();)
+		{
+			size_t j = i;
+
+			while (j < all.size() && all[j].first == all[i].first)
+			{
+				++j;
+			}
+
+			// tied values share the mean of their ranks (1-based)
+			const double rank = (i + j + 1) / 2.0;
+
+			for (size_t k = i; k < j; ++k)
+			{
+				if (all[k].second)
+				{
+					rankSumA += rank;
+				}
+			}
+
+			const double t = static_cast<double>(j - i);
+
+			tieTerm += t * t * t - t;
+
+			i = j;
+		}
+
+		const double n = n1 + n2;
+
+		result.u = rankSumA - n1 * (n1 + 1) / 2.0;
+
+		const double mean = n1 * n2 / 2.0;
+
+		const double variance = n1 * n2 / 12.0 * ((n + 1) - tieTerm / (n * (n - 1)));
+
+		if (variance <= 0.0)
+		{
+			return result;
+		}
+
+		const double difference = result.u - mean;
+
+		result.z = (difference - (difference > 0 ? 0.5 : difference < 0 ? -0.5 : 0.0)) / std::sqrt(variance);
+
+		result.pValue = std::erfc(std::fabs(result.z) / std::sqrt(2.0));
+
+		return result;
+	}
+
+	struct BenchmarkComparison
+	{
+		std::string name;
+
+		double baselineMedian = 0.0;
+
+		double currentMedian = 0.0;
+
+		// Hodges-Lehmann shift of current against baseline, in percent of the baseline median
+		double change = 0.0;
+
+		// confidence interval of the change
+		double changeLow = 0.0;
+
+		double changeHigh = 0.0;
+
+		double pValue = 1.0;
+
+		bool significant = false;
+
+		bool regression = false;
+	};
+
+	struct BenchmarkComparisonOptions
+	{
+		// slowdowns above this many percent fail the comparison
+		double thresholdPercent = 5.0;
+
+		// significance level of the Mann-Whitney U test; the interval has confidence 1 - alpha
+		double alpha = 0.05;
+	};
+
+	namespace detail
+	{
+		// inverse of the standard normal CDF (Acklam's rational approximation)
+		inline double NormalQuantile(double p)
+		{
+			static const double a[] = { -39.69683028665376, 220.9460984245205, -275.9285104469687, 138.3577518672690, -30.66479806614716, 2.506628277459239 };
+			static const double b[] = { -54.47609879822406, 161.5858368580409, -155.6989798598866, 66.80131188771972, -13.28068155288572 };
+			static const double c[] = { -0.007784894002430293, -0.3223964580411365, -2.400758277161838, -2.549732539343734, 4.374664141464968, 2.938163982698783 };
+			static const double d[] = { 0.007784695709041462, 0.3224671290700398, 2.445134137142996, 3.754408661907416 };
+
+			if (p < 0.02425)
+			{
+				const double q = std::sqrt(-2 * std::log(p));
+
+				return (((((c[0] * q + c[1]) * q + c[2]) * q + c[3]) * q + c[4]) * q + c[5]) / ((((d[0] * q + d[1]) * q + d[2]) * q + d[3]) * q + 1);
+			}
+
+			if (p > 1 - 0.02425)
+			{
+				return -NormalQuantile(1 - p);
+			}
+
+			const double q = p - 0.5, r = q * q;
+
+			return (((((a[0] * r + a[1]) * r + a[2]) * r + a[3]) * r + a[4]) * r + a[5]) * q / (((((b[0] * r + b[1]) * r + b[2]) * r + b[3]) * r + b[4]) * r + 1);
+		}
+	}
+
+	//
+	//	Compares benchmarks present in both sets by name
+	//
+	inline std::vector<BenchmarkComparison> CompareBenchmarks(const std::vector<BenchmarkResult>& baseline, const std::vector<BenchmarkResult>& current, const BenchmarkComparisonOptions& options = BenchmarkComparisonOptions())
+	{
+		std::vector<BenchmarkComparison> comparisons;
+
+		for (const auto& now : current)
+		{
+			const auto before = std::find_if(baseline.begin(), baseline.end(), [&](const BenchmarkResult& r) { return r.name == now.name; });
+
+			if (before == baseline.end())
+			{
+				continue;
+			}
+
+			BenchmarkComparison c;
+
+			c.name = now.name;
+
+			c.baselineMedian = before->median;
+
+			c.currentMedian = now.median;
+
+			const double base = before->median > 0.0 ? before->median : 1.0;
+
+			if (before->samples.empty() || now.samples.empty())
+			{
+				// no samples stored: medians only, never significant
+				c.change = c.changeLow = c.changeHigh = 100.0 * (now.median - before->median) / base;
+
+				comparisons.push_back(c);
+
+				continue;
+			}
+
+			std::vector<double> differences;
+
+			for (double x : now.samples)
+			{
+				for (double y : before->samples)
+				{
+					differences.push_back(x - y);
+				}
+			}
+
+			std::sort(differences.begin(), differences.end());
+
+			const double n1 = static_cast<double>(now.samples.size()), n2 = static_cast<double>(before->samples.size());
+
+			// distribution-free interval: the k-th smallest and largest pairwise differences (k is 1-based)
+			const double z = detail::NormalQuantile(1.0 - options.alpha / 2.0);
+
+			const double k = std::floor(n1 * n2 / 2.0 - z * std::sqrt(n1 * n2 * (n1 + n2 + 1) / 12.0));
+
+			const size_t low = static_cast<size_t>(std::max(0.0, k - 1.0));
+
+			const size_t high = differences.size() - 1 - low;
+
+			c.change = 100.0 * detail::Median(differences) / base;
+
+			c.changeLow = 100.0 * differences[std::min(low, high)] / base;
+
+			c.changeHigh = 100.0 * differences[std::max(low, high)] / base;
+
+			c.pValue = MannWhitneyU(now.samples, before->samples).pValue;
+
+			c.significant = c.pValue < options.alpha;
+
+			c.regression = c.significant && c.change > options.thresholdPercent;
+
+			comparisons.push_back(c);
+		}
+
+		return comparisons;
+	}
+
+	inline void WriteBenchmarkComparison(std::ostream& os, const std::vector<BenchmarkComparison>& comparisons)
+	{
+		for (const auto& c : comparisons)
+		{
+			char line[256];
+
+			std::snprintf(line, sizeof(line), "%-32s %12.2f -> %12.2f ns  %+7.2f%% [%+.2f%%, %+.2f%%]  p=%.4f%s\n",
+				c.name.c_str(), c.baselineMedian, c.currentMedian, c.change, c.changeLow, c.changeHigh, c.pValue,
+				c.regression ? "  REGRESSION" : c.significant ? (c.change < 0.0 ? "  faster" : "  slower") : "");
+
+			os << line;
+		}
+	}
+
+	inline bool HasBenchmarkRegression(const std::vector<BenchmarkComparison>& comparisons)
+	{
+		return std::any_of(comparisons.begin(), comparisons.end(), [](const BenchmarkComparison& c) { return c.regression; });
+	}
+
+	//
+	//	--filter=<substring> --min-time=<ms> --warmup=<ms> --samples=<n> --json=<path>
+	//	--baseline=<path>: compare the run against stored results
+	//	--compare=<baseline path>,<current path>: compare two stored result sets without running
+	//	--threshold=<percent> --alpha=<level>: regression criteria; a regression exits with 1
+	//
+	inline int RunBenchmarksMain(int argc, char** argv)
+	{
+		BenchmarkOptions options;
+
+		BenchmarkComparisonOptions comparisonOptions;
+
+		std::string jsonPath, baselinePath, comparePaths;
+
+		for (int i = 1; i < argc; ++i)
+		{
+			const std::string arg = argv[i];
+
+			const auto value = [&arg](const char* key) -> const char*
+			{
+				const size_t length = std::strlen(key);
+
+				return arg.compare(0, length, key) == 0 ? arg.c_str() + length : nullptr;
+			};
+
+			if (const char* v = value("--filter="))
+			{
+				options.filter = v;
+			}
+			else if (const char* v = value("--min-time="))
+			{
+				options.minMillisec = std::strtoull(v, nullptr, 10);
+			}
+			else if (const char* v = value("--warmup="))
+			{
+				options.warmupMillisec = std::strtoull(v, nullptr, 10);
+			}
+			else if (const char* v = value("--samples="))
+			{
+				options.sampleCount = static_cast<unsigned>(std::strtoul(v, nullptr, 10));
+			}
+			else if (const char* v = value("--json="))
+			{
+				jsonPath = v;
+			}
+			else if (const char* v = value("--baseline="))
+			{
+				baselinePath = v;
+			}
+			else if (const char* v = value("--compare="))
+			{
+				comparePaths = v;
+			}
+			else if (const char* v = value("--threshold="))
+			{
+				comparisonOptions.thresholdPercent = std::strtod(v, nullptr);
+			}
+			else if (const char* v = value("--alpha="))
+			{
+				comparisonOptions.alpha = std::strtod(v, nullptr);
+			}
+			else
+			{
+				std::cerr << "unknown option: " << arg << '\n';
+
+				return 2;
+			}
+		}
+
+		std::vector<BenchmarkResult> baseline, results;
+
+		if (!comparePaths.empty())
+		{
+			const size_t comma = comparePaths.find(',');
+
+			if (comma == std::string::npos)
+			{
+				std::cerr << "--compare needs <baseline>,<current>\n";
+
+				return 2;
+			}
+
+			baselinePath = comparePaths.substr(0, comma);
+
+			const std::string currentPath = comparePaths.substr(comma + 1);
+
+			if (!ReadBenchmarkJSON(currentPath, results))
+			{
+				std::cerr << "cannot read " << currentPath << '\n';
+
+				return 2;
+			}
+		}
+
+		if (!baselinePath.empty() && !ReadBenchmarkJSON(baselinePath, baseline))
+		{
+			std::cerr << "cannot read " << baselinePath << '\n';
+
+			return 2;
+		}
+
+		if (comparePaths.empty())
+		{
+			results = RunBenchmarks(options, &std::cout);
+		}
+
+		if (!jsonPath.empty())
+		{
+			std::ofstream ofs(jsonPath);
+
+			if (!ofs)
+			{
+				std::cerr << "cannot open " << jsonPath << '\n';
+
+				return 1;
+			}
+
+			WriteBenchmarkJSON(ofs, results);
+		}
+
+		if (!baselinePath.empty())
+		{
+			const auto comparisons = CompareBenchmarks(baseline, results, comparisonOptions);
+
+			WriteBenchmarkComparison(std::cout, comparisons);
+
+			if (HasBenchmarkRegression(comparisons))
+			{
+				return 1;
+			}
+		}
+
+		return 0;
+	}
+}
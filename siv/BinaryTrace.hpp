@@ -0,0 +1,980 @@
+﻿//------------------------------------------
+//	BinaryTrace.hpp
+//	Copyright (c) 2014 Reputeless
+//	<reputeless@gmail.com>
+//	Distributed under the MIT license.
+//------------------------------------------
+
+# pragma once
+# include <cstdint>
+# include <cstring>
+# include <cstdlib>
+# include <string>
+# include <vector>
+# include <deque>
+# include <unordered_map>
+# include <mutex>
+# include <fstream>
+# include <iostream>
+# include <algorithm>
+# include "ProfileZone.hpp"
+# include "TraceExport.hpp"
+# include "LatencyHistogram.hpp"
+
+# if !defined(_WIN32)
+#	include <fcntl.h>
+#	include <unistd.h>
+#	include <sys/mman.h>
+# endif
+
+// size of each file of the rotating set
+# ifndef SIV_BINARY_TRACE_FILE_SIZE
+#	define SIV_BINARY_TRACE_FILE_SIZE (64 * 1024 * 1024)
+# endif
+
+namespace siv
+{
+	//
+	//	On-disk layout: a 64-byte header followed by 16-byte records.
+	//	Files are named <base>.<sequence % fileCount>.sivtrace; each one is self-contained.
+	//
+	struct BinaryTraceHeader
+	{
+		char magic[8];
+
+		std::uint32_t version;
+
+		std::uint32_t fileCount;
+
+		std::uint64_t sequence;
+
+		std::uint64_t tscFrequency;
+
+		// records written so far; updated after every batch, so a crashed capture stays readable
+		std::uint64_t recordCount;
+
+		// identifies the writer, so that files left by an earlier capture are ignored
+		std::uint64_t session;
+
+		std::uint64_t reserved[2];
+	};
+
+	enum class BinaryTraceRecordType : std::uint8_t
+	{
+		// zone closed endDelta ticks after the previous record of the thread
+		Zone = 1,
+
+		// absolute end time of the thread's next record; value in endDelta:duration
+		Timestamp = 2,
+
+		// duration of the next Zone record, which holds 0xFFFFFFFF; value in endDelta:duration
+		LongDuration = 3,
+
+		// defines zone id; endDelta is the name length, the name follows in the next records
+		ZoneName = 4,
+	};
+
+	struct BinaryTraceRecord
+	{
+		std::uint8_t type;
+
+		std::uint8_t depth;
+
+		std::uint16_t zone;
+
+		std::uint32_t thread;
+
+		std::uint32_t endDelta;
+
+		std::uint32_t duration;
+
+		std::uint64_t value() const
+		{
+			return (static_cast<std::uint64_t>(endDelta) << 32) | duration;
+		}
+
+		void setValue(std::uint64_t v)
+		{
+			endDelta = static_cast<std::uint32_t>(v >> 32);
+
+			duration = static_cast<std::uint32_t>(v);
+		}
+	};
+
+	static_assert(sizeof(BinaryTraceHeader) == 64, "unexpected BinaryTraceHeader layout");
+
+	static_assert(sizeof(BinaryTraceRecord) == 16, "unexpected BinaryTraceRecord layout");
+
+	namespace detail
+	{
+		const char BinaryTraceMagic[8] = { 'S', 'I', 'V', 'T', 'R', 'A', 'C', 'E' };
+
+		const std::uint32_t BinaryTraceVersion = 1;
+
+		inline std::string BinaryTracePath(const std::string& basePath, unsigned index)
+		{
+			return basePath + "." + std::to_string(index) + ".sivtrace";
+		}
+
+		//
+		//	Preallocated, writable mapping of one file
+		//
+		class MappedTraceFile
+		{
+		public:
+
+			MappedTraceFile() = default;
+
+			~MappedTraceFile()
+			{
+				close();
+			}
+
+			MappedTraceFile(const MappedTraceFile&) = delete;
+
+			MappedTraceFile& operator=(const MappedTraceFile&) = delete;
+
+			bool open(const std::string& path, size_t size)
+			{
+				close();
+
+#if defined(_WIN32)
+
+				m_file = ::CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+				if (m_file == INVALID_HANDLE_VALUE)
+				{
+					return false;
+				}
+
+				LARGE_INTEGER end;
+
+				end.QuadPart = static_cast<LONGLONG>(size);
+
+				if (!::SetFilePointerEx(m_file, end, nullptr, FILE_BEGIN) || !::SetEndOfFile(m_file)
+					|| !(m_mapping = ::CreateFileMappingA(m_file, nullptr, PAGE_READWRITE, 0, 0, nullptr))
+					|| !(m_data = static_cast<char*>(::MapViewOfFile(m_mapping, FILE_MAP_WRITE, 0, 0, size))))
+				{
+					close();
+
+					return false;
+				}
+
+#else
+
+				m_fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+				if (m_fd == -1)
+				{
+					return false;
+				}
+
+				// reserve the blocks now, so that a full disk fails here and not on a page fault later
+#if defined(__linux__)
+				const bool allocated = ::posix_fallocate(m_fd, 0, static_cast<off_t>(size)) == 0 || ::ftruncate(m_fd, static_cast<off_t>(size)) == 0;
+#else
+				const bool allocated = ::ftruncate(m_fd, static_cast<off_t>(size)) == 0;
+#endif
+
+				void* data = allocated ? ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0) : MAP_FAILED;
+
+				if (data == MAP_FAILED)
+				{
+					close();
+
+					return false;
+				}
+
+				m_data = static_cast<char*>(data);
+
+#endif
+
+				m_size = size;
+
+				return true;
+			}
+
+			//
+			//	Starts write-back without waiting for it
+			//
+			void flush()
+			{
+				if (!m_data)
+				{
+					return;
+				}
+
+#if defined(_WIN32)
+				::FlushViewOfFile(m_data, 0);
+#else
+				::msync(m_data, m_size, MS_ASYNC);
+#endif
+			}
+
+			void close()
+			{
+				flush();
+
+#if defined(_WIN32)
+
+				if (m_data)
+				{
+					::UnmapViewOfFile(m_data);
+				}
+
+				if (m_mapping)
+				{
+					::CloseHandle(m_mapping);
+				}
+
+				if (m_file != INVALID_HANDLE_VALUE)
+				{
+					::CloseHandle(m_file);
+				}
+
+				m_mapping = nullptr;
+
+				m_file = INVALID_HANDLE_VALUE;
+
+#else
+
+				if (m_data)
+				{
+					::munmap(m_data, m_size);
+				}
+
+				if (m_fd != -1)
+				{
+					::close(m_fd);
+				}
+
+				m_fd = -1;
+
+#endif
+
+				m_data = nullptr;
+
+				m_size = 0;
+			}
+
+			char* data() const
+			{
+				return m_data;
+			}
+
+			size_t size() const
+			{
+				return m_size;
+			}
+
+		private:
+
+#if defined(_WIN32)
+
+			HANDLE m_file = INVALID_HANDLE_VALUE;
+
+			HANDLE m_mapping = nullptr;
+
+#else
+
+			int m_fd = -1;
+
+#endif
+
+			char* m_data = nullptr;
+
+			size_t m_size = 0;
+		};
+	}
+
+	//
+	//	Streams drained zones into a rotating set of memory-mapped files.
+	//	Runs on the collector thread; profiled threads only pay for ZoneBuffer::push.
+	//	Disk usage is bounded by fileSize * fileCount; the oldest file is overwritten first.
+	//
+	class BinaryTraceWriter : public ZoneSink
+	{
+	public:
+
+		explicit BinaryTraceWriter(const std::string& basePath, size_t fileSize = SIV_BINARY_TRACE_FILE_SIZE, unsigned fileCount = 8)
+			: m_basePath(basePath)
+			, m_fileSize(std::max<size_t>(fileSize, 64 * 1024) / sizeof(BinaryTraceRecord) * sizeof(BinaryTraceRecord))
+			, m_fileCount(std::max(fileCount, 1u))
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			openFile();
+		}
+
+		~BinaryTraceWriter()
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			publish();
+
+			m_file.close();
+		}
+
+		bool isOpen() const
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			return m_file.data() != nullptr;
+		}
+
+		void onZoneRecords(unsigned threadIndex, const ZoneRecord* records, size_t count) override
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			for (size_t i = 0; i < count; ++i)
+			{
+				writeZone(threadIndex, records[i]);
+			}
+
+			publish();
+		}
+
+		//
+		//	Starts write-back of the current file
+		//
+		void flush()
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			publish();
+
+			m_file.flush();
+		}
+
+		unsigned long long recordCount() const
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			return m_written;
+		}
+
+		// zones lost because a file could not be created, or because their name did not fit in the name table
+		unsigned long long dropped() const
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			return m_dropped;
+		}
+
+	private:
+
+		struct ThreadState
+		{
+			unsigned long long lastEnd = 0;
+
+			// sequence of the file the thread was last written to
+			unsigned long long sequence = ~0ULL;
+		};
+
+		mutable std::mutex m_mutex;
+
+		const std::string m_basePath;
+
+		const size_t m_fileSize;
+
+		const unsigned m_fileCount;
+
+		const unsigned long long m_session = detail::ReadTSC();
+
+		detail::MappedTraceFile m_file;
+
+		unsigned long long m_sequence = 0;
+
+		size_t m_used = 0;
+
+		size_t m_capacity = 0;
+
+		std::unordered_map<const char*, std::uint16_t> m_ids;
+
+		std::vector<const char*> m_names;
+
+		// records taken by the names at the start of every file
+		size_t m_nameRecords = 0;
+
+		std::vector<ThreadState> m_threads;
+
+		unsigned long long m_written = 0;
+
+		unsigned long long m_dropped = 0;
+
+		static const size_t MaxNameLength = 1024;
+
+		// returned by intern() for a name that is not written
+		static const std::uint16_t NoZoneId = 0xFFFF;
+
+		BinaryTraceHeader& header()
+		{
+			return *reinterpret_cast<BinaryTraceHeader*>(m_file.data());
+		}
+
+		BinaryTraceRecord* records()
+		{
+			return reinterpret_cast<BinaryTraceRecord*>(m_file.data() + sizeof(BinaryTraceHeader));
+		}
+
+		void publish()
+		{
+			if (m_file.data())
+			{
+				header().recordCount = m_used;
+			}
+		}
+
+		bool openFile()
+		{
+			const unsigned index = static_cast<unsigned>(m_sequence % m_fileCount);
+
+			if (!m_file.open(detail::BinaryTracePath(m_basePath, index), m_fileSize))
+			{
+				return false;
+			}
+
+			BinaryTraceHeader& h = header();
+
+			std::memset(&h, 0, sizeof(h));
+			std::memcpy(h.magic, detail::BinaryTraceMagic, sizeof(h.magic));
+			h.version = detail::BinaryTraceVersion;
+			h.fileCount = m_fileCount;
+			h.sequence = m_sequence;
+			h.tscFrequency = GetTSCFrequency().frequency;
+			h.session = m_session;
+
+			m_used = 0;
+
+			m_capacity = (m_fileSize - sizeof(BinaryTraceHeader)) / sizeof(BinaryTraceRecord);
+
+			// every file repeats the zone names, so that any suffix of the set can be decoded;
+			// intern() keeps them within half a file, so this never rotates
+			for (size_t id = 0; id < m_names.size(); ++id)
+			{
+				writeName(static_cast<std::uint16_t>(id), allocate(NameRecords(m_names[id])));
+			}
+
+			return true;
+		}
+
+		void rotate()
+		{
+			publish();
+
+			m_file.close();
+
+			++m_sequence;
+
+			openFile();
+		}
+
+		//
+		//	Returns space for n consecutive records in the current file, or nullptr; never rotates
+		//
+		BinaryTraceRecord* allocate(size_t n)
+		{
+			if (!m_file.data() || m_used + n > m_capacity)
+			{
+				return nullptr;
+			}
+
+			BinaryTraceRecord* r = records() + m_used;
+
+			m_used += n;
+
+			m_written += n;
+
+			return r;
+		}
+
+		//
+		//	Next record; the caller has checked the capacity
+		//
+		BinaryTraceRecord* next()
+		{
+			++m_written;
+
+			return records() + m_used++;
+		}
+
+		static size_t NameLength(const char* name)
+		{
+			return std::min(std::strlen(name), MaxNameLength);
+		}
+
+		//
+		//	ZoneName record followed by the name
+		//
+		static size_t NameRecords(const char* name)
+		{
+			return 1 + (NameLength(name) + sizeof(BinaryTraceRecord) - 1) / sizeof(BinaryTraceRecord);
+		}
+
+		void writeName(std::uint16_t id, BinaryTraceRecord* r)
+		{
+			if (!r)
+			{
+				return;
+			}
+
+			const char* name = m_names[id];
+
+			const size_t length = NameLength(name);
+
+			std::memset(r, 0, NameRecords(name) * sizeof(BinaryTraceRecord));
+
+			r->type = static_cast<std::uint8_t>(BinaryTraceRecordType::ZoneName);
+			r->zone = id;
+			r->endDelta = static_cast<std::uint32_t>(length);
+
+			std::memcpy(r + 1, name, length);
+		}
+
+		std::uint16_t intern(const char* name)
+		{
+			const auto it = m_ids.find(name);
+
+			if (it != m_ids.end())
+			{
+				return it->second;
+			}
+
+			if (m_names.size() == 0xFFFF)
+			{
+				// id space exhausted: the last id is shared
+				return 0xFFFE;
+			}
+
+			const size_t records = NameRecords(name);
+
+			// names must leave room for zones in every file
+			if (m_nameRecords + records > (m_fileSize - sizeof(BinaryTraceHeader)) / sizeof(BinaryTraceRecord) / 2)
+			{
+				return NoZoneId;
+			}
+
+			// rotate before the name joins the table, or the new file would repeat it
+			if (m_file.data() && m_used + records > m_capacity)
+			{
+				rotate();
+			}
+
+			const std::uint16_t id = static_cast<std::uint16_t>(m_names.size());
+
+			m_ids.emplace(name, id);
+
+			m_names.push_back(name);
+
+			m_nameRecords += records;
+
+			writeName(id, allocate(records));
+
+			return id;
+		}
+
+		void writeZone(unsigned threadIndex, const ZoneRecord& zone)
+		{
+			const std::uint16_t id = intern(zone.name);
+
+			if (id == NoZoneId)
+			{
+				++m_dropped;
+
+				return;
+			}
+
+			if (threadIndex >= m_threads.size())
+			{
+				m_threads.resize(threadIndex + 1);
+			}
+
+			ThreadState& thread = m_threads[threadIndex];
+
+			const unsigned long long duration = zone.end - zone.begin;
+
+			// worst case: timestamp + long duration + zone
+			if (m_file.data() && m_used + 3 > m_capacity)
+			{
+				rotate();
+			}
+
+			if (!m_file.data() || m_used + 3 > m_capacity)
+			{
+				++m_dropped;
+
+				return;
+			}
+
+			const bool rebase = thread.sequence != m_sequence || zone.end < thread.lastEnd || zone.end - thread.lastEnd > 0xFFFFFFFFULL;
+
+			if (rebase)
+			{
+				BinaryTraceRecord* r = next();
+
+				std::memset(r, 0, sizeof(*r));
+				r->type = static_cast<std::uint8_t>(BinaryTraceRecordType::Timestamp);
+				r->thread = threadIndex;
+				r->setValue(zone.end);
+
+				thread.lastEnd = zone.end;
+
+				thread.sequence = m_sequence;
+			}
+
+			if (duration >= 0xFFFFFFFFULL)
+			{
+				BinaryTraceRecord* r = next();
+
+				std::memset(r, 0, sizeof(*r));
+				r->type = static_cast<std::uint8_t>(BinaryTraceRecordType::LongDuration);
+				r->thread = threadIndex;
+				r->setValue(duration);
+			}
+
+			BinaryTraceRecord* r = next();
+
+			std::memset(r, 0, sizeof(*r));
+			r->type = static_cast<std::uint8_t>(BinaryTraceRecordType::Zone);
+			r->depth = static_cast<std::uint8_t>(std::min(zone.depth, 255u));
+			r->zone = id;
+			r->thread = threadIndex;
+			r->endDelta = static_cast<std::uint32_t>(zone.end - thread.lastEnd);
+			r->duration = duration >= 0xFFFFFFFFULL ? 0xFFFFFFFFu : static_cast<std::uint32_t>(duration);
+
+			thread.lastEnd = zone.end;
+		}
+	};
+
+	//
+	//	Offline decoder: replays a file set into any ZoneSink (ChromeTraceWriter, CollapsedStackWriter, ZoneHistogramSink, ...).
+	//	Timestamps are rescaled to this machine's TSC frequency, so TSCToNanosec gives the recorded durations.
+	//	Zone names are owned by the reader and must outlive the sink's use of them.
+	//
+	class BinaryTraceReader
+	{
+	public:
+
+		explicit BinaryTraceReader(const std::string& basePath)
+		{
+			BinaryTraceHeader first;
+
+			if (!readHeader(detail::BinaryTracePath(basePath, 0), first))
+			{
+				return;
+			}
+
+			for (unsigned i = 0; i < first.fileCount; ++i)
+			{
+				File file;
+
+				file.path = detail::BinaryTracePath(basePath, i);
+
+				// file 0 is the first one a writer creates, so it always belongs to the latest capture
+				if (readHeader(file.path, file.header) && file.header.session == first.session)
+				{
+					m_files.push_back(file);
+				}
+			}
+
+			std::sort(m_files.begin(), m_files.end(), [](const File& a, const File& b)
+			{
+				return a.header.sequence < b.header.sequence;
+			});
+		}
+
+		bool isOpen() const
+		{
+			return !m_files.empty();
+		}
+
+		size_t fileCount() const
+		{
+			return m_files.size();
+		}
+
+		//
+		//	Earliest timestamp in the set, in this machine's ticks (pass to ChromeTraceWriter as baseTicks)
+		//
+		unsigned long long baseTicks()
+		{
+			struct EarliestBegin : ZoneSink
+			{
+				unsigned long long begin = ~0ULL;
+
+				void onZoneRecords(unsigned, const ZoneRecord* records, size_t count) override
+				{
+					for (size_t i = 0; i < count; ++i)
+					{
+						begin = std::min(begin, records[i].begin);
+					}
+				}
+			} earliest;
+
+			replay(earliest);
+
+			return earliest.begin == ~0ULL ? 0 : earliest.begin;
+		}
+
+		//
+		//	Returns the number of zones replayed
+		//
+		unsigned long long replay(ZoneSink& sink)
+		{
+			unsigned long long count = 0;
+
+			std::vector<ZoneRecord> batch;
+
+			unsigned batchThread = 0;
+
+			const auto deliver = [&]()
+			{
+				if (!batch.empty())
+				{
+					sink.onZoneRecords(batchThread, batch.data(), batch.size());
+
+					batch.clear();
+				}
+			};
+
+			forEachFile([&](const File& file, const std::vector<BinaryTraceRecord>& records)
+			{
+				std::vector<const char*> names;
+
+				std::vector<unsigned long long> lastEnd;
+
+				unsigned long long longDuration = 0;
+
+				for (size_t i = 0; i < records.size(); ++i)
+				{
+					const BinaryTraceRecord& r = records[i];
+
+					if (r.thread >= lastEnd.size() && r.type != static_cast<std::uint8_t>(BinaryTraceRecordType::ZoneName))
+					{
+						lastEnd.resize(r.thread + 1, 0);
+					}
+
+					switch (static_cast<BinaryTraceRecordType>(r.type))
+					{
+					case BinaryTraceRecordType::ZoneName:
+					{
+						const size_t extra = (r.endDelta + sizeof(BinaryTraceRecord) - 1) / sizeof(BinaryTraceRecord);
+
+						if (i + extra >= records.size())
+						{
+							i = records.size();
+
+							break;
+						}
+
+						if (r.zone >= names.size())
+						{
+							names.resize(r.zone + 1, "(unknown)");
+						}
+
+						names[r.zone] = intern(std::string(reinterpret_cast<const char*>(&records[i + 1]), r.endDelta));
+
+						i += extra;
+
+						break;
+					}
+					case BinaryTraceRecordType::Timestamp:
+						lastEnd[r.thread] = r.value();
+						break;
+					case BinaryTraceRecordType::LongDuration:
+						longDuration = r.value();
+						break;
+					case BinaryTraceRecordType::Zone:
+					{
+						const unsigned long long end = lastEnd[r.thread] + r.endDelta;
+
+						const unsigned long long duration = r.duration == 0xFFFFFFFFu ? longDuration : r.duration;
+
+						lastEnd[r.thread] = end;
+
+						if (batchThread != r.thread || batch.size() == 4096)
+						{
+							deliver();
+
+							batchThread = r.thread;
+						}
+
+						const unsigned long long rescaledEnd = rescale(file, end);
+
+						batch.push_back(ZoneRecord{ r.zone < names.size() ? names[r.zone] : "(unknown)", rescaledEnd - rescale(file, duration), rescaledEnd, r.depth });
+
+						++count;
+
+						break;
+					}
+					default:
+						break;
+					}
+				}
+			});
+
+			deliver();
+
+			return count;
+		}
+
+	private:
+
+		struct File
+		{
+			std::string path;
+
+			BinaryTraceHeader header;
+		};
+
+		std::vector<File> m_files;
+
+		std::deque<std::string> m_storage;
+
+		std::unordered_map<std::string, const char*> m_names;
+
+		static bool readHeader(const std::string& path, BinaryTraceHeader& header)
+		{
+			std::ifstream ifs(path, std::ios::binary);
+
+			return ifs.read(reinterpret_cast<char*>(&header), sizeof(header))
+				&& std::memcmp(header.magic, detail::BinaryTraceMagic, sizeof(header.magic)) == 0
+				&& header.version == detail::BinaryTraceVersion;
+		}
+
+		template <class Function>
+		void forEachFile(Function function)
+		{
+			std::vector<BinaryTraceRecord> records;
+
+			for (const auto& file : m_files)
+			{
+				std::ifstream ifs(file.path, std::ios::binary);
+
+				BinaryTraceHeader header;
+
+				// re-read the header: the writer may have advanced since the reader was created
+				if (!ifs.read(reinterpret_cast<char*>(&header), sizeof(header)) || header.sequence != file.header.sequence)
+				{
+					continue;
+				}
+
+				records.resize(static_cast<size_t>(header.recordCount));
+
+				ifs.read(reinterpret_cast<char*>(records.data()), records.size() * sizeof(BinaryTraceRecord));
+
+				records.resize(static_cast<size_t>(ifs.gcount()) / sizeof(BinaryTraceRecord));
+
+				function(file, records);
+			}
+		}
+
+		static unsigned long long rescale(const File& file, unsigned long long ticks)
+		{
+			const unsigned long long local = GetTSCFrequency().frequency;
+
+			if (file.header.tscFrequency == local || file.header.tscFrequency == 0)
+			{
+				return ticks;
+			}
+
+			return static_cast<unsigned long long>(static_cast<long double>(ticks) * local / file.header.tscFrequency);
+		}
+
+		const char* intern(const std::string& name)
+		{
+			const auto it = m_names.find(name);
+
+			if (it != m_names.end())
+			{
+				return it->second;
+			}
+
+			m_storage.push_back(name);
+
+			const char* s = m_storage.back().c_str();
+
+			m_names.emplace(name, s);
+
+			return s;
+		}
+	};
+
+	//
+	//	Decoder command line: <base path> [--chrome=<path>] [--collapsed=<path>] [--latency]
+	//
+	inline int RunBinaryTraceDecoderMain(int argc, char** argv)
+	{
+		std::string basePath, chromePath, collapsedPath;
+
+		bool latency = false;
+
+		for (int i = 1; i < argc; ++i)
+		{
+			const std::string arg = argv[i];
+
+			if (arg.compare(0, 9, "--chrome=") == 0)
+			{
+				chromePath = arg.substr(9);
+			}
+			else if (arg.compare(0, 12, "--collapsed=") == 0)
+			{
+				collapsedPath = arg.substr(12);
+			}
+			else if (arg == "--latency")
+			{
+				latency = true;
+			}
+			else if (basePath.empty() && arg.compare(0, 2, "--") != 0)
+			{
+				basePath = arg;
+			}
+			else
+			{
+				std::cerr << "unknown option: " << arg << '\n';
+
+				return 2;
+			}
+		}
+
+		BinaryTraceReader reader(basePath);
+
+		if (!reader.isOpen())
+		{
+			std::cerr << "cannot read " << detail::BinaryTracePath(basePath, 0) << '\n';
+
+			return 1;
+		}
+
+		if (!chromePath.empty())
+		{
+			std::ofstream ofs(chromePath);
+
+			ChromeTraceWriter writer(ofs, 1, reader.baseTicks());
+
+			reader.replay(writer);
+		}
+
+		if (!collapsedPath.empty())
+		{
+			std::ofstream ofs(collapsedPath);
+
+			CollapsedStackWriter writer(ofs);
+
+			reader.replay(writer);
+
+			writer.flush();
+		}
+
+		if (latency || (chromePath.empty() && collapsedPath.empty()))
+		{
+			ZoneHistogramSink histograms;
+
+			reader.replay(histograms);
+
+			WriteLatencyReports(std::cout, histograms.getReports());
+		}
+
+		return 0;
+	}
+}
@@ -0,0 +1,441 @@
+﻿//------------------------------------------
+//	CompactOptional.hpp
+//	Copyright (c) 2014 Reputeless
+//	<reputeless@gmail.com>
+//	Distributed under the MIT license.
+//------------------------------------------
+
+# pragma once
+# include <cstdint>
+# include <cstring>
+# include <limits>
+# include "Optional.hpp"
+
+namespace siv
+{
+	//
+	//	Storage policies: empty_value() is stored for "no value", is_empty() recognizes it
+	//
+
+	//
+	//	A reserved value of an integral, enum or pointer type, e.g. sentinel_policy<int, -1>
+	//
+	template <class T, T Sentinel>
+	struct sentinel_policy
+	{
+		static T empty_value()
+		{
+			return Sentinel;
+		}
+
+		static bool is_empty(const T& v)
+		{
+			return v == Sentinel;
+		}
+	};
+
+	//
+	//	-1 (all bits set) as "no index"
+	//
+	template <class T>
+	struct index_policy
+	{
+		static_assert(std::is_integral<T>::value, "index_policy requires an integral type");
+
+		static T empty_value()
+		{
+			return static_cast<T>(-1);
+		}
+
+		static bool is_empty(const T& v)
+		{
+			return v == static_cast<T>(-1);
+		}
+	};
+
+	template <class T>
+	struct null_pointer_policy
+	{
+		static_assert(std::is_pointer<T>::value, "null_pointer_policy requires a pointer type");
+
+		static T empty_value()
+		{
+			return nullptr;
+		}
+
+		static bool is_empty(const T& v)
+		{
+			return v == nullptr;
+		}
+	};
+
+	namespace detail
+	{
+		template <class T>
+		struct nan_bits;
+
+		template <>
+		struct nan_bits<float>
+		{
+			typedef std::uint32_t type;
+
+			// quiet NaN with a payload no arithmetic produces on its own
+			static const type empty = 0x7FC05EA1u;
+
+			static const type sign = 0x80000000u;
+		};
+
+		template <>
+		struct nan_bits<double>
+		{
+			typedef std::uint64_t type;
+
+			static const type empty = 0x7FF800005EA1ED00ull;
+
+			static const type sign = 0x8000000000000000ull;
+		};
+	}
+
+	//
+	//	One NaN payload as "no value": ordinary NaNs (0.0 / 0.0) remain values.
+	//	The sign bit is ignored, so a negated empty value stays empty. Conversion between float and double
+	//	changes the payload, and arithmetic need not keep it: values derived from an empty one may read as present NaNs.
+	//
+	template <class T>
+	struct nan_policy
+	{
+		static_assert(std::is_same<T, float>::value || std::is_same<T, double>::value, "nan_policy requires float or double");
+
+		typedef typename detail::nan_bits<T>::type bits_type;
+
+		static T empty_value()
+		{
+			const bits_type bits = detail::nan_bits<T>::empty;
+
+			T v;
+
+			std::memcpy(&v, &bits, sizeof(v));
+
+			return v;
+		}
+
+		static bool is_empty(const T& v)
+		{
+			bits_type bits;
+
+			std::memcpy(&bits, &v, sizeof(bits));
+
+			return (bits & ~detail::nan_bits<T>::sign) == detail::nan_bits<T>::empty;
+		}
+	};
+
+	template <class T, class = void>
+	struct default_compact_policy
+	{
+		static_assert(sizeof(T) == 0, "no default policy for T: name one, e.g. compact_optional<T, index_policy<T>>");
+	};
+
+	template <class T>
+	struct default_compact_policy<T, typename std::enable_if<std::is_floating_point<T>::value>::type> : nan_policy<T> {};
+
+	template <class T>
+	struct default_compact_policy<T, typename std::enable_if<std::is_pointer<T>::value>::type> : null_pointer_policy<T> {};
+
+	//
+	//	optional that encodes "no value" in a reserved value of T: sizeof(compact_optional<T>) == sizeof(T).
+	//	Same observers as optional; storing the reserved value itself is not allowed.
+	//
+	template <class T, class Policy = default_compact_policy<T>>
+	class compact_optional
+	{
+	private:
+
+		T m_value;
+
+	public:
+
+		static_assert(detail::is_trivially_copyable<T>::value, "compact_optional requires a trivially copyable type");
+
+		typedef compact_optional<T, Policy> this_type;
+		typedef T			value_type;
+		typedef Policy		policy_type;
+		typedef const T&	reference_const_type;
+		typedef T&			reference_type;
+		typedef const T*	pointer_const_type;
+		typedef T*			pointer_type;
+
+		//
+		//	Constructors
+		//
+		compact_optional()
+			: m_value(Policy::empty_value()) {}
+
+		compact_optional(nullopt_t)
+			: m_value(Policy::empty_value()) {}
+
+		compact_optional(const value_type& v)
+			: m_value(v)
+		{
+			assert(!Policy::is_empty(v));
+		}
+
+		compact_optional(const optional<T>& another)
+			: m_value(another ? *another : Policy::empty_value())
+		{
+			assert(!another || !Policy::is_empty(*another));
+		}
+
+		//
+		//	Assignment
+		//
+		this_type& operator=(nullopt_t)
+		{
+			m_value = Policy::empty_value();
+
+			return *this;
+		}
+
+		this_type& operator=(const value_type& v)
+		{
+			assert(!Policy::is_empty(v));
+
+			m_value = v;
+
+			return *this;
+		}
+
+		template <class... Args>
+		void emplace(Args&&... args)
+		{
+			*this = value_type(std::forward<Args>(args)...);
+		}
+
+		void swap(this_type& another)
+		{
+			std::swap(m_value, another.m_value);
+		}
+
+		//
+		//	Observers
+		//
+		pointer_const_type operator ->() const
+		{
+			assert(static_cast<bool>(*this));
+
+			return &m_value;
+		}
+
+		pointer_type operator ->()
+		{
+			assert(static_cast<bool>(*this));
+
+			return &m_value;
+		}
+
+		reference_const_type operator *() const
+		{
+			assert(static_cast<bool>(*this));
+
+			return m_value;
+		}
+
+		// writing the reserved value through the reference empties the optional
+		reference_type operator *()
+		{
+			assert(static_cast<bool>(*this));
+
+			return m_value;
+		}
+
+		explicit operator bool() const
+		{
+			return !Policy::is_empty(m_value);
+		}
+
+		reference_const_type value() const
+		{
+			if (!*this)
+			{
+				throw bad_optional_access("bad access");
+			}
+
+			return m_value;
+		}
+
+		reference_type value()
+		{
+			if (!*this)
+			{
+				throw bad_optional_access("bad access");
+			}
+
+			return m_value;
+		}
+
+		template <class U>
+		value_type value_or(U&& v) const
+		{
+			static_assert(std::is_convertible<U&&, value_type>::value, "");
+
+			if (static_cast<bool>(*this))
+			{
+				return m_value;
+			}
+
+			return static_cast<value_type>(std::forward<U>(v));
+		}
+
+		//
+		//	The stored representation, the reserved value when empty; for tables and bulk processing
+		//
+		reference_const_type raw() const
+		{
+			return m_value;
+		}
+
+		optional<T> to_optional() const
+		{
+			if (static_cast<bool>(*this))
+			{
+				return optional<T>(m_value);
+			}
+
+			return optional<T>();
+		}
+	};
+
+	//
+	//	Relational operators
+	//
+	template <class T, class P>
+	bool operator==(const compact_optional<T, P>& x, const compact_optional<T, P>& y)
+	{
+		if (static_cast<bool>(x) != static_cast<bool>(y))
+		{
+			return false;
+		}
+
+		if (!x)
+		{
+			return true;
+		}
+
+		return *x == *y;
+	}
+
+	template <class T, class P>
+	bool operator!=(const compact_optional<T, P>& x, const compact_optional<T, P>& y)
+	{
+		return !(x == y);
+	}
+
+	template <class T, class P>
+	bool operator<(const compact_optional<T, P>& x, const compact_optional<T, P>& y)
+	{
+		if (!y)
+		{
+			return false;
+		}
+		else if (!x)
+		{
+			return true;
+		}
+
+		return *x < *y;
+	}
+
+	template <class T, class P>
+	bool operator>(const compact_optional<T, P>& x, const compact_optional<T, P>& y)
+	{
+		return y < x;
+	}
+
+	template <class T, class P>
+	bool operator<=(const compact_optional<T, P>& x, const compact_optional<T, P>& y)
+	{
+		return !(y < x);
+	}
+
+	template <class T, class P>
+	bool operator>=(const compact_optional<T, P>& x, const compact_optional<T, P>& y)
+	{
+		return !(x < y);
+	}
+
+	//
+	//	Comparison with nullopt
+	//
+	template <class T, class P>
+	bool operator==(const compact_optional<T, P>& x, nullopt_t)
+	{
+		return !x;
+	}
+
+	template <class T, class P>
+	bool operator==(nullopt_t, const compact_optional<T, P>& x)
+	{
+		return !x;
+	}
+
+	template <class T, class P>
+	bool operator!=(const compact_optional<T, P>& x, nullopt_t)
+	{
+		return static_cast<bool>(x);
+	}
+
+	template <class T, class P>
+	bool operator!=(nullopt_t, const compact_optional<T, P>& x)
+	{
+		return static_cast<bool>(x);
+	}
+
+	//
+	//	Comparison with T
+	//
+	template <class T, class P>
+	bool operator==(const compact_optional<T, P>& x, const T& v)
+	{
+		return static_cast<bool>(x) ? (*x == v) : false;
+	}
+
+	template <class T, class P>
+	bool operator==(const T& v, const compact_optional<T, P>& x)
+	{
+		return static_cast<bool>(x) ? (v == *x) : false;
+	}
+
+	template <class T, class P>
+	bool operator!=(const compact_optional<T, P>& x, const T& v)
+	{
+		return !(x == v);
+	}
+
+	template <class T, class P>
+	bool operator!=(const T& v, const compact_optional<T, P>& x)
+	{
+		return !(v == x);
+	}
+}
+
+namespace std
+{
+	template <class T, class P>
+	void swap(siv::compact_optional<T, P>& left, siv::compact_optional<T, P>& right)
+	{
+		left.swap(right);
+	}
+
+	template <class T, class P>
+	struct hash<siv::compact_optional<T, P>>
+	{
+		std::size_t operator() (const siv::compact_optional<T, P>& arg) const
+		{
+			if (arg)
+			{
+				return std::hash<T>{}(*arg);
+			}
+
+			return 0;
+		}
+	};
+}
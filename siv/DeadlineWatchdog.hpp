@@ -0,0 +1,490 @@
+﻿//------------------------------------------
+//	DeadlineWatchdog.hpp
+//	Copyright (c) 2014 Reputeless
+//	<reputeless@gmail.com>
+//	Distributed under the MIT license.
+//------------------------------------------
+
+# pragma once
+# include <cstdio>
+# include <atomic>
+# include <vector>
+# include <mutex>
+# include <thread>
+# include <chrono>
+# include <condition_variable>
+# include <ostream>
+# include "ProfileZone.hpp"
+
+# ifndef SIV_DEADLINE_THREAD_CAPACITY
+#	define SIV_DEADLINE_THREAD_CAPACITY 256
+# endif
+
+# ifndef SIV_DEADLINE_REPORT_CAPACITY
+#	define SIV_DEADLINE_REPORT_CAPACITY 16
+# endif
+
+# ifdef SIV_DISABLE_PROFILE_ZONE
+#	define SIV_DEADLINE_SCOPE(name, budgetMicrosec) ((void)0)
+# else
+#	define SIV_DEADLINE_SCOPE(name, budgetMicrosec) const siv::DeadlineScope SIV_PROFILE_ZONE_CAT(sivDeadlineScope_, __LINE__)(name, budgetMicrosec)
+# endif
+
+namespace siv
+{
+	//
+	//	Captured by the watchdog while the late scope was still open
+	//
+	struct DeadlineViolation
+	{
+		static const unsigned MaxZones = ZoneBuffer::StackCapacity;
+
+		static const unsigned MaxEvents = 32;
+
+		const char* name;
+
+		unsigned threadIndex;
+
+		unsigned long long budgetMicrosec;
+
+		// time the scope had been open when it was caught
+		unsigned long long elapsedMicrosec;
+
+		// GetMicrosec() at detection
+		unsigned long long detectedMicrosec;
+
+		// open zones of the thread, outermost first
+		unsigned zoneCount;
+
+		const char* zones[MaxZones];
+
+		// zones the thread completed last, oldest first
+		unsigned eventCount;
+
+		ZoneRecord events[MaxEvents];
+	};
+
+	namespace detail
+	{
+		//
+		//	Innermost open deadline scope of one thread; written by the thread, read by the watchdog
+		//
+		struct alignas(64) DeadlineSlot
+		{
+			std::atomic<bool> used{ false };
+
+			// set while the watchdog reads the thread's ZoneBuffer, which must outlive the read
+			std::atomic<bool> capturing{ false };
+
+			// the owner's; stale once the slot is released, so read it only while the scope check() saw is still open
+			std::atomic<ZoneBuffer*> buffer{ nullptr };
+
+			// 0 while no scope is open
+			std::atomic<unsigned long long> deadline{ 0 };
+
+			std::atomic<unsigned long long> begin{ 0 };
+
+			std::atomic<unsigned long long> id{ 0 };
+
+			std::atomic<const char*> name{ nullptr };
+
+			// last id handed out; kept across owners so ids never repeat within a slot
+			unsigned long long sequence = 0;
+		};
+	}
+
+	//
+	//	Low-frequency thread that catches deadline scopes still open past their budget.
+	//	Reports are written into storage allocated up front; the newest overwrite the oldest.
+	//
+	class DeadlineWatchdog
+	{
+	public:
+
+		static const unsigned ThreadCapacity = SIV_DEADLINE_THREAD_CAPACITY;
+
+		static const unsigned ReportCapacity = SIV_DEADLINE_REPORT_CAPACITY;
+
+		DeadlineWatchdog()
+			: m_reports(ReportCapacity) {}
+
+		~DeadlineWatchdog()
+		{
+			stop();
+		}
+
+		DeadlineWatchdog(const DeadlineWatchdog&) = delete;
+
+		DeadlineWatchdog& operator=(const DeadlineWatchdog&) = delete;
+
+		void start(std::chrono::microseconds period = std::chrono::milliseconds(1))
+		{
+			stop();
+
+			m_running = true;
+
+			m_thread = std::thread([this, period]()
+			{
+				std::unique_lock<std::mutex> lock(m_threadMutex);
+
+				while (m_running)
+				{
+					m_condition.wait_for(lock, period);
+
+					lock.unlock();
+
+					check();
+
+					lock.lock();
+				}
+			});
+		}
+
+		void stop()
+		{
+			if (!m_thread.joinable())
+			{
+				return;
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(m_threadMutex);
+
+				m_running = false;
+			}
+
+			m_condition.notify_all();
+
+			m_thread.join();
+		}
+
+		//
+		//	Scans every thread once; called by the watchdog thread
+		//
+		void check()
+		{
+			std::lock_guard<std::mutex> lock(m_checkMutex);
+
+			const unsigned long long now = MicrosecClock::Now();
+
+			for (unsigned i = 0; i < ThreadCapacity; ++i)
+			{
+				detail::DeadlineSlot& slot = m_slots[i];
+
+				const unsigned long long deadline = slot.deadline.load(std::memory_order_acquire);
+
+				if (deadline == 0 || now <= deadline)
+				{
+					continue;
+				}
+
+				const unsigned long long id = slot.id.load(std::memory_order_relaxed);
+
+				// a stall is reported once, for the innermost late scope
+				if (id <= m_reportedIDs[i])
+				{
+					continue;
+				}
+
+				capture(slot, i, deadline, id, now);
+			}
+		}
+
+		//
+		//	Captured violations, oldest first
+		//
+		std::vector<DeadlineViolation> getViolations() const
+		{
+			std::lock_guard<std::mutex> lock(m_checkMutex);
+
+			const unsigned long long count = m_reportCount;
+
+			const unsigned long long first = count > ReportCapacity ? count - ReportCapacity : 0;
+
+			std::vector<DeadlineViolation> violations;
+
+			for (unsigned long long i = first; i < count; ++i)
+			{
+				violations.push_back(m_reports[i % ReportCapacity]);
+			}
+
+			return violations;
+		}
+
+		// violations caught, including those overwritten
+		unsigned long long violationCount() const
+		{
+			std::lock_guard<std::mutex> lock(m_checkMutex);
+
+			return m_reportCount;
+		}
+
+		// scopes that closed past their budget, whether or not the watchdog caught them open
+		unsigned long long missedCount() const
+		{
+			return m_missed.load(std::memory_order_relaxed);
+		}
+
+		void clear()
+		{
+			std::lock_guard<std::mutex> lock(m_checkMutex);
+
+			m_reportCount = 0;
+
+			m_missed.store(0, std::memory_order_relaxed);
+		}
+
+		//
+		//	Slot of the calling thread, or nullptr when every slot is taken
+		//
+		detail::DeadlineSlot* acquireSlot()
+		{
+			ZoneBuffer& buffer = GetThreadZoneBuffer();
+
+			for (auto& slot : m_slots)
+			{
+				bool expected = false;
+
+				if (!slot.used.load(std::memory_order_relaxed) && slot.used.compare_exchange_strong(expected, true))
+				{
+					slot.buffer.store(&buffer, std::memory_order_release);
+
+					return &slot;
+				}
+			}
+
+			return nullptr;
+		}
+
+		void releaseSlot(detail::DeadlineSlot& slot)
+		{
+			// ordered before used and capturing: a capture that still reads the deadline is waited out
+			slot.deadline.store(0);
+
+			slot.used.store(false);
+
+			// the ZoneBuffer goes away with the thread: wait out a capture in progress
+			while (slot.capturing.load())
+			{
+				std::this_thread::yield();
+			}
+		}
+
+		void addMissed()
+		{
+			m_missed.fetch_add(1, std::memory_order_relaxed);
+		}
+
+	private:
+
+		detail::DeadlineSlot m_slots[ThreadCapacity];
+
+		// id of the last scope reported per slot; watchdog only
+		unsigned long long m_reportedIDs[ThreadCapacity] = {};
+
+		mutable std::mutex m_checkMutex;
+
+		std::vector<DeadlineViolation> m_reports;
+
+		unsigned long long m_reportCount = 0;
+
+		std::atomic<unsigned long long> m_missed{ 0 };
+
+		std::mutex m_threadMutex;
+
+		std::condition_variable m_condition;
+
+		bool m_running = false;
+
+		std::thread m_thread;
+
+		void capture(detail::DeadlineSlot& slot, unsigned index, unsigned long long deadline, unsigned long long id, unsigned long long now)
+		{
+			slot.capturing.store(true);
+
+			// the owner may have released the slot, and another thread taken it, since check() read it:
+			// while the deadline and id are unchanged, releaseSlot has not run and waits for this capture
+			if (!slot.used.load() || slot.deadline.load() != deadline || slot.id.load() != id)
+			{
+				slot.capturing.store(false);
+
+				return;
+			}
+
+			const ZoneBuffer* buffer = slot.buffer.load(std::memory_order_acquire);
+
+			// filled aside: once the ring has wrapped, the slot holds the oldest report still returned
+			DeadlineViolation report;
+
+			report.name = slot.name.load(std::memory_order_relaxed);
+
+			report.threadIndex = buffer->threadIndex();
+
+			const unsigned long long begin = slot.begin.load(std::memory_order_relaxed);
+
+			report.budgetMicrosec = deadline - begin;
+
+			report.elapsedMicrosec = now - begin;
+
+			report.detectedMicrosec = now;
+
+			report.zoneCount = buffer->openZones(report.zones, DeadlineViolation::MaxZones);
+
+			report.eventCount = static_cast<unsigned>(buffer->recentRecords(report.events, DeadlineViolation::MaxEvents));
+
+			// the scope closed or changed while being read: the report would mix two scopes
+			const bool consistent = slot.id.load(std::memory_order_acquire) == id && slot.deadline.load(std::memory_order_relaxed) == deadline;
+
+			slot.capturing.store(false);
+
+			if (consistent)
+			{
+				m_reports[m_reportCount % ReportCapacity] = report;
+
+				m_reportedIDs[index] = id;
+
+				++m_reportCount;
+			}
+		}
+	};
+
+	inline DeadlineWatchdog& GetDeadlineWatchdog()
+	{
+		static DeadlineWatchdog watchdog;
+
+		return watchdog;
+	}
+
+	namespace detail
+	{
+		struct ThreadDeadlineSlotOwner
+		{
+			DeadlineSlot* slot = GetDeadlineWatchdog().acquireSlot();
+
+			~ThreadDeadlineSlotOwner()
+			{
+				if (slot)
+				{
+					GetDeadlineWatchdog().releaseSlot(*slot);
+				}
+			}
+		};
+
+		inline DeadlineSlot* ThreadDeadlineSlot()
+		{
+			static thread_local ThreadDeadlineSlotOwner owner;
+
+			return owner.slot;
+		}
+	}
+
+	//
+	//	Declares a latency budget for a scope; use SIV_DEADLINE_SCOPE("name", budgetMicrosec).
+	//	Scopes nest: the watchdog watches the innermost open one of each thread.
+	//
+	class DeadlineScope
+	{
+	public:
+
+		DeadlineScope(const char* name, unsigned long long budgetMicrosec)
+			: m_slot(detail::ThreadDeadlineSlot())
+			, m_budget(budgetMicrosec)
+		{
+			if (!m_slot)
+			{
+				return;
+			}
+
+			m_previousDeadline = m_slot->deadline.load(std::memory_order_relaxed);
+			m_previousBegin = m_slot->begin.load(std::memory_order_relaxed);
+			m_previousID = m_slot->id.load(std::memory_order_relaxed);
+			m_previousName = m_slot->name.load(std::memory_order_relaxed);
+
+			publish(name, m_clock.start, m_clock.start + budgetMicrosec, ++m_slot->sequence);
+		}
+
+		~DeadlineScope()
+		{
+#if SIV_HAS_PROPERTY
+			const unsigned long long elapsed = m_clock.elapsed;
+#else
+			const unsigned long long elapsed = m_clock.elapsed();
+#endif
+
+			if (elapsed > m_budget)
+			{
+				GetDeadlineWatchdog().addMissed();
+			}
+
+			if (m_slot)
+			{
+				publish(m_previousName, m_previousBegin, m_previousDeadline, m_previousID);
+			}
+		}
+
+		DeadlineScope(const DeadlineScope&) = delete;
+
+		DeadlineScope& operator=(const DeadlineScope&) = delete;
+
+	private:
+
+		detail::DeadlineSlot* m_slot;
+
+		unsigned long long m_budget;
+
+		MicrosecClock m_clock;
+
+		unsigned long long m_previousDeadline = 0;
+
+		unsigned long long m_previousBegin = 0;
+
+		unsigned long long m_previousID = 0;
+
+		const char* m_previousName = nullptr;
+
+		void publish(const char* name, unsigned long long begin, unsigned long long deadline, unsigned long long id)
+		{
+			// hide the slot while it is inconsistent
+			m_slot->deadline.store(0, std::memory_order_relaxed);
+
+			m_slot->name.store(name, std::memory_order_relaxed);
+
+			m_slot->begin.store(begin, std::memory_order_relaxed);
+
+			m_slot->id.store(id, std::memory_order_relaxed);
+
+			m_slot->deadline.store(deadline, std::memory_order_release);
+		}
+	};
+
+	inline void WriteDeadlineViolation(std::ostream& os, const DeadlineViolation& violation)
+	{
+		char line[256];
+
+		std::snprintf(line, sizeof(line), "deadline missed: %s on thread %u, open %lluus of %lluus budget\n",
+			violation.name, violation.threadIndex, violation.elapsedMicrosec, violation.budgetMicrosec);
+
+		os << line;
+
+		os << "  open zones:\n";
+
+		for (unsigned i = 0; i < violation.zoneCount; ++i)
+		{
+			os << "    " << std::string(i * 2, ' ') << violation.zones[i] << '\n';
+		}
+
+		os << "  recent zones:\n";
+
+		const unsigned long long last = violation.eventCount ? violation.events[violation.eventCount - 1].end : 0;
+
+		for (unsigned i = 0; i < violation.eventCount; ++i)
+		{
+			const ZoneRecord& r = violation.events[i];
+
+			std::snprintf(line, sizeof(line), "    -%10.1fus %10.1fus  %s\n",
+				TSCToNanosec(last - r.end) / 1000.0, TSCToNanosec(r.end - r.begin) / 1000.0, r.name);
+
+			os << line;
+		}
+	}
+}
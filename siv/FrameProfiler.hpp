@@ -0,0 +1,476 @@
+﻿//------------------------------------------
+//	FrameProfiler.hpp
+//	Copyright (c) 2014 Reputeless
+//	<reputeless@gmail.com>
+//	Distributed under the MIT license.
+//------------------------------------------
+
+# pragma once
+# include <cstring>
+# include <vector>
+# include <string>
+# include <mutex>
+# include <functional>
+# include <algorithm>
+# include <ostream>
+# include "Profiler.hpp"
+
+# define SIV_FRAME_ZONE_CAT_IMPL(a, b) a##b
+# define SIV_FRAME_ZONE_CAT(a, b) SIV_FRAME_ZONE_CAT_IMPL(a, b)
+# define SIV_FRAME_ZONE(profiler, name) const siv::FrameZone SIV_FRAME_ZONE_CAT(sivFrameZone_, __LINE__)(profiler, name)
+
+namespace siv
+{
+	//
+	//	Zone inside a frame; stored in begin order, times in microseconds.
+	//	A zone open across a frame mark is split: it ends with one frame and begins again with the next.
+	//
+	struct FrameZoneEvent
+	{
+		const char* name;
+
+		unsigned long long begin;
+
+		unsigned long long end;
+
+		unsigned depth;
+	};
+
+	struct FrameRecord
+	{
+		unsigned long long index = 0;
+
+		unsigned long long begin = 0;
+
+		unsigned long long duration = 0;
+
+		bool overBudget = false;
+
+		// more zones than maxZonesPerFrame were opened
+		bool truncated = false;
+
+		std::vector<FrameZoneEvent> zones;
+	};
+
+	struct FrameZoneNode
+	{
+		const char* name = nullptr;
+
+		unsigned long long begin = 0;
+
+		unsigned long long duration = 0;
+
+		std::vector<FrameZoneNode> children;
+	};
+
+	//
+	//	Fixed-rate loop profiler: keeps the last N frames and snapshots frames over budget.
+	//	Frames and zones must be marked from the loop's thread; getters may be called from any thread.
+	//
+	class FrameProfiler
+	{
+	public:
+
+		explicit FrameProfiler(unsigned long long budgetMicrosec, size_t historySize = 120, size_t maxZonesPerFrame = 256, size_t maxSnapshots = 16)
+			: m_budget(budgetMicrosec)
+			, m_maxZones(maxZonesPerFrame)
+			, m_history(std::max<size_t>(historySize, 1) + 1)
+			, m_snapshots(std::max<size_t>(maxSnapshots, 1))
+		{
+			// everything is allocated here so that frames never allocate
+			for (auto& frame : m_history)
+			{
+				frame.zones.reserve(m_maxZones);
+			}
+
+			for (auto& snapshot : m_snapshots)
+			{
+				snapshot.zones.reserve(m_maxZones);
+			}
+
+			m_open.reserve(m_maxZones);
+		}
+
+		FrameProfiler(const FrameProfiler&) = delete;
+
+		FrameProfiler& operator=(const FrameProfiler&) = delete;
+
+		void beginFrame()
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			FrameRecord& frame = m_history[m_current];
+
+			frame.index = m_frameCount;
+			frame.begin = MicrosecClock::Now();
+			frame.duration = 0;
+			frame.overBudget = false;
+			frame.truncated = false;
+			frame.zones.clear();
+
+			m_inFrame = true;
+
+			// zones still open continue in this frame
+			for (size_t i = 0; i < m_open.size(); ++i)
+			{
+				m_open[i].slot = addZone(frame, m_open[i].name, frame.begin, static_cast<unsigned>(i));
+			}
+		}
+
+		void endFrame()
+		{
+			if (!m_inFrame)
+			{
+				return;
+			}
+
+			const unsigned long long now = MicrosecClock::Now();
+
+			std::function<void(const FrameRecord&)> callback;
+
+			const FrameRecord* snapshot = nullptr;
+
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+
+				FrameRecord& frame = m_history[m_current];
+
+				// zones still open end with the frame
+				for (const auto& open : m_open)
+				{
+					if (open.slot < frame.zones.size())
+					{
+						frame.zones[open.slot].end = now;
+					}
+				}
+
+				frame.duration = now - frame.begin;
+
+				frame.overBudget = frame.duration > m_budget;
+
+				if (frame.overBudget)
+				{
+					FrameRecord& slot = m_snapshots[m_overrunCount % m_snapshots.size()];
+
+					slot.index = frame.index;
+					slot.begin = frame.begin;
+					slot.duration = frame.duration;
+					slot.overBudget = true;
+					slot.truncated = frame.truncated;
+					slot.zones.assign(frame.zones.begin(), frame.zones.end());
+
+					++m_overrunCount;
+
+					snapshot = &slot;
+
+					callback = m_overrunCallback;
+				}
+
+				m_current = (m_current + 1) % m_history.size();
+
+				++m_frameCount;
+
+				m_inFrame = false;
+			}
+
+			if (callback)
+			{
+				callback(*snapshot);
+			}
+		}
+
+		//
+		//	Ends the running frame (if any) and begins the next one
+		//
+		void markFrame()
+		{
+			endFrame();
+
+			beginFrame();
+		}
+
+		//
+		//	Zones nest: endZone closes the innermost open zone
+		//
+		void beginZone(const char* name)
+		{
+			const unsigned depth = static_cast<unsigned>(m_open.size());
+
+			size_t slot = ~size_t(0);
+
+			if (m_inFrame)
+			{
+				slot = addZone(m_history[m_current], name, MicrosecClock::Now(), depth);
+			}
+
+			m_open.push_back(OpenZone{ name, slot });
+		}
+
+		void endZone()
+		{
+			if (m_open.empty())
+			{
+				return;
+			}
+
+			FrameRecord& frame = m_history[m_current];
+
+			// the slot refers to the running frame: markFrame reassigns it
+			if (m_inFrame && m_open.back().slot < frame.zones.size())
+			{
+				frame.zones[m_open.back().slot].end = MicrosecClock::Now();
+			}
+
+			m_open.pop_back();
+		}
+
+		//
+		//	Called on the loop thread, after the frame is stored, with the snapshot of an offending frame
+		//
+		void setOverrunCallback(std::function<void(const FrameRecord&)> callback)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			m_overrunCallback = std::move(callback);
+		}
+
+		void setBudget(unsigned long long budgetMicrosec)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			m_budget = budgetMicrosec;
+		}
+
+		unsigned long long budget() const
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			return m_budget;
+		}
+
+		unsigned long long frameCount() const
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			return m_frameCount;
+		}
+
+		unsigned long long overrunCount() const
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			return m_overrunCount;
+		}
+
+		//
+		//	Completed frames, oldest first
+		//
+		std::vector<FrameRecord> getHistory() const
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			std::vector<FrameRecord> history;
+
+			const size_t completed = static_cast<size_t>(std::min<unsigned long long>(m_frameCount, m_history.size() - 1));
+
+			for (size_t i = completed; i > 0; --i)
+			{
+				history.push_back(m_history[(m_current + m_history.size() - i) % m_history.size()]);
+			}
+
+			return history;
+		}
+
+		//
+		//	Most recent over-budget frames, oldest first
+		//
+		std::vector<FrameRecord> getOverruns() const
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			std::vector<FrameRecord> overruns;
+
+			const unsigned long long kept = std::min<unsigned long long>(m_overrunCount, m_snapshots.size());
+
+			for (unsigned long long i = m_overrunCount - kept; i < m_overrunCount; ++i)
+			{
+				overruns.push_back(m_snapshots[i % m_snapshots.size()]);
+			}
+
+			return overruns;
+		}
+
+	private:
+
+		struct OpenZone
+		{
+			const char* name;
+
+			// index in the running frame's zones, or ~size_t(0) when not recorded
+			size_t slot;
+		};
+
+		mutable std::mutex m_mutex;
+
+		unsigned long long m_budget;
+
+		const size_t m_maxZones;
+
+		// one extra slot for the frame being recorded
+		std::vector<FrameRecord> m_history;
+
+		std::vector<FrameRecord> m_snapshots;
+
+		size_t m_current = 0;
+
+		// innermost last
+		std::vector<OpenZone> m_open;
+
+		bool m_inFrame = false;
+
+		unsigned long long m_frameCount = 0;
+
+		unsigned long long m_overrunCount = 0;
+
+		std::function<void(const FrameRecord&)> m_overrunCallback;
+
+		size_t addZone(FrameRecord& frame, const char* name, unsigned long long begin, unsigned depth)
+		{
+			if (frame.zones.size() == m_maxZones)
+			{
+				frame.truncated = true;
+
+				return ~size_t(0);
+			}
+
+			frame.zones.push_back(FrameZoneEvent{ name, begin, begin, depth });
+
+			return frame.zones.size() - 1;
+		}
+	};
+
+	class FrameZone
+	{
+	public:
+
+		FrameZone(FrameProfiler& profiler, const char* name)
+			: m_profiler(profiler)
+		{
+			m_profiler.beginZone(name);
+		}
+
+		~FrameZone()
+		{
+			m_profiler.endZone();
+		}
+
+		FrameZone(const FrameZone&) = delete;
+
+		FrameZone& operator=(const FrameZone&) = delete;
+
+	private:
+
+		FrameProfiler& m_profiler;
+	};
+
+	//
+	//	Zone tree of one frame (zones are stored in begin order, so a depth stack is enough)
+	//
+	inline FrameZoneNode BuildFrameZoneTree(const FrameRecord& frame)
+	{
+		FrameZoneNode root;
+
+		root.name = "frame";
+		root.begin = frame.begin;
+		root.duration = frame.duration;
+
+		std::vector<FrameZoneNode*> stack(1, &root);
+
+		for (const auto& zone : frame.zones)
+		{
+			stack.resize(std::min<size_t>(stack.size(), zone.depth + 1));
+
+			FrameZoneNode& parent = *stack.back();
+
+			parent.children.emplace_back();
+
+			FrameZoneNode& node = parent.children.back();
+
+			node.name = zone.name;
+			node.begin = zone.begin;
+			node.duration = zone.end - zone.begin;
+
+			stack.push_back(&node);
+		}
+
+		return root;
+	}
+
+	//
+	//	Self time per zone name, largest first
+	//
+	inline std::vector<std::pair<std::string, unsigned long long>> MakeFrameBreakdown(const FrameRecord& frame)
+	{
+		std::vector<std::pair<std::string, unsigned long long>> breakdown;
+
+		const std::function<void(const FrameZoneNode&)> visit = [&](const FrameZoneNode& node)
+		{
+			unsigned long long childTime = 0;
+
+			for (const auto& child : node.children)
+			{
+				childTime += child.duration;
+
+				visit(child);
+			}
+
+			const unsigned long long self = node.duration > childTime ? node.duration - childTime : 0;
+
+			auto it = std::find_if(breakdown.begin(), breakdown.end(), [&](const std::pair<std::string, unsigned long long>& entry)
+			{
+				return entry.first == node.name;
+			});
+
+			if (it == breakdown.end())
+			{
+				breakdown.emplace_back(node.name, self);
+			}
+			else
+			{
+				it->second += self;
+			}
+		};
+
+		visit(BuildFrameZoneTree(frame));
+
+		std::sort(breakdown.begin(), breakdown.end(), [](const std::pair<std::string, unsigned long long>& a, const std::pair<std::string, unsigned long long>& b)
+		{
+			return a.second > b.second;
+		});
+
+		return breakdown;
+	}
+
+	inline void WriteFrameZoneNode(std::ostream& os, const FrameZoneNode& node, unsigned long long frameBegin, unsigned indent)
+	{
+		os << std::string(indent * 2, ' ') << node.name << "  +" << (node.begin - frameBegin) << "us  " << node.duration << "us\n";
+
+		for (const auto& child : node.children)
+		{
+			WriteFrameZoneNode(os, child, frameBegin, indent + 1);
+		}
+	}
+
+	inline void WriteFrameSnapshot(std::ostream& os, const FrameRecord& frame)
+	{
+		os << "frame " << frame.index << ": " << frame.duration << "us" << (frame.overBudget ? " (over budget)" : "")
+			<< (frame.truncated ? " (zones truncated)" : "") << '\n';
+
+		const FrameZoneNode root = BuildFrameZoneTree(frame);
+
+		for (const auto& child : root.children)
+		{
+			WriteFrameZoneNode(os, child, frame.begin, 1);
+		}
+	}
+}
@@ -0,0 +1,401 @@
+﻿//------------------------------------------
+//	LatencyHistogram.hpp
+//	Copyright (c) 2014 Reputeless
+//	<reputeless@gmail.com>
+//	Distributed under the MIT license.
+//------------------------------------------
+
+# pragma once
+# include <cstring>
+# include <memory>
+# include <vector>
+# include <string>
+# include <unordered_map>
+# include <mutex>
+# include <ostream>
+# include <algorithm>
+# include "ProfileZone.hpp"
+
+# if defined(_MSC_VER)
+#	include <intrin.h>
+# endif
+
+namespace siv
+{
+	//
+	//	Log-linear (HDR-style) histogram of nanosecond latencies
+	//
+	//	Values below 2^SubBucketBits are exact; above that every power of two is split into
+	//	2^(SubBucketBits-1) linear buckets, i.e. a relative error below 1 / 2^(SubBucketBits-1).
+	//	Values at or above 2^MaxValueBits (~18 minutes) land in the last bucket.
+	//
+	class LatencyHistogram
+	{
+	public:
+
+		static const unsigned SubBucketBits = 7;
+
+		static const unsigned MaxValueBits = 40;
+
+		static const size_t BucketCount = (1u << SubBucketBits) + (MaxValueBits - SubBucketBits) * (1u << (SubBucketBits - 1));
+
+		void record(unsigned long long value)
+		{
+			++m_counts[BucketIndex(value)];
+
+			++m_totalCount;
+
+			if (value > m_max)
+			{
+				m_max = value;
+			}
+
+			if (value < m_min)
+			{
+				m_min = value;
+			}
+		}
+
+		void merge(const LatencyHistogram& another)
+		{
+			for (size_t i = 0; i < BucketCount; ++i)
+			{
+				m_counts[i] += another.m_counts[i];
+			}
+
+			m_totalCount += another.m_totalCount;
+
+			m_max = std::max(m_max, another.m_max);
+
+			m_min = std::min(m_min, another.m_min);
+		}
+
+		void clear()
+		{
+			std::fill(std::begin(m_counts), std::end(m_counts), 0ULL);
+
+			m_totalCount = 0;
+
+			m_max = 0;
+
+			m_min = ~0ULL;
+		}
+
+		//
+		//	Smallest bucket upper bound covering the given fraction (0.0 - 1.0) of samples
+		//
+		unsigned long long percentile(double fraction) const
+		{
+			if (m_totalCount == 0)
+			{
+				return 0;
+			}
+
+			unsigned long long rank = static_cast<unsigned long long>(fraction * m_totalCount + 0.5);
+
+			rank = std::max(1ULL, std::min(rank, m_totalCount));
+
+			unsigned long long cumulative = 0;
+
+			for (size_t i = 0; i < BucketCount; ++i)
+			{
+				cumulative += m_counts[i];
+
+				if (cumulative >= rank)
+				{
+					return std::max(m_min, std::min(BucketUpperBound(i), m_max));
+				}
+			}
+
+			return m_max;
+		}
+
+		unsigned long long count() const
+		{
+			return m_totalCount;
+		}
+
+		unsigned long long max() const
+		{
+			return m_max;
+		}
+
+		unsigned long long min() const
+		{
+			return m_totalCount ? m_min : 0;
+		}
+
+		static size_t BucketIndex(unsigned long long value)
+		{
+			if (value < (1ULL << SubBucketBits))
+			{
+				return static_cast<size_t>(value);
+			}
+
+			if (value >= (1ULL << MaxValueBits))
+			{
+				return BucketCount - 1;
+			}
+
+			const unsigned exponent = HighestBit(value);
+
+			const unsigned shift = exponent - (SubBucketBits - 1);
+
+			const size_t mantissa = static_cast<size_t>(value >> shift) - (1u << (SubBucketBits - 1));
+
+			return (1u << SubBucketBits) + (exponent - SubBucketBits) * (1u << (SubBucketBits - 1)) + mantissa;
+		}
+
+		static unsigned long long BucketUpperBound(size_t index)
+		{
+			if (index < (1u << SubBucketBits))
+			{
+				return index;
+			}
+
+			const size_t offset = index - (1u << SubBucketBits);
+
+			const unsigned exponent = static_cast<unsigned>(offset >> (SubBucketBits - 1)) + SubBucketBits;
+
+			const unsigned long long mantissa = (offset & ((1u << (SubBucketBits - 1)) - 1)) + (1u << (SubBucketBits - 1));
+
+			const unsigned shift = exponent - (SubBucketBits - 1);
+
+			return ((mantissa + 1) << shift) - 1;
+		}
+
+	private:
+
+		unsigned long long m_counts[BucketCount] = {};
+
+		unsigned long long m_totalCount = 0;
+
+		unsigned long long m_max = 0;
+
+		unsigned long long m_min = ~0ULL;
+
+		static unsigned HighestBit(unsigned long long value)
+		{
+#if defined(_MSC_VER) && defined(_M_X64)
+
+			unsigned long index;
+
+			::_BitScanReverse64(&index, value);
+
+			return index;
+
+#elif defined(_MSC_VER)
+
+			unsigned long index;
+
+			if (::_BitScanReverse(&index, static_cast<unsigned long>(value >> 32)))
+			{
+				return index + 32;
+			}
+
+			::_BitScanReverse(&index, static_cast<unsigned long>(value));
+
+			return index;
+
+#else
+
+			return 63 - __builtin_clzll(value);
+
+#endif
+		}
+	};
+
+	//
+	//	Records the lifetime of the scope, in nanoseconds, into a histogram
+	//
+	class ScopedLatency
+	{
+	public:
+
+		explicit ScopedLatency(LatencyHistogram& histogram)
+			: m_histogram(histogram)
+			, m_start(GetNanosec()) {}
+
+		~ScopedLatency()
+		{
+			m_histogram.record(detail::SubtractOverhead<NanosecClock>(GetNanosec() - m_start));
+		}
+
+		ScopedLatency(const ScopedLatency&) = delete;
+
+		ScopedLatency& operator=(const ScopedLatency&) = delete;
+
+	private:
+
+		LatencyHistogram& m_histogram;
+
+		unsigned long long m_start;
+	};
+
+	struct LatencyReport
+	{
+		std::string name;
+
+		unsigned long long count = 0;
+
+		unsigned long long p50 = 0;
+
+		unsigned long long p90 = 0;
+
+		unsigned long long p99 = 0;
+
+		unsigned long long p999 = 0;
+
+		unsigned long long max = 0;
+	};
+
+	inline LatencyReport MakeLatencyReport(const std::string& name, const LatencyHistogram& histogram)
+	{
+		LatencyReport report;
+
+		report.name = name;
+		report.count = histogram.count();
+		report.p50 = histogram.percentile(0.5);
+		report.p90 = histogram.percentile(0.9);
+		report.p99 = histogram.percentile(0.99);
+		report.p999 = histogram.percentile(0.999);
+		report.max = histogram.max();
+
+		return report;
+	}
+
+	//
+	//	Aggregating mode: every drained zone goes into a per-thread, per-name histogram
+	//
+	class ZoneHistogramSink : public ZoneSink
+	{
+	public:
+
+		void onZoneRecords(unsigned threadIndex, const ZoneRecord* records, size_t count) override
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			ThreadHistograms& thread = getThread(threadIndex);
+
+			for (size_t i = 0; i < count; ++i)
+			{
+				const ZoneRecord& r = records[i];
+
+				std::unique_ptr<LatencyHistogram>& histogram = thread.histograms[r.name];
+
+				if (!histogram)
+				{
+					histogram.reset(new LatencyHistogram);
+				}
+
+				histogram->record(TSCToNanosec(detail::SubtractOverhead<RDTSCClock>(r.end - r.begin)));
+			}
+		}
+
+		//
+		//	Per-name histograms merged across threads
+		//
+		std::vector<std::pair<std::string, LatencyHistogram>> getHistograms() const
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			std::vector<std::pair<std::string, LatencyHistogram>> merged;
+
+			for (const auto& thread : m_threads)
+			{
+				for (const auto& entry : thread.histograms)
+				{
+					auto it = std::find_if(merged.begin(), merged.end(), [&](const std::pair<std::string, LatencyHistogram>& m)
+					{
+						return m.first == entry.first;
+					});
+
+					if (it == merged.end())
+					{
+						merged.emplace_back(entry.first, LatencyHistogram());
+
+						it = merged.end() - 1;
+					}
+
+					it->second.merge(*entry.second);
+				}
+			}
+
+			return merged;
+		}
+
+		std::vector<LatencyReport> getReports() const
+		{
+			std::vector<LatencyReport> reports;
+
+			for (const auto& entry : getHistograms())
+			{
+				reports.push_back(MakeLatencyReport(entry.first, entry.second));
+			}
+
+			std::sort(reports.begin(), reports.end(), [](const LatencyReport& a, const LatencyReport& b)
+			{
+				return a.p99 > b.p99;
+			});
+
+			return reports;
+		}
+
+		void clear()
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			m_threads.clear();
+		}
+
+	private:
+
+		struct ThreadHistograms
+		{
+			unsigned threadIndex;
+
+			// keyed by the zone's string literal; equal names from different literals are merged on report
+			std::unordered_map<const char*, std::unique_ptr<LatencyHistogram>> histograms;
+		};
+
+		mutable std::mutex m_mutex;
+
+		std::vector<ThreadHistograms> m_threads;
+
+		ThreadHistograms& getThread(unsigned threadIndex)
+		{
+			for (auto& thread : m_threads)
+			{
+				if (thread.threadIndex == threadIndex)
+				{
+					return thread;
+				}
+			}
+
+			m_threads.emplace_back();
+
+			m_threads.back().threadIndex = threadIndex;
+
+			return m_threads.back();
+		}
+	};
+
+	//
+	//	Percentile table in microseconds, worst p99 first
+	//
+	inline void WriteLatencyReports(std::ostream& os, const std::vector<LatencyReport>& reports)
+	{
+		const auto us = [](unsigned long long ns)
+		{
+			return std::to_string(ns / 1000ULL) + "." + std::to_string(ns % 1000ULL / 100ULL);
+		};
+
+		os << "zone\tcount\tp50(us)\tp90(us)\tp99(us)\tp99.9(us)\tmax(us)\n";
+
+		for (const auto& r : reports)
+		{
+			os << r.name << '\t' << r.count << '\t' << us(r.p50) << '\t' << us(r.p90) << '\t'
+				<< us(r.p99) << '\t' << us(r.p999) << '\t' << us(r.max) << '\n';
+		}
+	}
+}
@@ -0,0 +1,685 @@
+﻿//------------------------------------------
+//	LockProfiler.hpp
+//	Copyright (c) 2014 Reputeless
+//	<reputeless@gmail.com>
+//	Distributed under the MIT license.
+//------------------------------------------
+
+# pragma once
+# include <cstdio>
+# include <string>
+# include <vector>
+# include <deque>
+# include <atomic>
+# include <mutex>
+# include <chrono>
+# include <condition_variable>
+# include <algorithm>
+# include <ostream>
+# include "ProfileZone.hpp"
+
+# if (__cplusplus >= 201703L) || (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L)
+#	include <shared_mutex>
+#	define SIV_HAS_SHARED_MUTEX 1
+# else
+#	define SIV_HAS_SHARED_MUTEX 0
+# endif
+
+// shared locks a thread may hold at once with hold time measured
+# ifndef SIV_MAX_SHARED_LOCKS_PER_THREAD
+#	define SIV_MAX_SHARED_LOCKS_PER_THREAD 16
+# endif
+
+namespace siv
+{
+	struct LockReport
+	{
+		std::string name;
+
+		unsigned long long acquisitions = 0;
+
+		// acquisitions that found the lock taken and had to wait
+		unsigned long long contentions = 0;
+
+		unsigned long long waitNanosec = 0;
+
+		unsigned long long maxWaitNanosec = 0;
+
+		unsigned long long holdNanosec = 0;
+
+		unsigned long long maxHoldNanosec = 0;
+
+		double contentionRate() const
+		{
+			return acquisitions ? static_cast<double>(contentions) / acquisitions : 0.0;
+		}
+
+		void merge(const LockReport& another)
+		{
+			acquisitions += another.acquisitions;
+			contentions += another.contentions;
+			waitNanosec += another.waitNanosec;
+			maxWaitNanosec = std::max(maxWaitNanosec, another.maxWaitNanosec);
+			holdNanosec += another.holdNanosec;
+			maxHoldNanosec = std::max(maxHoldNanosec, another.maxHoldNanosec);
+		}
+	};
+
+	namespace detail
+	{
+		inline void UpdateMax(std::atomic<unsigned long long>& max, unsigned long long value)
+		{
+			unsigned long long current = max.load(std::memory_order_relaxed);
+
+			while (value > current && !max.compare_exchange_weak(current, value, std::memory_order_relaxed)) {}
+		}
+
+		//
+		//	Counters of one lock instance. They share the lock's cache line traffic, which is
+		//	already there whenever the lock is contended.
+		//
+		class LockStats
+		{
+		public:
+
+			explicit LockStats(const char* name);
+
+			~LockStats();
+
+			LockStats(const LockStats&) = delete;
+
+			LockStats& operator=(const LockStats&) = delete;
+
+			//
+			//	Zone names: "<name>.wait" for contended acquisitions, "<name>.hold" for critical sections.
+			//	Interned for the process lifetime, since records may be drained after the lock is gone.
+			//
+			const char* waitName() const
+			{
+				return m_waitName;
+			}
+
+			const char* holdName() const
+			{
+				return m_holdName;
+			}
+
+			void acquired(unsigned long long waitBegin, unsigned long long waitEnd, bool contended)
+			{
+				m_acquisitions.fetch_add(1, std::memory_order_relaxed);
+
+				if (!contended)
+				{
+					return;
+				}
+
+				const unsigned long long wait = SubtractOverhead<RDTSCClock>(waitEnd - waitBegin);
+
+				m_contentions.fetch_add(1, std::memory_order_relaxed);
+
+				m_waitTicks.fetch_add(wait, std::memory_order_relaxed);
+
+				UpdateMax(m_maxWaitTicks, wait);
+
+				ZoneBuffer& buffer = GetThreadZoneBuffer();
+
+				buffer.push(ZoneRecord{ m_waitName, waitBegin, waitEnd, buffer.depth() });
+			}
+
+			void released(unsigned long long holdBegin, unsigned long long holdEnd)
+			{
+				const unsigned long long hold = SubtractOverhead<RDTSCClock>(holdEnd - holdBegin);
+
+				m_holdTicks.fetch_add(hold, std::memory_order_relaxed);
+
+				UpdateMax(m_maxHoldTicks, hold);
+
+				ZoneBuffer& buffer = GetThreadZoneBuffer();
+
+				buffer.push(ZoneRecord{ m_holdName, holdBegin, holdEnd, buffer.depth() });
+			}
+
+			LockReport report() const
+			{
+				LockReport report;
+
+				report.name = m_name;
+				report.acquisitions = m_acquisitions.load(std::memory_order_relaxed);
+				report.contentions = m_contentions.load(std::memory_order_relaxed);
+				report.waitNanosec = TSCToNanosec(m_waitTicks.load(std::memory_order_relaxed));
+				report.maxWaitNanosec = TSCToNanosec(m_maxWaitTicks.load(std::memory_order_relaxed));
+				report.holdNanosec = TSCToNanosec(m_holdTicks.load(std::memory_order_relaxed));
+				report.maxHoldNanosec = TSCToNanosec(m_maxHoldTicks.load(std::memory_order_relaxed));
+
+				return report;
+			}
+
+		private:
+
+			const char* m_name;
+
+			const char* m_waitName;
+
+			const char* m_holdName;
+
+			std::atomic<unsigned long long> m_acquisitions{ 0 };
+
+			std::atomic<unsigned long long> m_contentions{ 0 };
+
+			std::atomic<unsigned long long> m_waitTicks{ 0 };
+
+			std::atomic<unsigned long long> m_maxWaitTicks{ 0 };
+
+			std::atomic<unsigned long long> m_holdTicks{ 0 };
+
+			std::atomic<unsigned long long> m_maxHoldTicks{ 0 };
+		};
+
+		//
+		//	Live locks, plus the totals of destroyed ones by name
+		//
+		class LockRegistry
+		{
+		public:
+
+			const char* intern(const std::string& name)
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+
+				for (const auto& s : m_names)
+				{
+					if (s == name)
+					{
+						return s.c_str();
+					}
+				}
+
+				m_names.push_back(name);
+
+				return m_names.back().c_str();
+			}
+
+			void add(const LockStats* stats)
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+
+				m_live.push_back(stats);
+			}
+
+			void remove(const LockStats* stats)
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+
+				m_live.erase(std::remove(m_live.begin(), m_live.end(), stats), m_live.end());
+
+				Merge(m_retired, stats->report());
+			}
+
+			std::vector<LockReport> reports()
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+
+				std::vector<LockReport> reports = m_retired;
+
+				for (const auto& stats : m_live)
+				{
+					Merge(reports, stats->report());
+				}
+
+				return reports;
+			}
+
+			void clear()
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+
+				m_retired.clear();
+			}
+
+		private:
+
+			std::mutex m_mutex;
+
+			std::deque<std::string> m_names;
+
+			std::vector<const LockStats*> m_live;
+
+			std::vector<LockReport> m_retired;
+
+			static void Merge(std::vector<LockReport>& reports, const LockReport& report)
+			{
+				for (auto& r : reports)
+				{
+					if (r.name == report.name)
+					{
+						r.merge(report);
+
+						return;
+					}
+				}
+
+				reports.push_back(report);
+			}
+		};
+
+		inline LockRegistry& GetLockRegistry()
+		{
+			// never destroyed: locks with static storage may outlive it otherwise
+			static LockRegistry* registry = new LockRegistry;
+
+			return *registry;
+		}
+
+		inline LockStats::LockStats(const char* name)
+			: m_name(GetLockRegistry().intern(name))
+			, m_waitName(GetLockRegistry().intern(std::string(name) + ".wait"))
+			, m_holdName(GetLockRegistry().intern(std::string(name) + ".hold"))
+		{
+			GetLockRegistry().add(this);
+		}
+
+		inline LockStats::~LockStats()
+		{
+			GetLockRegistry().remove(this);
+		}
+
+		//
+		//	Start of each shared hold of the calling thread (several threads hold a shared lock at once)
+		//
+		struct SharedHold
+		{
+			const void* lock;
+
+			unsigned long long begin;
+		};
+
+		inline SharedHold* ThreadSharedHolds()
+		{
+			static thread_local SharedHold holds[SIV_MAX_SHARED_LOCKS_PER_THREAD];
+
+			return holds;
+		}
+
+		inline void BeginSharedHold(const void* lock, unsigned long long begin)
+		{
+			SharedHold* holds = ThreadSharedHolds();
+
+			for (size_t i = 0; i < SIV_MAX_SHARED_LOCKS_PER_THREAD; ++i)
+			{
+				if (!holds[i].lock)
+				{
+					holds[i] = SharedHold{ lock, begin };
+
+					return;
+				}
+			}
+		}
+
+		//
+		//	Returns false when the hold was not tracked
+		//
+		inline bool EndSharedHold(const void* lock, unsigned long long& begin)
+		{
+			SharedHold* holds = ThreadSharedHolds();
+
+			for (size_t i = 0; i < SIV_MAX_SHARED_LOCKS_PER_THREAD; ++i)
+			{
+				if (holds[i].lock == lock)
+				{
+					begin = holds[i].begin;
+
+					holds[i].lock = nullptr;
+
+					return true;
+				}
+			}
+
+			return false;
+		}
+	}
+
+	//
+	//	Drop-in std::mutex. Contended waits and every critical section are pushed to the
+	//	thread's zone buffer as "<name>.wait" / "<name>.hold", so ZoneHistogramSink and the
+	//	trace writers see them; per-lock totals are available from GetLockReports().
+	//
+	class ProfiledMutex
+	{
+	public:
+
+		explicit ProfiledMutex(const char* name = "mutex")
+			: m_stats(name) {}
+
+		ProfiledMutex(const ProfiledMutex&) = delete;
+
+		ProfiledMutex& operator=(const ProfiledMutex&) = delete;
+
+		void lock()
+		{
+			if (m_mutex.try_lock())
+			{
+				m_stats.acquired(0, 0, false);
+			}
+			else
+			{
+				const unsigned long long begin = detail::ReadTSC();
+
+				m_mutex.lock();
+
+				m_stats.acquired(begin, detail::ReadTSC(), true);
+			}
+
+			m_holdBegin = detail::ReadTSC();
+		}
+
+		bool try_lock()
+		{
+			if (!m_mutex.try_lock())
+			{
+				return false;
+			}
+
+			m_stats.acquired(0, 0, false);
+
+			m_holdBegin = detail::ReadTSC();
+
+			return true;
+		}
+
+		void unlock()
+		{
+			const unsigned long long begin = m_holdBegin;
+
+			const unsigned long long end = detail::ReadTSC();
+
+			m_mutex.unlock();
+
+			m_stats.released(begin, end);
+		}
+
+		LockReport report() const
+		{
+			return m_stats.report();
+		}
+
+	private:
+
+		friend class ProfiledConditionVariable;
+
+		std::mutex m_mutex;
+
+		// written only by the owner
+		unsigned long long m_holdBegin = 0;
+
+		detail::LockStats m_stats;
+	};
+
+# if SIV_HAS_SHARED_MUTEX
+
+	//
+	//	Drop-in std::shared_mutex; shared and exclusive acquisitions are counted together
+	//
+	class ProfiledSharedMutex
+	{
+	public:
+
+		explicit ProfiledSharedMutex(const char* name = "shared_mutex")
+			: m_stats(name) {}
+
+		ProfiledSharedMutex(const ProfiledSharedMutex&) = delete;
+
+		ProfiledSharedMutex& operator=(const ProfiledSharedMutex&) = delete;
+
+		void lock()
+		{
+			if (m_mutex.try_lock())
+			{
+				m_stats.acquired(0, 0, false);
+			}
+			else
+			{
+				const unsigned long long begin = detail::ReadTSC();
+
+				m_mutex.lock();
+
+				m_stats.acquired(begin, detail::ReadTSC(), true);
+			}
+
+			m_holdBegin = detail::ReadTSC();
+		}
+
+		bool try_lock()
+		{
+			if (!m_mutex.try_lock())
+			{
+				return false;
+			}
+
+			m_stats.acquired(0, 0, false);
+
+			m_holdBegin = detail::ReadTSC();
+
+			return true;
+		}
+
+		void unlock()
+		{
+			const unsigned long long begin = m_holdBegin;
+
+			const unsigned long long end = detail::ReadTSC();
+
+			m_mutex.unlock();
+
+			m_stats.released(begin, end);
+		}
+
+		void lock_shared()
+		{
+			if (m_mutex.try_lock_shared())
+			{
+				m_stats.acquired(0, 0, false);
+			}
+			else
+			{
+				const unsigned long long begin = detail::ReadTSC();
+
+				m_mutex.lock_shared();
+
+				m_stats.acquired(begin, detail::ReadTSC(), true);
+			}
+
+			detail::BeginSharedHold(this, detail::ReadTSC());
+		}
+
+		bool try_lock_shared()
+		{
+			if (!m_mutex.try_lock_shared())
+			{
+				return false;
+			}
+
+			m_stats.acquired(0, 0, false);
+
+			detail::BeginSharedHold(this, detail::ReadTSC());
+
+			return true;
+		}
+
+		void unlock_shared()
+		{
+			const unsigned long long end = detail::ReadTSC();
+
+			m_mutex.unlock_shared();
+
+			unsigned long long begin;
+
+			if (detail::EndSharedHold(this, begin))
+			{
+				m_stats.released(begin, end);
+			}
+		}
+
+		LockReport report() const
+		{
+			return m_stats.report();
+		}
+
+	private:
+
+		std::shared_mutex m_mutex;
+
+		unsigned long long m_holdBegin = 0;
+
+		detail::LockStats m_stats;
+	};
+
+# endif
+
+	//
+	//	Drop-in std::condition_variable for std::unique_lock<ProfiledMutex>.
+	//	The hold of the mutex ends while waiting; the time blocked is recorded as "<name>.wait".
+	//
+	class ProfiledConditionVariable
+	{
+	public:
+
+		explicit ProfiledConditionVariable(const char* name = "condition_variable")
+			: m_waitName(detail::GetLockRegistry().intern(std::string(name) + ".wait")) {}
+
+		ProfiledConditionVariable(const ProfiledConditionVariable&) = delete;
+
+		ProfiledConditionVariable& operator=(const ProfiledConditionVariable&) = delete;
+
+		void notify_one() noexcept
+		{
+			m_condition.notify_one();
+		}
+
+		void notify_all() noexcept
+		{
+			m_condition.notify_all();
+		}
+
+		void wait(std::unique_lock<ProfiledMutex>& lock)
+		{
+			waitNative(lock, [this](std::unique_lock<std::mutex>& native)
+			{
+				m_condition.wait(native);
+
+				return true;
+			});
+		}
+
+		template <class Predicate>
+		void wait(std::unique_lock<ProfiledMutex>& lock, Predicate predicate)
+		{
+			while (!predicate())
+			{
+				wait(lock);
+			}
+		}
+
+		template <class Clock, class Duration>
+		std::cv_status wait_until(std::unique_lock<ProfiledMutex>& lock, const std::chrono::time_point<Clock, Duration>& time)
+		{
+			std::cv_status status = std::cv_status::no_timeout;
+
+			waitNative(lock, [&](std::unique_lock<std::mutex>& native)
+			{
+				status = m_condition.wait_until(native, time);
+
+				return true;
+			});
+
+			return status;
+		}
+
+		template <class Clock, class Duration, class Predicate>
+		bool wait_until(std::unique_lock<ProfiledMutex>& lock, const std::chrono::time_point<Clock, Duration>& time, Predicate predicate)
+		{
+			while (!predicate())
+			{
+				if (wait_until(lock, time) == std::cv_status::timeout)
+				{
+					return predicate();
+				}
+			}
+
+			return true;
+		}
+
+		template <class Rep, class Period>
+		std::cv_status wait_for(std::unique_lock<ProfiledMutex>& lock, const std::chrono::duration<Rep, Period>& duration)
+		{
+			return wait_until(lock, std::chrono::steady_clock::now() + duration);
+		}
+
+		template <class Rep, class Period, class Predicate>
+		bool wait_for(std::unique_lock<ProfiledMutex>& lock, const std::chrono::duration<Rep, Period>& duration, Predicate predicate)
+		{
+			return wait_until(lock, std::chrono::steady_clock::now() + duration, std::move(predicate));
+		}
+
+	private:
+
+		std::condition_variable m_condition;
+
+		const char* m_waitName;
+
+		template <class Wait>
+		void waitNative(std::unique_lock<ProfiledMutex>& lock, Wait wait)
+		{
+			ProfiledMutex& mutex = *lock.mutex();
+
+			const unsigned long long begin = detail::ReadTSC();
+
+			mutex.m_stats.released(mutex.m_holdBegin, begin);
+
+			std::unique_lock<std::mutex> native(mutex.m_mutex, std::adopt_lock);
+
+			wait(native);
+
+			native.release();
+
+			const unsigned long long end = detail::ReadTSC();
+
+			ZoneBuffer& buffer = GetThreadZoneBuffer();
+
+			buffer.push(ZoneRecord{ m_waitName, begin, end, buffer.depth() });
+
+			mutex.m_holdBegin = end;
+		}
+	};
+
+	//
+	//	Every profiled lock, merged by name, longest total wait first
+	//
+	inline std::vector<LockReport> GetLockReports()
+	{
+		std::vector<LockReport> reports = detail::GetLockRegistry().reports();
+
+		std::sort(reports.begin(), reports.end(), [](const LockReport& a, const LockReport& b)
+		{
+			return a.waitNanosec > b.waitNanosec;
+		});
+
+		return reports;
+	}
+
+	inline void WriteLockReports(std::ostream& os, const std::vector<LockReport>& reports)
+	{
+		os << "lock\tacquisitions\tcontended\twait(us)\tmax wait(us)\thold(us)\tmax hold(us)\n";
+
+		for (const auto& r : reports)
+		{
+			char line[256];
+
+			std::snprintf(line, sizeof(line), "\t%llu\t%.1f%%\t%.1f\t%.1f\t%.1f\t%.1f\n",
+				r.acquisitions, 100.0 * r.contentionRate(),
+				r.waitNanosec / 1000.0, r.maxWaitNanosec / 1000.0,
+				r.holdNanosec / 1000.0, r.maxHoldNanosec / 1000.0);
+
+			os << r.name << line;
+		}
+	}
+}
@@ -0,0 +1,456 @@
+﻿//------------------------------------------
+//	Metrics.hpp
+//	Copyright (c) 2014 Reputeless
+//	<reputeless@gmail.com>
+//	Distributed under the MIT license.
+//------------------------------------------
+
+# pragma once
+# include <cstdio>
+# include <cstdlib>
+# include <cstdint>
+# include <new>
+# include <string>
+# include <vector>
+# include <memory>
+# include <atomic>
+# include <mutex>
+# include <thread>
+# include <condition_variable>
+# include <functional>
+# include <algorithm>
+# include <ostream>
+# include "Profiler.hpp"
+
+// slots per metric; threads are spread over them round-robin. Must be a power of two.
+# ifndef SIV_METRIC_SHARDS
+#	define SIV_METRIC_SHARDS 64
+# endif
+
+//
+//	Looks the metric up once per call site: SIV_METRIC_COUNTER("requests").increment();
+//
+# define SIV_METRIC_COUNTER(name) ([]() -> siv::Counter& { static siv::Counter& metric = siv::GetMetricsRegistry().counter(name); return metric; }())
+# define SIV_METRIC_GAUGE(name) ([]() -> siv::Gauge& { static siv::Gauge& metric = siv::GetMetricsRegistry().gauge(name); return metric; }())
+# define SIV_METRIC_RATE(name) ([]() -> siv::RateMeter& { static siv::RateMeter& metric = siv::GetMetricsRegistry().rate(name); return metric; }())
+
+namespace siv
+{
+	namespace detail
+	{
+		struct alignas(64) MetricShard
+		{
+			std::atomic<long long> value{ 0 };
+		};
+
+		inline size_t ThreadMetricShard()
+		{
+			static std::atomic<size_t> next{ 0 };
+
+			static thread_local const size_t shard = next.fetch_add(1, std::memory_order_relaxed) & (SIV_METRIC_SHARDS - 1);
+
+			return shard;
+		}
+
+		//
+		//	Sum spread over cache-line-padded slots: writers touch only their own slot,
+		//	readers add them up. Unshared while there are at most SIV_METRIC_SHARDS threads.
+		//
+		class ShardedSum
+		{
+		public:
+
+			void add(long long n)
+			{
+				m_shards[ThreadMetricShard()].value.fetch_add(n, std::memory_order_relaxed);
+			}
+
+			long long sum() const
+			{
+				long long total = 0;
+
+				for (const auto& shard : m_shards)
+				{
+					total += shard.value.load(std::memory_order_relaxed);
+				}
+
+				return total;
+			}
+
+		private:
+
+			MetricShard m_shards[SIV_METRIC_SHARDS];
+		};
+
+		//
+		//	operator new is not required to honor alignas(64) before C++17
+		//
+		template <class Metric>
+		struct AlignedMetricDeleter
+		{
+			void operator()(Metric* metric) const
+			{
+				void* original = reinterpret_cast<void**>(metric)[-1];
+
+				metric->~Metric();
+
+				std::free(original);
+			}
+		};
+
+		template <class Metric>
+		using AlignedMetricPtr = std::unique_ptr<Metric, AlignedMetricDeleter<Metric>>;
+
+		template <class Metric>
+		inline AlignedMetricPtr<Metric> MakeAlignedMetric()
+		{
+			void* original = std::malloc(sizeof(Metric) + alignof(Metric) + sizeof(void*));
+
+			if (!original)
+			{
+				throw std::bad_alloc();
+			}
+
+			const std::uintptr_t address = (reinterpret_cast<std::uintptr_t>(original) + sizeof(void*) + alignof(Metric) - 1) & ~(std::uintptr_t(alignof(Metric)) - 1);
+
+			reinterpret_cast<void**>(address)[-1] = original;
+
+			return AlignedMetricPtr<Metric>(new (reinterpret_cast<void*>(address)) Metric);
+		}
+	}
+
+	//
+	//	Monotonic count of events
+	//
+	class Counter
+	{
+	public:
+
+		void increment()
+		{
+			m_sum.add(1);
+		}
+
+		void add(long long n)
+		{
+			m_sum.add(n);
+		}
+
+		long long value() const
+		{
+			return m_sum.sum();
+		}
+
+	private:
+
+		detail::ShardedSum m_sum;
+	};
+
+	//
+	//	Level that goes up and down (queue length, bytes in use, ...)
+	//
+	class Gauge
+	{
+	public:
+
+		void add(long long n)
+		{
+			m_sum.add(n);
+		}
+
+		void sub(long long n)
+		{
+			m_sum.add(-n);
+		}
+
+		//
+		//	Not atomic with concurrent add/sub: those racing with set may be lost
+		//
+		void set(long long value)
+		{
+			m_base.store(value - m_sum.sum(), std::memory_order_relaxed);
+		}
+
+		long long value() const
+		{
+			return m_base.load(std::memory_order_relaxed) + m_sum.sum();
+		}
+
+	private:
+
+		alignas(64) std::atomic<long long> m_base{ 0 };
+
+		detail::ShardedSum m_sum;
+	};
+
+	//
+	//	Event count whose rate is computed between reads
+	//
+	class RateMeter
+	{
+	public:
+
+		void mark(long long n = 1)
+		{
+			m_sum.add(n);
+		}
+
+		long long count() const
+		{
+			return m_sum.sum();
+		}
+
+		//
+		//	Events per second since the previous call (since creation for the first one)
+		//
+		double rate()
+		{
+			const long long count = m_sum.sum();
+
+			const unsigned long long now = GetNanosec();
+
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			const unsigned long long elapsed = now - m_lastNanosec;
+
+			const double rate = elapsed ? (count - m_lastCount) * 1.0e9 / elapsed : 0.0;
+
+			m_lastCount = count;
+
+			m_lastNanosec = now;
+
+			return rate;
+		}
+
+	private:
+
+		detail::ShardedSum m_sum;
+
+		std::mutex m_mutex;
+
+		long long m_lastCount = 0;
+
+		unsigned long long m_lastNanosec = GetNanosec();
+	};
+
+	enum class MetricType
+	{
+		Counter,
+
+		Gauge,
+
+		Rate,
+	};
+
+	struct MetricValue
+	{
+		std::string name;
+
+		MetricType type;
+
+		long long value;
+
+		// events per second since the previous snapshot; Rate only
+		double rate;
+	};
+
+	struct MetricsSnapshot
+	{
+		unsigned long long nanosec = 0;
+
+		std::vector<MetricValue> metrics;
+	};
+
+	class MetricsRegistry
+	{
+	public:
+
+		//
+		//	Returns the metric of this name, creating it on first use.
+		//	The reference stays valid for the registry's lifetime; cache it on hot paths.
+		//
+		Counter& counter(const std::string& name)
+		{
+			return find(m_counters, name);
+		}
+
+		Gauge& gauge(const std::string& name)
+		{
+			return find(m_gauges, name);
+		}
+
+		RateMeter& rate(const std::string& name)
+		{
+			return find(m_rates, name);
+		}
+
+		//
+		//	Sums every metric's slots; rates are measured against the previous snapshot
+		//
+		MetricsSnapshot snapshot()
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			MetricsSnapshot snapshot;
+
+			snapshot.nanosec = GetNanosec();
+
+			snapshot.metrics.reserve(m_counters.size() + m_gauges.size() + m_rates.size());
+
+			for (const auto& c : m_counters)
+			{
+				snapshot.metrics.push_back(MetricValue{ c.first, MetricType::Counter, c.second->value(), 0.0 });
+			}
+
+			for (const auto& g : m_gauges)
+			{
+				snapshot.metrics.push_back(MetricValue{ g.first, MetricType::Gauge, g.second->value(), 0.0 });
+			}
+
+			for (const auto& r : m_rates)
+			{
+				snapshot.metrics.push_back(MetricValue{ r.first, MetricType::Rate, r.second->count(), r.second->rate() });
+			}
+
+			return snapshot;
+		}
+
+	private:
+
+		template <class Metric>
+		using Metrics = std::vector<std::pair<std::string, detail::AlignedMetricPtr<Metric>>>;
+
+		std::mutex m_mutex;
+
+		Metrics<Counter> m_counters;
+
+		Metrics<Gauge> m_gauges;
+
+		Metrics<RateMeter> m_rates;
+
+		template <class Metric>
+		Metric& find(Metrics<Metric>& metrics, const std::string& name)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			for (const auto& metric : metrics)
+			{
+				if (metric.first == name)
+				{
+					return *metric.second;
+				}
+			}
+
+			metrics.emplace_back(name, detail::MakeAlignedMetric<Metric>());
+
+			return *metrics.back().second;
+		}
+	};
+
+	inline MetricsRegistry& GetMetricsRegistry()
+	{
+		static MetricsRegistry registry;
+
+		return registry;
+	}
+
+	//
+	//	One JSON object per line, suitable for appending to a file or sending over a socket
+	//
+	inline void WriteMetricsJSON(std::ostream& os, const MetricsSnapshot& snapshot)
+	{
+		static const char* const types[] = { "counter", "gauge", "rate" };
+
+		os << "{\"nanosec\":" << snapshot.nanosec << ",\"metrics\":[";
+
+		for (size_t i = 0; i < snapshot.metrics.size(); ++i)
+		{
+			const MetricValue& m = snapshot.metrics[i];
+
+			os << (i ? "," : "") << "{\"name\":\"";
+
+			for (char ch : m.name)
+			{
+				if (ch == '"' || ch == '\\')
+				{
+					os << '\\';
+				}
+
+				os << ch;
+			}
+
+			os << "\",\"type\":\"" << types[static_cast<int>(m.type)] << "\",\"value\":" << m.value;
+
+			if (m.type == MetricType::Rate)
+			{
+				char buffer[32];
+
+				std::snprintf(buffer, sizeof(buffer), "%.3f", m.rate);
+
+				os << ",\"rate\":" << buffer;
+			}
+
+			os << '}';
+		}
+
+		os << "]}\n";
+	}
+
+	//
+	//	Snapshots the registry on its own thread at a fixed interval
+	//
+	class MetricsReporter
+	{
+	public:
+
+		MetricsReporter(std::function<void(const MetricsSnapshot&)> callback, std::chrono::milliseconds interval = std::chrono::milliseconds(1000), MetricsRegistry& registry = GetMetricsRegistry())
+			: m_callback(std::move(callback))
+			, m_registry(registry)
+		{
+			m_thread = std::thread([this, interval]()
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+
+				while (!m_condition.wait_for(lock, interval, [this] { return m_stopping; }))
+				{
+					lock.unlock();
+
+					m_callback(m_registry.snapshot());
+
+					lock.lock();
+				}
+			});
+		}
+
+		~MetricsReporter()
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+
+				m_stopping = true;
+			}
+
+			m_condition.notify_all();
+
+			m_thread.join();
+		}
+
+		MetricsReporter(const MetricsReporter&) = delete;
+
+		MetricsReporter& operator=(const MetricsReporter&) = delete;
+
+	private:
+
+		std::function<void(const MetricsSnapshot&)> m_callback;
+
+		MetricsRegistry& m_registry;
+
+		std::mutex m_mutex;
+
+		std::condition_variable m_condition;
+
+		bool m_stopping = false;
+
+		std::thread m_thread;
+	};
+}
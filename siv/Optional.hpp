@@ -46,6 +46,12 @@
 
 namespace siv
 {
+	//
+	//	In-place construction
+	//
+	struct in_place_t {};
+	const SIV_CONSTEXPR in_place_t in_place{};
+
 	namespace detail
 	{
 		template<unsigned int Align>
@@ -99,13 +105,251 @@ namespace siv
 				return static_cast<void*>(&m_storage);
 			}
 		};
-	}
 
-	//
-	//	In-place construction
-	//
-	struct in_place_t {};
-	const SIV_CONSTEXPR in_place_t in_place{};
+		//
+		//	std::is_trivially_copyable, which libstdc++ only has from GCC 5 (the release that added _GLIBCXX_USE_CXX11_ABI)
+		//
+		template <class T>
+		struct is_trivially_copyable : std::integral_constant<bool,
+#if defined(__GLIBCXX__) && !defined(_GLIBCXX_USE_CXX11_ABI)
+			__has_trivial_copy(T) && __has_trivial_assign(T) && __has_trivial_destructor(T)
+#else
+			std::is_trivially_copyable<T>::value
+#endif
+			> {};
+
+		//
+		//	Value and state of optional; the layers below add only the special members T needs,
+		//	so that optional<T> is trivially destructible / copyable whenever T is
+		//
+		// a union member of a non-trivial type needs unrestricted unions
+		template <class T>
+		struct use_union_storage : std::integral_constant<bool,
+#ifdef SIV_CPP11_IMPLEMENTED
+			std::is_trivially_destructible<T>::value
+#else
+			false
+#endif
+			> {};
+
+		template <class T, bool = use_union_storage<T>::value>
+		class optional_storage_base
+		{
+		protected:
+
+			aligned_storage<T> m_value;
+
+			bool m_initialized = false;
+
+			optional_storage_base() = default;
+
+			template <class... Args>
+			explicit optional_storage_base(in_place_t, Args&&... args)
+			{
+				construct(std::forward<Args>(args)...);
+			}
+
+			template <class... Args>
+			void construct(Args&&... args)
+			{
+				destroy();
+
+				::new (m_value.address()) T(std::forward<Args>(args)...);
+
+				m_initialized = true;
+			}
+
+			void destroy() SIV_NOEXCEPT
+			{
+				if (m_initialized)
+				{
+					get_ptr()->~T();
+				}
+
+				m_initialized = false;
+			}
+
+			const T* get_ptr() const
+			{
+				assert(m_initialized);
+
+				return static_cast<const T*>(m_value.address());
+			}
+
+			T* get_ptr()
+			{
+				assert(m_initialized);
+
+				return static_cast<T*>(m_value.address());
+			}
+		};
+
+		struct optional_empty_byte {};
+
+		//
+		//	Storage for trivially destructible T: a union member is initialized by the mem-initializer,
+		//	so a constexpr optional of a literal type is a constant and can live in read-only data
+		//
+		template <class T>
+		class optional_storage_base<T, true>
+		{
+		protected:
+
+			typedef typename std::remove_const<T>::type stored_type;
+
+			union
+			{
+				optional_empty_byte m_empty;
+
+				stored_type m_value;
+			};
+
+			bool m_initialized;
+
+			SIV_CONSTEXPR optional_storage_base() SIV_NOEXCEPT
+				: m_empty()
+				, m_initialized(false) {}
+
+			// static_cast instead of std::forward, which is not constexpr in C++11
+			template <class... Args>
+			SIV_CONSTEXPR explicit optional_storage_base(in_place_t, Args&&... args)
+				: m_value(static_cast<Args&&>(args)...)
+				, m_initialized(true) {}
+
+			template <class... Args>
+			void construct(Args&&... args)
+			{
+				::new (static_cast<void*>(&m_value)) stored_type(std::forward<Args>(args)...);
+
+				m_initialized = true;
+			}
+
+			void destroy() SIV_NOEXCEPT
+			{
+				m_initialized = false;
+			}
+
+			SIV_CONSTEXPR const T* get_ptr() const
+			{
+				return assert(m_initialized), &m_value;
+			}
+
+			T* get_ptr()
+			{
+				assert(m_initialized);
+
+				return &m_value;
+			}
+		};
+
+		template <class T, bool = std::is_trivially_destructible<T>::value>
+		class optional_destruct_base : public optional_storage_base<T>
+		{
+		protected:
+
+			optional_destruct_base() = default;
+
+			template <class... Args>
+			explicit optional_destruct_base(in_place_t, Args&&... args)
+				: optional_storage_base<T>(in_place, std::forward<Args>(args)...) {}
+
+			~optional_destruct_base()
+			{
+				this->destroy();
+			}
+		};
+
+		template <class T>
+		class optional_destruct_base<T, true> : public optional_storage_base<T>
+		{
+		protected:
+
+			optional_destruct_base() = default;
+
+			template <class... Args>
+			SIV_CONSTEXPR explicit optional_destruct_base(in_place_t, Args&&... args)
+				: optional_storage_base<T>(in_place, static_cast<Args&&>(args)...) {}
+		};
+
+		template <class T, bool = is_trivially_copyable<T>::value>
+		class optional_copy_base : public optional_destruct_base<T>
+		{
+		protected:
+
+			optional_copy_base() = default;
+
+			template <class... Args>
+			SIV_CONSTEXPR explicit optional_copy_base(in_place_t, Args&&... args)
+				: optional_destruct_base<T>(in_place, static_cast<Args&&>(args)...) {}
+
+			optional_copy_base(const optional_copy_base& another)
+				: optional_destruct_base<T>()
+			{
+				if (another.m_initialized)
+				{
+					this->construct(*another.get_ptr());
+				}
+			}
+
+			optional_copy_base(optional_copy_base&& another) SIV_NOEXCEPT
+				: optional_destruct_base<T>()
+			{
+				if (another.m_initialized)
+				{
+					this->construct(std::move(*another.get_ptr()));
+				}
+			}
+
+			optional_copy_base& operator=(const optional_copy_base& another)
+			{
+				if (this->m_initialized && another.m_initialized)
+				{
+					*this->get_ptr() = *another.get_ptr();
+				}
+				else if (another.m_initialized)
+				{
+					this->construct(*another.get_ptr());
+				}
+				else
+				{
+					this->destroy();
+				}
+
+				return *this;
+			}
+
+			optional_copy_base& operator=(optional_copy_base&& another) SIV_NOEXCEPT
+			{
+				if (this->m_initialized && another.m_initialized)
+				{
+					*this->get_ptr() = std::move(*another.get_ptr());
+				}
+				else if (another.m_initialized)
+				{
+					this->construct(std::move(*another.get_ptr()));
+				}
+				else
+				{
+					this->destroy();
+				}
+
+				return *this;
+			}
+		};
+
+		// copies and moves are memcpy, destruction is a no-op
+		template <class T>
+		class optional_copy_base<T, true> : public optional_destruct_base<T>
+		{
+		protected:
+
+			optional_copy_base() = default;
+
+			template <class... Args>
+			SIV_CONSTEXPR explicit optional_copy_base(in_place_t, Args&&... args)
+				: optional_destruct_base<T>(in_place, static_cast<Args&&>(args)...) {}
+		};
+	}
 
 	//
 	//	No-value state indicator
@@ -131,13 +375,19 @@ namespace siv
 	//	optional for object types
 	//
 	template<typename T>
-	class optional
+	class optional : private detail::optional_copy_base<T>
 	{
 	private:
 
-		detail::aligned_storage<T> m_value;
+		typedef detail::optional_copy_base<T> base_type;
+
+		using base_type::m_initialized;
+
+		using base_type::construct;
+
+		using base_type::destroy;
 
-		bool m_initialized = false;
+		using base_type::get_ptr;
 
 	public:
 
@@ -162,71 +412,29 @@ namespace siv
 
 		SIV_CONSTEXPR optional(nullopt_t) SIV_NOEXCEPT{}
 
-		optional(const this_type& another)
-		{
-			SIV_REQUIRES(is_copy_constructible<value_type>);
-
-			if (another)
-			{
-				construct(another.value());
-			}
-		}
-
-		optional(this_type&& another) SIV_NOEXCEPT
-		{
-			SIV_REQUIRES(is_move_constructible<value_type>);
-
-			if (another)
-			{
-				emplace(std::move(another.value()));
-			}
-
-			another = nullopt;
-		}
-
+		// the value is initialized by the base, so that these are constant expressions for literal types
 		SIV_CONSTEXPR optional(const value_type& v)
+			: base_type(in_place, v)
 		{
 			SIV_REQUIRES(is_copy_constructible<value_type>);
-
-			construct(v);
 		}
 
 		SIV_CONSTEXPR optional(rvalue_reference_type v)
+			: base_type(in_place, static_cast<rvalue_reference_type>(v))
 		{
 			SIV_REQUIRES(is_move_constructible<value_type>);
-
-			emplace(v);
 		}
 
 		template <class... Args>
 		SIV_CONSTEXPR explicit optional(in_place_t, Args&&... args)
+			: base_type(in_place, static_cast<Args&&>(args)...)
 		{
 			static_assert(std::is_constructible<value_type, Args&&...>::value, "");
-
-			destroy();
-
-			::new (m_value.address()) value_type(std::forward<Args>(args)...);
-
-			m_initialized = true;
 		}
 
 		template <class U, class... Args>
 		SIV_CONSTEXPR explicit optional(in_place_t, std::initializer_list<U> ilist, Args&&... args)
-		{
-			destroy();
-
-			::new (m_value.address()) value_type(ilist, std::forward<Args>(args)...);
-
-			m_initialized = true;
-		}
-
-		//
-		//	Destructor 
-		//
-		~optional()
-		{
-			destroy();
-		}
+			: base_type(in_place, ilist, static_cast<Args&&>(args)...) {}
 
 		//
 		//	Assignment 
@@ -238,29 +446,10 @@ namespace siv
 			return *this;
 		}
 
-		this_type& operator=(const this_type& another)
-		{
-			SIV_REQUIRES(is_copy_constructible<value_type>);
-			SIV_REQUIRES(is_copy_assignable<value_type>);
-
-			if		(m_initialized == true  && another.m_initialized == false) destroy();
-			else if (m_initialized == false && another.m_initialized == true) construct(*another);
-			else if (m_initialized == true  && another.m_initialized == true) m_value = another.m_value;
-			return *this;
-		}
-
-		this_type& operator=(this_type&& another) SIV_NOEXCEPT
-		{
-			SIV_REQUIRES(is_move_constructible<value_type>);
-			SIV_REQUIRES(is_move_assignable<value_type>);
-
-			if		(m_initialized == true  && another.m_initialized == false) destroy();
-			else if (another.m_initialized == true) construct(std::move(*another));
-			return *this;
-		}
+		// copies and moves of another optional are the base's
 
 		template <class U>
-		this_type& operator=(U&& val)
+		typename std::enable_if<!std::is_same<typename std::decay<U>::type, this_type>::value, this_type&>::type operator=(U&& val)
 		{
 			static_assert(std::is_constructible<value_type, U>::value, "");
 			static_assert(std::is_assignable<value_type&, U>::value, "");
@@ -282,11 +471,7 @@ namespace siv
 		{
 			static_assert(std::is_constructible<value_type, Args&&...>::value, "");
 
-			destroy();
-
-			::new (m_value.address()) T(std::forward<Args>(args)...);
-
-			m_initialized = true;
+			construct(std::forward<Args>(args)...);
 		}
 
 		template <class U, class... Args>
@@ -294,11 +479,7 @@ namespace siv
 		{
 			static_assert(std::is_constructible<value_type, std::initializer_list<U>&, Args&&...>::value, "");
 
-			destroy();
-
-			::new (m_value.address()) T(ilist, std::forward<Args>(args)...);
-
-			m_initialized = true;
+			construct(ilist, std::forward<Args>(args)...);
 		}
 
 		//
@@ -345,12 +526,7 @@ namespace siv
 
 		SIV_CONSTEXPR reference_const_type value() const
 		{
-			if (!m_initialized)
-			{
-				throw bad_optional_access("bad access");
-			}
-
-			return *get_ptr();
+			return m_initialized ? *get_ptr() : (throw bad_optional_access("bad access"), *get_ptr());
 		}
 
 		reference_type value()
@@ -372,12 +548,7 @@ namespace siv
 			SIV_REQUIRES(is_copy_constructible<value_type>);
 			static_assert(std::is_convertible<U&&, value_type>::value, "");
 
-			if (static_cast<bool>(*this))
-			{
-				return **this;
-			}
-
-			return static_cast<value_type>(std::forward<U>(v));
+			return static_cast<bool>(*this) ? **this : static_cast<value_type>(static_cast<U&&>(v));
 		}
 
 #ifdef SIV_CPP11_IMPLEMENTED
@@ -395,50 +566,6 @@ namespace siv
 			return static_cast<value_type>(std::forward<U>(v));
 		}
 #endif
-
-	private:
-
-		void construct(reference_const_type v)
-		{
-			destroy();
-
-			::new (m_value.address()) value_type(v);
-
-			m_initialized = true;
-		}
-
-		void construct(rvalue_reference_type v)
-		{
-			destroy();
-
-			::new (m_value.address()) value_type(std::forward<value_type>(v));
-
-			m_initialized = true;
-		}
-
-		void destroy() SIV_NOEXCEPT
-		{
-			if (static_cast<bool>(*this))
-			{
-				get_ptr()->~T();
-			}
-
-			m_initialized = false;
-		}
-
-		pointer_const_type get_ptr() const
-		{
-			assert(static_cast<bool>(*this));
-
-			return static_cast<pointer_const_type>(m_value.address());
-		}
-
-		pointer_type get_ptr()
-		{
-			assert(static_cast<bool>(*this));
-
-			return static_cast<pointer_type>(m_value.address());
-		}
 	};
 
 	//
@@ -447,17 +574,7 @@ namespace siv
 	template <class T>
 	SIV_CONSTEXPR bool operator==(const optional<T>& x, const optional<T>& y)
 	{
-		if (static_cast<bool>(x) != static_cast<bool>(y))
-		{
-			return false;
-		}
-		
-		if (!x)
-		{
-			return true;
-		}
-
-		return *x == *y;
+		return static_cast<bool>(x) != static_cast<bool>(y) ? false : (!x ? true : *x == *y);
 	}
 
 	template <class T>
@@ -469,16 +586,7 @@ namespace siv
 	template <class T>
 	SIV_CONSTEXPR bool operator<(const optional<T>& x, const optional<T>& y)
 	{
-		if (!y)
-		{
-			return false;
-		}
-		else if (!x)
-		{
-			return true;
-		}
-		
-		return *x < *y;
+		return !y ? false : (!x ? true : *x < *y);
 	}
 
 	template <class T>
@@ -655,7 +763,7 @@ namespace siv
 	template <class T>
 	SIV_CONSTEXPR optional<typename std::decay<T>::type> make_optional(T&& v)
 	{
-		return optional<typename std::decay<T>::type>(std::forward<T>(v));
+		return optional<typename std::decay<T>::type>(static_cast<T&&>(v));
 	}
 }
 
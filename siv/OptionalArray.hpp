@@ -0,0 +1,516 @@
+﻿//------------------------------------------
+//	OptionalArray.hpp
+//	Copyright (c) 2014 Reputeless
+//	<reputeless@gmail.com>
+//	Distributed under the MIT license.
+//------------------------------------------
+
+# pragma once
+# include <cstdint>
+# include <cstring>
+# include <vector>
+# include <algorithm>
+# include "Optional.hpp"
+
+# if defined(_MSC_VER)
+#	include <intrin.h>
+# endif
+
+namespace siv
+{
+	namespace detail
+	{
+		inline unsigned PopCount64(std::uint64_t word)
+		{
+#if defined(_MSC_VER)
+
+			// __popcnt64 faults on CPUs without POPCNT
+			word = word - ((word >> 1) & 0x5555555555555555ull);
+			word = (word & 0x3333333333333333ull) + ((word >> 2) & 0x3333333333333333ull);
+			word = (word + (word >> 4)) & 0x0F0F0F0F0F0F0F0Full;
+
+			return static_cast<unsigned>((word * 0x0101010101010101ull) >> 56);
+
+#else
+
+			return static_cast<unsigned>(__builtin_popcountll(word));
+
+#endif
+		}
+
+		// index of the lowest set bit; word != 0
+		inline unsigned LowestBit64(std::uint64_t word)
+		{
+#if defined(_MSC_VER) && defined(_M_X64)
+
+			unsigned long index;
+
+			::_BitScanForward64(&index, word);
+
+			return index;
+
+#elif defined(_MSC_VER)
+
+			return PopCount64((word & (0 - word)) - 1);
+
+#else
+
+			return static_cast<unsigned>(__builtin_ctzll(word));
+
+#endif
+		}
+
+		// bits [0, count) set, count <= 64
+		inline std::uint64_t LowBits64(size_t count)
+		{
+			return count >= 64 ? ~0ull : ((1ull << count) - 1);
+		}
+
+		//
+		//	Observers shared by the mutable and the const element proxy
+		//
+		template <class Value, class Word>
+		class optional_array_proxy_base
+		{
+		public:
+
+			typedef typename std::remove_const<Value>::type value_type;
+
+			explicit operator bool() const
+			{
+				return (*m_word & m_mask) != 0;
+			}
+
+			Value& operator *() const
+			{
+				assert(static_cast<bool>(*this));
+
+				return *m_value;
+			}
+
+			Value* operator ->() const
+			{
+				assert(static_cast<bool>(*this));
+
+				return m_value;
+			}
+
+			Value& value() const
+			{
+				if (!*this)
+				{
+					throw bad_optional_access("bad access");
+				}
+
+				return *m_value;
+			}
+
+			template <class U>
+			value_type value_or(U&& v) const
+			{
+				static_assert(std::is_convertible<U&&, value_type>::value, "");
+
+				if (static_cast<bool>(*this))
+				{
+					return *m_value;
+				}
+
+				return static_cast<value_type>(std::forward<U>(v));
+			}
+
+			operator optional<value_type>() const
+			{
+				if (static_cast<bool>(*this))
+				{
+					return optional<value_type>(*m_value);
+				}
+
+				return optional<value_type>();
+			}
+
+		protected:
+
+			Value* m_value;
+
+			Word* m_word;
+
+			std::uint64_t m_mask;
+
+			optional_array_proxy_base(Value* value, Word* word, std::uint64_t mask)
+				: m_value(value)
+				, m_word(word)
+				, m_mask(mask) {}
+		};
+	}
+
+	//
+	//	Element of a const optional_array, observed like an optional
+	//
+	template <class T>
+	class optional_array_const_reference : public detail::optional_array_proxy_base<const T, const std::uint64_t>
+	{
+	public:
+
+		optional_array_const_reference(const T* value, const std::uint64_t* word, std::uint64_t mask)
+			: detail::optional_array_proxy_base<const T, const std::uint64_t>(value, word, mask) {}
+	};
+
+	//
+	//	Element of an optional_array; assigning a value, nullopt or an optional writes through
+	//
+	template <class T>
+	class optional_array_reference : public detail::optional_array_proxy_base<T, std::uint64_t>
+	{
+	public:
+
+		optional_array_reference(T* value, std::uint64_t* word, std::uint64_t mask)
+			: detail::optional_array_proxy_base<T, std::uint64_t>(value, word, mask) {}
+
+		optional_array_reference& operator=(const T& v)
+		{
+			*this->m_value = v;
+
+			*this->m_word |= this->m_mask;
+
+			return *this;
+		}
+
+		optional_array_reference& operator=(nullopt_t)
+		{
+			// null slots hold T() so that bulk kernels can read them unconditionally
+			*this->m_value = T();
+
+			*this->m_word &= ~this->m_mask;
+
+			return *this;
+		}
+
+		optional_array_reference& operator=(const optional<T>& v)
+		{
+			return v ? (*this = *v) : (*this = nullopt);
+		}
+
+		// assigns the element, as an optional would; the proxy is not rebound
+		optional_array_reference& operator=(const optional_array_reference& another)
+		{
+			return another ? (*this = *another) : (*this = nullopt);
+		}
+
+		operator optional_array_const_reference<T>() const
+		{
+			return optional_array_const_reference<T>(this->m_value, this->m_word, this->m_mask);
+		}
+	};
+
+	template <class V, class W>
+	bool operator==(const detail::optional_array_proxy_base<V, W>& x, nullopt_t)
+	{
+		return !x;
+	}
+
+	template <class V, class W>
+	bool operator!=(const detail::optional_array_proxy_base<V, W>& x, nullopt_t)
+	{
+		return static_cast<bool>(x);
+	}
+
+	template <class V, class W>
+	bool operator==(const detail::optional_array_proxy_base<V, W>& x, const typename std::remove_const<V>::type& v)
+	{
+		return static_cast<bool>(x) ? (*x == v) : false;
+	}
+
+	template <class V, class W>
+	bool operator!=(const detail::optional_array_proxy_base<V, W>& x, const typename std::remove_const<V>::type& v)
+	{
+		return !(x == v);
+	}
+
+	//
+	//	Column of optional values: the values in one dense buffer, presence in a separate bitmap of 64-bit words
+	//	(bit i % 64 of word i / 64, as Apache Arrow). Null slots hold T() and bits past size() are zero,
+	//	so values() and validity() can be processed in bulk without looking at individual elements.
+	//
+	template <class T>
+	class optional_array
+	{
+	public:
+
+		static_assert(detail::is_trivially_copyable<T>::value, "optional_array requires a trivially copyable type");
+
+		typedef T									value_type;
+		typedef optional_array_reference<T>			reference;
+		typedef optional_array_const_reference<T>	const_reference;
+		typedef size_t								size_type;
+
+		optional_array() = default;
+
+		explicit optional_array(size_type count)
+		{
+			append_null(count);
+		}
+
+		optional_array(std::initializer_list<optional<T>> ilist)
+		{
+			reserve(ilist.size());
+
+			for (const auto& v : ilist)
+			{
+				push_back(v);
+			}
+		}
+
+		size_type size() const
+		{
+			return m_values.size();
+		}
+
+		bool empty() const
+		{
+			return m_values.empty();
+		}
+
+		void reserve(size_type count)
+		{
+			m_values.reserve(count);
+
+			m_validity.reserve(word_count(count));
+		}
+
+		//
+		//	New elements are null
+		//
+		void resize(size_type count)
+		{
+			if (count >= size())
+			{
+				append_null(count - size());
+
+				return;
+			}
+
+			m_values.resize(count);
+
+			m_validity.resize(word_count(count));
+
+			if (count % 64)
+			{
+				m_validity.back() &= detail::LowBits64(count % 64);
+			}
+		}
+
+		void clear()
+		{
+			m_values.clear();
+
+			m_validity.clear();
+		}
+
+		//
+		//	Element access
+		//
+		reference operator[](size_type index)
+		{
+			assert(index < size());
+
+			return reference(&m_values[index], &m_validity[index / 64], 1ull << (index % 64));
+		}
+
+		const_reference operator[](size_type index) const
+		{
+			assert(index < size());
+
+			return const_reference(&m_values[index], &m_validity[index / 64], 1ull << (index % 64));
+		}
+
+		bool is_valid(size_type index) const
+		{
+			assert(index < size());
+
+			return (m_validity[index / 64] >> (index % 64)) & 1;
+		}
+
+		//
+		//	Appending
+		//
+		void push_back(const T& v)
+		{
+			const size_type index = size();
+
+			m_values.push_back(v);
+
+			if (index % 64 == 0)
+			{
+				m_validity.push_back(0);
+			}
+
+			m_validity.back() |= 1ull << (index % 64);
+		}
+
+		void push_back(nullopt_t)
+		{
+			append_null(1);
+		}
+
+		void push_back(const optional<T>& v)
+		{
+			if (v)
+			{
+				push_back(*v);
+			}
+			else
+			{
+				append_null(1);
+			}
+		}
+
+		//
+		//	Appends count non-null values
+		//
+		void append(const T* values, size_type count)
+		{
+			const size_type first = size();
+
+			m_values.insert(m_values.end(), values, values + count);
+
+			m_validity.resize(word_count(first + count), 0);
+
+			set_bits(first, first + count);
+		}
+
+		//
+		//	Appends count values with their presence in an Arrow-style bitmap starting at bit 0.
+		//	Values at null positions are replaced with T().
+		//
+		void append(const T* values, const std::uint64_t* validity, size_type count)
+		{
+			const size_type first = size();
+
+			m_values.insert(m_values.end(), values, values + count);
+
+			m_validity.resize(word_count(first + count), 0);
+
+			const size_type shift = first % 64;
+
+			for (size_type i = 0; i < word_count(count); ++i)
+			{
+				const std::uint64_t word = validity[i] & detail::LowBits64(count - i * 64);
+
+				const size_type target = first / 64 + i;
+
+				m_validity[target] |= word << shift;
+
+				if (shift && (word >> (64 - shift)))
+				{
+					m_validity[target + 1] |= word >> (64 - shift);
+				}
+
+				for (std::uint64_t nulls = ~word & detail::LowBits64(count - i * 64); nulls; nulls &= nulls - 1)
+				{
+					m_values[first + i * 64 + detail::LowestBit64(nulls)] = T();
+				}
+			}
+		}
+
+		void append_null(size_type count)
+		{
+			m_values.resize(size() + count, T());
+
+			m_validity.resize(word_count(size()), 0);
+		}
+
+		//
+		//	Nulls [first, first + count), a word at a time
+		//
+		void set_null(size_type first, size_type count)
+		{
+			assert(first + count <= size());
+
+			std::fill(m_values.begin() + first, m_values.begin() + first + count, T());
+
+			clear_bits(first, first + count);
+		}
+
+		//
+		//	Counting
+		//
+		size_type valid_count() const
+		{
+			size_type count = 0;
+
+			for (const std::uint64_t word : m_validity)
+			{
+				count += detail::PopCount64(word);
+			}
+
+			return count;
+		}
+
+		size_type null_count() const
+		{
+			return size() - valid_count();
+		}
+
+		//
+		//	Raw buffers
+		//
+		const T* values() const
+		{
+			return m_values.data();
+		}
+
+		T* values()
+		{
+			return m_values.data();
+		}
+
+		const std::uint64_t* validity() const
+		{
+			return m_validity.data();
+		}
+
+		size_type validity_word_count() const
+		{
+			return m_validity.size();
+		}
+
+	private:
+
+		std::vector<T> m_values;
+
+		std::vector<std::uint64_t> m_validity;
+
+		static size_type word_count(size_type count)
+		{
+			return (count + 63) / 64;
+		}
+
+		void set_bits(size_type first, size_type last)
+		{
+			for (size_type i = first; i < last;)
+			{
+				const size_type bit = i % 64;
+
+				const size_type n = std::min<size_type>(64 - bit, last - i);
+
+				m_validity[i / 64] |= detail::LowBits64(n) << bit;
+
+				i += n;
+			}
+		}
+
+		void clear_bits(size_type first, size_type last)
+		{
+			for (size_type i = first; i < last;)
+			{
+				const size_type bit = i % 64;
+
+				const size_type n = std::min<size_type>(64 - bit, last - i);
+
+				m_validity[i / 64] &= ~(detail::LowBits64(n) << bit);
+
+				i += n;
+			}
+		}
+	};
+}
@@ -0,0 +1,610 @@
+﻿//------------------------------------------
+//	OptionalArrayKernels.hpp
+//	Copyright (c) 2014 Reputeless
+//	<reputeless@gmail.com>
+//	Distributed under the MIT license.
+//------------------------------------------
+
+# pragma once
+# include <cstdint>
+# include <limits>
+# include <vector>
+# include <algorithm>
+# include <iterator>
+# include "OptionalArray.hpp"
+
+//
+//	Kernels for float and double use the widest instruction set enabled at compile time
+//	(-mavx512f / -mavx2, /arch:AVX512 / /arch:AVX2); define SIV_OPTIONAL_NO_SIMD for the scalar code only
+//
+# if !defined(SIV_OPTIONAL_NO_SIMD) && defined(__AVX512F__)
+#	define SIV_OPTIONAL_AVX512 1
+# elif !defined(SIV_OPTIONAL_NO_SIMD) && defined(__AVX2__)
+#	define SIV_OPTIONAL_AVX2 1
+# endif
+
+# if defined(SIV_OPTIONAL_AVX512) || defined(SIV_OPTIONAL_AVX2)
+#	include <immintrin.h>
+# endif
+
+namespace siv
+{
+	namespace detail
+	{
+		//
+		//	Scalar kernels over [first, last): nulls are replaced by the identity with a select, not a branch
+		//
+		template <class T>
+		T SumScalar(const T* values, const std::uint64_t* validity, size_t first, size_t last)
+		{
+			T sum = T();
+
+			for (size_t i = first; i < last; ++i)
+			{
+				const bool valid = (validity[i / 64] >> (i % 64)) & 1;
+
+				sum += valid ? values[i] : T();
+			}
+
+			return sum;
+		}
+
+		template <class T>
+		T MinScalar(const T* values, const std::uint64_t* validity, size_t first, size_t last, T identity)
+		{
+			T result = identity;
+
+			for (size_t i = first; i < last; ++i)
+			{
+				const bool valid = (validity[i / 64] >> (i % 64)) & 1;
+
+				const T v = valid ? values[i] : identity;
+
+				result = v < result ? v : result;
+			}
+
+			return result;
+		}
+
+		template <class T>
+		T MaxScalar(const T* values, const std::uint64_t* validity, size_t first, size_t last, T identity)
+		{
+			T result = identity;
+
+			for (size_t i = first; i < last; ++i)
+			{
+				const bool valid = (validity[i / 64] >> (i % 64)) & 1;
+
+				const T v = valid ? values[i] : identity;
+
+				result = result < v ? v : result;
+			}
+
+			return result;
+		}
+
+		template <class T>
+		T LowestValue()
+		{
+			return std::numeric_limits<T>::has_infinity ? -std::numeric_limits<T>::infinity() : std::numeric_limits<T>::lowest();
+		}
+
+		template <class T>
+		T HighestValue()
+		{
+			return std::numeric_limits<T>::has_infinity ? std::numeric_limits<T>::infinity() : std::numeric_limits<T>::max();
+		}
+
+		//
+		//	Dispatch: the templates are the fallback, the overloads below take float and double
+		//
+		template <class T>
+		T Sum(const T* values, const std::uint64_t* validity, size_t count)
+		{
+			return SumScalar(values, validity, 0, count);
+		}
+
+		template <class T>
+		T Min(const T* values, const std::uint64_t* validity, size_t count)
+		{
+			return MinScalar(values, validity, 0, count, HighestValue<T>());
+		}
+
+		template <class T>
+		T Max(const T* values, const std::uint64_t* validity, size_t count)
+		{
+			return MaxScalar(values, validity, 0, count, LowestValue<T>());
+		}
+
+#if defined(SIV_OPTIONAL_AVX512)
+
+		//
+		//	AVX-512: the validity bits are the lane masks.
+		//	Lanes are reduced through memory; _mm512_reduce_* trips -Wuninitialized in GCC's own headers.
+		//
+		inline double ReduceAdd(__m512d v)
+		{
+			alignas(64) double lanes[8];
+
+			_mm512_store_pd(lanes, v);
+
+			return ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) + ((lanes[4] + lanes[5]) + (lanes[6] + lanes[7]));
+		}
+
+		inline float ReduceAdd(__m512 v)
+		{
+			alignas(64) float lanes[16];
+
+			_mm512_store_ps(lanes, v);
+
+			float sum = 0.0f;
+
+			for (float lane : lanes)
+			{
+				sum += lane;
+			}
+
+			return sum;
+		}
+
+		inline double ReduceMin(__m512d v)
+		{
+			alignas(64) double lanes[8];
+
+			_mm512_store_pd(lanes, v);
+
+			return *std::min_element(std::begin(lanes), std::end(lanes));
+		}
+
+		inline double ReduceMax(__m512d v)
+		{
+			alignas(64) double lanes[8];
+
+			_mm512_store_pd(lanes, v);
+
+			return *std::max_element(std::begin(lanes), std::end(lanes));
+		}
+
+		inline float ReduceMin(__m512 v)
+		{
+			alignas(64) float lanes[16];
+
+			_mm512_store_ps(lanes, v);
+
+			return *std::min_element(std::begin(lanes), std::end(lanes));
+		}
+
+		inline float ReduceMax(__m512 v)
+		{
+			alignas(64) float lanes[16];
+
+			_mm512_store_ps(lanes, v);
+
+			return *std::max_element(std::begin(lanes), std::end(lanes));
+		}
+
+		inline double Sum(const double* values, const std::uint64_t* validity, size_t count)
+		{
+			const size_t words = count / 64;
+
+			__m512d acc0 = _mm512_setzero_pd(), acc1 = _mm512_setzero_pd();
+
+			for (size_t w = 0; w < words; ++w)
+			{
+				const std::uint64_t bits = validity[w];
+
+				const double* p = values + w * 64;
+
+				for (int k = 0; k < 8; k += 2)
+				{
+					acc0 = _mm512_mask_add_pd(acc0, static_cast<__mmask8>(bits >> (k * 8)), acc0, _mm512_loadu_pd(p + k * 8));
+
+					acc1 = _mm512_mask_add_pd(acc1, static_cast<__mmask8>(bits >> (k * 8 + 8)), acc1, _mm512_loadu_pd(p + k * 8 + 8));
+				}
+			}
+
+			return ReduceAdd(_mm512_add_pd(acc0, acc1)) + SumScalar(values, validity, words * 64, count);
+		}
+
+		inline float Sum(const float* values, const std::uint64_t* validity, size_t count)
+		{
+			const size_t words = count / 64;
+
+			__m512 acc0 = _mm512_setzero_ps(), acc1 = _mm512_setzero_ps();
+
+			for (size_t w = 0; w < words; ++w)
+			{
+				const std::uint64_t bits = validity[w];
+
+				const float* p = values + w * 64;
+
+				acc0 = _mm512_mask_add_ps(acc0, static_cast<__mmask16>(bits), acc0, _mm512_loadu_ps(p));
+				acc1 = _mm512_mask_add_ps(acc1, static_cast<__mmask16>(bits >> 16), acc1, _mm512_loadu_ps(p + 16));
+				acc0 = _mm512_mask_add_ps(acc0, static_cast<__mmask16>(bits >> 32), acc0, _mm512_loadu_ps(p + 32));
+				acc1 = _mm512_mask_add_ps(acc1, static_cast<__mmask16>(bits >> 48), acc1, _mm512_loadu_ps(p + 48));
+			}
+
+			return ReduceAdd(_mm512_add_ps(acc0, acc1)) + SumScalar(values, validity, words * 64, count);
+		}
+
+		inline double Min(const double* values, const std::uint64_t* validity, size_t count)
+		{
+			const size_t words = count / 64;
+
+			__m512d acc = _mm512_set1_pd(HighestValue<double>());
+
+			for (size_t w = 0; w < words; ++w)
+			{
+				for (int k = 0; k < 8; ++k)
+				{
+					acc = _mm512_mask_min_pd(acc, static_cast<__mmask8>(validity[w] >> (k * 8)), acc, _mm512_loadu_pd(values + w * 64 + k * 8));
+				}
+			}
+
+			return std::min(ReduceMin(acc), MinScalar(values, validity, words * 64, count, HighestValue<double>()));
+		}
+
+		inline double Max(const double* values, const std::uint64_t* validity, size_t count)
+		{
+			const size_t words = count / 64;
+
+			__m512d acc = _mm512_set1_pd(LowestValue<double>());
+
+			for (size_t w = 0; w < words; ++w)
+			{
+				for (int k = 0; k < 8; ++k)
+				{
+					acc = _mm512_mask_max_pd(acc, static_cast<__mmask8>(validity[w] >> (k * 8)), acc, _mm512_loadu_pd(values + w * 64 + k * 8));
+				}
+			}
+
+			return std::max(ReduceMax(acc), MaxScalar(values, validity, words * 64, count, LowestValue<double>()));
+		}
+
+		inline float Min(const float* values, const std::uint64_t* validity, size_t count)
+		{
+			const size_t words = count / 64;
+
+			__m512 acc = _mm512_set1_ps(HighestValue<float>());
+
+			for (size_t w = 0; w < words; ++w)
+			{
+				for (int k = 0; k < 4; ++k)
+				{
+					acc = _mm512_mask_min_ps(acc, static_cast<__mmask16>(validity[w] >> (k * 16)), acc, _mm512_loadu_ps(values + w * 64 + k * 16));
+				}
+			}
+
+			return std::min(ReduceMin(acc), MinScalar(values, validity, words * 64, count, HighestValue<float>()));
+		}
+
+		inline float Max(const float* values, const std::uint64_t* validity, size_t count)
+		{
+			const size_t words = count / 64;
+
+			__m512 acc = _mm512_set1_ps(LowestValue<float>());
+
+			for (size_t w = 0; w < words; ++w)
+			{
+				for (int k = 0; k < 4; ++k)
+				{
+					acc = _mm512_mask_max_ps(acc, static_cast<__mmask16>(validity[w] >> (k * 16)), acc, _mm512_loadu_ps(values + w * 64 + k * 16));
+				}
+			}
+
+			return std::max(ReduceMax(acc), MaxScalar(values, validity, words * 64, count, LowestValue<float>()));
+		}
+
+#elif defined(SIV_OPTIONAL_AVX2)
+
+		//
+		//	AVX2: validity bits are widened to lane masks by testing each lane's bit
+		//
+		inline __m256d LaneMask4(std::uint64_t bits)
+		{
+			const __m256i lanes = _mm256_setr_epi64x(1, 2, 4, 8);
+
+			const __m256i broadcast = _mm256_set1_epi64x(static_cast<long long>(bits));
+
+			return _mm256_castsi256_pd(_mm256_cmpeq_epi64(_mm256_and_si256(broadcast, lanes), lanes));
+		}
+
+		inline __m256 LaneMask8(std::uint64_t bits)
+		{
+			const __m256i lanes = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+
+			const __m256i broadcast = _mm256_set1_epi32(static_cast<int>(bits & 0xFF));
+
+			return _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(broadcast, lanes), lanes));
+		}
+
+		inline double HorizontalSum(__m256d v)
+		{
+			const __m128d pair = _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+
+			return _mm_cvtsd_f64(_mm_add_sd(pair, _mm_unpackhi_pd(pair, pair)));
+		}
+
+		inline float HorizontalSum(__m256 v)
+		{
+			__m128 quad = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+
+			quad = _mm_add_ps(quad, _mm_movehl_ps(quad, quad));
+
+			return _mm_cvtss_f32(_mm_add_ss(quad, _mm_shuffle_ps(quad, quad, 1)));
+		}
+
+		inline double Sum(const double* values, const std::uint64_t* validity, size_t count)
+		{
+			const size_t words = count / 64;
+
+			__m256d acc0 = _mm256_setzero_pd(), acc1 = _mm256_setzero_pd();
+
+			for (size_t w = 0; w < words; ++w)
+			{
+				const std::uint64_t bits = validity[w];
+
+				const double* p = values + w * 64;
+
+				for (int k = 0; k < 16; k += 2)
+				{
+					acc0 = _mm256_add_pd(acc0, _mm256_and_pd(_mm256_loadu_pd(p + k * 4), LaneMask4(bits >> (k * 4))));
+
+					acc1 = _mm256_add_pd(acc1, _mm256_and_pd(_mm256_loadu_pd(p + k * 4 + 4), LaneMask4(bits >> (k * 4 + 4))));
+				}
+			}
+
+			return HorizontalSum(_mm256_add_pd(acc0, acc1)) + SumScalar(values, validity, words * 64, count);
+		}
+
+		inline float Sum(const float* values, const std::uint64_t* validity, size_t count)
+		{
+			const size_t words = count / 64;
+
+			__m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+
+			for (size_t w = 0; w < words; ++w)
+			{
+				const std::uint64_t bits = validity[w];
+
+				const float* p = values + w * 64;
+
+				for (int k = 0; k < 8; k += 2)
+				{
+					acc0 = _mm256_add_ps(acc0, _mm256_and_ps(_mm256_loadu_ps(p + k * 8), LaneMask8(bits >> (k * 8))));
+
+					acc1 = _mm256_add_ps(acc1, _mm256_and_ps(_mm256_loadu_ps(p + k * 8 + 8), LaneMask8(bits >> (k * 8 + 8))));
+				}
+			}
+
+			return HorizontalSum(_mm256_add_ps(acc0, acc1)) + SumScalar(values, validity, words * 64, count);
+		}
+
+		inline double Min(const double* values, const std::uint64_t* validity, size_t count)
+		{
+			const size_t words = count / 64;
+
+			const __m256d identity = _mm256_set1_pd(HighestValue<double>());
+
+			__m256d acc = identity;
+
+			for (size_t w = 0; w < words; ++w)
+			{
+				for (int k = 0; k < 16; ++k)
+				{
+					const __m256d v = _mm256_blendv_pd(identity, _mm256_loadu_pd(values + w * 64 + k * 4), LaneMask4(validity[w] >> (k * 4)));
+
+					acc = _mm256_min_pd(acc, v);
+				}
+			}
+
+			alignas(32) double lanes[4];
+
+			_mm256_store_pd(lanes, acc);
+
+			return std::min(std::min(std::min(lanes[0], lanes[1]), std::min(lanes[2], lanes[3])),
+				MinScalar(values, validity, words * 64, count, HighestValue<double>()));
+		}
+
+		inline double Max(const double* values, const std::uint64_t* validity, size_t count)
+		{
+			const size_t words = count / 64;
+
+			const __m256d identity = _mm256_set1_pd(LowestValue<double>());
+
+			__m256d acc = identity;
+
+			for (size_t w = 0; w < words; ++w)
+			{
+				for (int k = 0; k < 16; ++k)
+				{
+					const __m256d v = _mm256_blendv_pd(identity, _mm256_loadu_pd(values + w * 64 + k * 4), LaneMask4(validity[w] >> (k * 4)));
+
+					acc = _mm256_max_pd(acc, v);
+				}
+			}
+
+			alignas(32) double lanes[4];
+
+			_mm256_store_pd(lanes, acc);
+
+			return std::max(std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3])),
+				MaxScalar(values, validity, words * 64, count, LowestValue<double>()));
+		}
+
+		inline float Min(const float* values, const std::uint64_t* validity, size_t count)
+		{
+			const size_t words = count / 64;
+
+			const __m256 identity = _mm256_set1_ps(HighestValue<float>());
+
+			__m256 acc = identity;
+
+			for (size_t w = 0; w < words; ++w)
+			{
+				for (int k = 0; k < 8; ++k)
+				{
+					const __m256 v = _mm256_blendv_ps(identity, _mm256_loadu_ps(values + w * 64 + k * 8), LaneMask8(validity[w] >> (k * 8)));
+
+					acc = _mm256_min_ps(acc, v);
+				}
+			}
+
+			alignas(32) float lanes[8];
+
+			_mm256_store_ps(lanes, acc);
+
+			return std::min(*std::min_element(lanes, lanes + 8), MinScalar(values, validity, words * 64, count, HighestValue<float>()));
+		}
+
+		inline float Max(const float* values, const std::uint64_t* validity, size_t count)
+		{
+			const size_t words = count / 64;
+
+			const __m256 identity = _mm256_set1_ps(LowestValue<float>());
+
+			__m256 acc = identity;
+
+			for (size_t w = 0; w < words; ++w)
+			{
+				for (int k = 0; k < 8; ++k)
+				{
+					const __m256 v = _mm256_blendv_ps(identity, _mm256_loadu_ps(values + w * 64 + k * 8), LaneMask8(validity[w] >> (k * 8)));
+
+					acc = _mm256_max_ps(acc, v);
+				}
+			}
+
+			alignas(32) float lanes[8];
+
+			_mm256_store_ps(lanes, acc);
+
+			return std::max(*std::max_element(lanes, lanes + 8), MaxScalar(values, validity, words * 64, count, LowestValue<float>()));
+		}
+
+#endif
+	}
+
+	//
+	//	Null-aware reductions: nulls are skipped. Results over NaNs are unspecified.
+	//	Floating-point sums are accumulated in several lanes, so they may differ from a sequential sum in the last bits.
+	//
+	template <class T>
+	T sum(const optional_array<T>& a)
+	{
+		static_assert(std::is_arithmetic<T>::value, "sum requires an arithmetic type");
+
+		return detail::Sum(a.values(), a.validity(), a.size());
+	}
+
+	// number of non-null elements
+	template <class T>
+	size_t count(const optional_array<T>& a)
+	{
+		return a.valid_count();
+	}
+
+	//
+	//	nullopt when every element is null
+	//
+	template <class T>
+	optional<T> min(const optional_array<T>& a)
+	{
+		static_assert(std::is_arithmetic<T>::value, "min requires an arithmetic type");
+
+		if (a.valid_count() == 0)
+		{
+			return nullopt;
+		}
+
+		return detail::Min(a.values(), a.validity(), a.size());
+	}
+
+	template <class T>
+	optional<T> max(const optional_array<T>& a)
+	{
+		static_assert(std::is_arithmetic<T>::value, "max requires an arithmetic type");
+
+		if (a.valid_count() == 0)
+		{
+			return nullopt;
+		}
+
+		return detail::Max(a.values(), a.validity(), a.size());
+	}
+
+	template <class T>
+	optional<double> mean(const optional_array<T>& a)
+	{
+		const size_t n = a.valid_count();
+
+		if (n == 0)
+		{
+			return nullopt;
+		}
+
+		return static_cast<double>(sum(a)) / n;
+	}
+
+	//
+	//	The non-null elements satisfying predicate, in order. The predicate runs on every slot, nulls included (they hold T()),
+	//	so that it is evaluated 64 at a time into a bitmask without branches.
+	//
+	template <class T, class Predicate>
+	optional_array<T> filter(const optional_array<T>& a, Predicate predicate)
+	{
+		const T* values = a.values();
+
+		std::vector<T> selected;
+
+		for (size_t w = 0; w < a.validity_word_count(); ++w)
+		{
+			const size_t first = w * 64;
+
+			const size_t n = std::min<size_t>(64, a.size() - first);
+
+			std::uint64_t keep = 0;
+
+			for (size_t j = 0; j < n; ++j)
+			{
+				keep |= static_cast<std::uint64_t>(predicate(values[first + j]) ? 1 : 0) << j;
+			}
+
+			for (keep &= a.validity()[w]; keep; keep &= keep - 1)
+			{
+				selected.push_back(values[first + detail::LowestBit64(keep)]);
+			}
+		}
+
+		optional_array<T> result;
+
+		result.append(selected.data(), selected.size());
+
+		return result;
+	}
+
+	//
+	//	Applies function to every slot and keeps the validity bitmap: null in, null out.
+	//	function must accept T(), which null slots hold.
+	//
+	template <class T, class Function>
+	auto transform(const optional_array<T>& a, Function function) -> optional_array<typename std::decay<decltype(function(std::declval<const T&>()))>::type>
+	{
+		typedef typename std::decay<decltype(function(std::declval<const T&>()))>::type result_type;
+
+		std::vector<result_type> values(a.size());
+
+		const T* source = a.values();
+
+		for (size_t i = 0; i < values.size(); ++i)
+		{
+			values[i] = function(source[i]);
+		}
+
+		optional_array<result_type> result;
+
+		result.append(values.data(), a.validity(), values.size());
+
+		return result;
+	}
+}
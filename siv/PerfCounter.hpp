@@ -0,0 +1,466 @@
+﻿//------------------------------------------
+//	PerfCounter.hpp
+//	Copyright (c) 2014 Reputeless
+//	<reputeless@gmail.com>
+//	Distributed under the MIT license.
+//------------------------------------------
+
+# pragma once
+# include <cstring>
+# include <ostream>
+# include "Profiler.hpp"
+
+# if defined(__linux__)
+#	include <unistd.h>
+#	include <sys/mman.h>
+#	include <sys/syscall.h>
+#	include <sys/ioctl.h>
+#	include <linux/perf_event.h>
+# endif
+
+namespace siv
+{
+	enum class PerfEvent
+	{
+		Cycles,
+
+		Instructions,
+
+		L1DMisses,
+
+		LLCMisses,
+
+		BranchMisses,
+
+		Count
+	};
+
+	//
+	//	One reading of every hardware counter
+	//
+	struct PerfCounterSample
+	{
+		unsigned long long values[static_cast<size_t>(PerfEvent::Count)] = {};
+
+		unsigned long long operator [](PerfEvent event) const
+		{
+			return values[static_cast<size_t>(event)];
+		}
+
+		unsigned long long& operator [](PerfEvent event)
+		{
+			return values[static_cast<size_t>(event)];
+		}
+
+		PerfCounterSample operator -(const PerfCounterSample& another) const
+		{
+			PerfCounterSample result;
+
+			for (size_t i = 0; i < static_cast<size_t>(PerfEvent::Count); ++i)
+			{
+				result.values[i] = values[i] - another.values[i];
+			}
+
+			return result;
+		}
+
+		PerfCounterSample& operator +=(const PerfCounterSample& another)
+		{
+			for (size_t i = 0; i < static_cast<size_t>(PerfEvent::Count); ++i)
+			{
+				values[i] += another.values[i];
+			}
+
+			return *this;
+		}
+	};
+
+	//
+	//	perf_event group of the calling thread, read with rdpmc when the kernel allows it
+	//
+	class PerfCounterGroup
+	{
+	public:
+
+		PerfCounterGroup()
+		{
+			for (size_t i = 0; i < EventCount; ++i)
+			{
+				m_fds[i] = -1;
+
+				m_pages[i] = nullptr;
+			}
+
+			open();
+		}
+
+		~PerfCounterGroup()
+		{
+			close();
+		}
+
+		PerfCounterGroup(const PerfCounterGroup&) = delete;
+
+		PerfCounterGroup& operator=(const PerfCounterGroup&) = delete;
+
+		//
+		//	false when perf_event_open is not permitted (see /proc/sys/kernel/perf_event_paranoid)
+		//
+		bool available() const
+		{
+			return m_fds[0] != -1;
+		}
+
+		bool available(PerfEvent event) const
+		{
+			return m_fds[static_cast<size_t>(event)] != -1;
+		}
+
+		bool usesRDPMC() const
+		{
+			return m_rdpmc;
+		}
+
+		PerfCounterSample read() const
+		{
+			PerfCounterSample sample;
+
+			if (!available())
+			{
+				return sample;
+			}
+
+			if (m_rdpmc && readUserSpace(sample))
+			{
+				return sample;
+			}
+
+			readSyscall(sample);
+
+			return sample;
+		}
+
+	private:
+
+		static const size_t EventCount = static_cast<size_t>(PerfEvent::Count);
+
+		int m_fds[EventCount];
+
+#if defined(__linux__)
+
+		perf_event_mmap_page* m_pages[EventCount];
+
+#else
+
+		void* m_pages[EventCount];
+
+#endif
+
+		// index into the group read buffer, or -1 when the event could not be opened
+		int m_groupIndex[EventCount];
+
+		bool m_rdpmc = false;
+
+#if defined(__linux__)
+
+		static void Configure(PerfEvent event, perf_event_attr& attr)
+		{
+			attr.type = PERF_TYPE_HARDWARE;
+
+			switch (event)
+			{
+			case PerfEvent::Cycles:
+				attr.config = PERF_COUNT_HW_CPU_CYCLES;
+				break;
+			case PerfEvent::Instructions:
+				attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+				break;
+			case PerfEvent::L1DMisses:
+				attr.type = PERF_TYPE_HW_CACHE;
+				attr.config = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+				break;
+			case PerfEvent::LLCMisses:
+				attr.config = PERF_COUNT_HW_CACHE_MISSES;
+				break;
+			case PerfEvent::BranchMisses:
+				attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+				break;
+			default:
+				break;
+			}
+		}
+
+		void open()
+		{
+			int groupSize = 0;
+
+			for (size_t i = 0; i < EventCount; ++i)
+			{
+				m_groupIndex[i] = -1;
+
+				perf_event_attr attr;
+
+				std::memset(&attr, 0, sizeof(attr));
+
+				attr.size = sizeof(attr);
+				attr.disabled = (i == 0);
+				attr.exclude_kernel = 1;
+				attr.exclude_hv = 1;
+				attr.read_format = PERF_FORMAT_GROUP;
+
+				Configure(static_cast<PerfEvent>(i), attr);
+
+				const int fd = static_cast<int>(::syscall(SYS_perf_event_open, &attr, 0, -1, i == 0 ? -1 : m_fds[0], 0));
+
+				if (fd == -1)
+				{
+					if (i == 0)
+					{
+						return;
+					}
+
+					continue;
+				}
+
+				m_fds[i] = fd;
+
+				m_groupIndex[i] = groupSize++;
+
+				void* page = ::mmap(nullptr, ::sysconf(_SC_PAGESIZE), PROT_READ, MAP_SHARED, fd, 0);
+
+				if (page != MAP_FAILED)
+				{
+					m_pages[i] = static_cast<perf_event_mmap_page*>(page);
+				}
+			}
+
+			::ioctl(m_fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+
+			::ioctl(m_fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+
+#if defined(__x86_64__) || defined(__i386__)
+
+			m_rdpmc = true;
+
+			for (size_t i = 0; i < EventCount; ++i)
+			{
+				if (m_fds[i] != -1 && (!m_pages[i] || !m_pages[i]->cap_user_rdpmc))
+				{
+					m_rdpmc = false;
+				}
+			}
+
+#endif
+		}
+
+		void close()
+		{
+			for (size_t i = 0; i < EventCount; ++i)
+			{
+				if (m_pages[i])
+				{
+					::munmap(m_pages[i], ::sysconf(_SC_PAGESIZE));
+				}
+
+				if (m_fds[i] != -1)
+				{
+					::close(m_fds[i]);
+				}
+			}
+		}
+
+		//
+		//	Lock-free read of the mmap page (see perf_event_mmap_page in linux/perf_event.h)
+		//
+		bool readUserSpace(PerfCounterSample& sample) const
+		{
+#if defined(__x86_64__) || defined(__i386__)
+
+			for (size_t i = 0; i < EventCount; ++i)
+			{
+				const volatile perf_event_mmap_page* page = m_pages[i];
+
+				if (!page)
+				{
+					continue;
+				}
+
+				unsigned seq;
+
+				unsigned long long count;
+
+				do
+				{
+					seq = page->lock;
+
+					asm volatile("" : : : "memory");
+
+					const unsigned index = page->index;
+
+					if (index == 0)
+					{
+						// not currently scheduled on a hardware counter
+						return false;
+					}
+
+					count = page->offset;
+
+					unsigned long long pmc = __builtin_ia32_rdpmc(index - 1);
+
+					const unsigned width = page->pmc_width;
+
+					pmc <<= 64 - width;
+
+					count += static_cast<unsigned long long>(static_cast<long long>(pmc) >> (64 - width));
+
+					asm volatile("" : : : "memory");
+				}
+				while (page->lock != seq);
+
+				sample.values[i] = count;
+			}
+
+			return true;
+
+#else
+
+			(void)sample;
+
+			return false;
+
+#endif
+		}
+
+		void readSyscall(PerfCounterSample& sample) const
+		{
+			unsigned long long buffer[1 + EventCount] = {};
+
+			if (::read(m_fds[0], buffer, sizeof(buffer)) <= 0)
+			{
+				return;
+			}
+
+			for (size_t i = 0; i < EventCount; ++i)
+			{
+				if (m_groupIndex[i] != -1 && static_cast<unsigned long long>(m_groupIndex[i]) < buffer[0])
+				{
+					sample.values[i] = buffer[1 + m_groupIndex[i]];
+				}
+			}
+		}
+
+#else
+
+		void open() {}
+
+		void close() {}
+
+		bool readUserSpace(PerfCounterSample&) const
+		{
+			return false;
+		}
+
+		void readSyscall(PerfCounterSample&) const {}
+
+#endif
+	};
+
+	//
+	//	Opened on first use by each thread
+	//
+	inline const PerfCounterGroup& GetThreadPerfCounters()
+	{
+		static thread_local PerfCounterGroup group;
+
+		return group;
+	}
+
+	//
+	//	Derived figures for one measured interval
+	//
+	struct PerfCounterReport
+	{
+		unsigned long long nanosec = 0;
+
+		PerfCounterSample counters;
+
+		double ipc() const
+		{
+			return counters[PerfEvent::Cycles] ? static_cast<double>(counters[PerfEvent::Instructions]) / counters[PerfEvent::Cycles] : 0.0;
+		}
+
+		// misses per thousand instructions
+		double missesPerKiloInstruction(PerfEvent event) const
+		{
+			return counters[PerfEvent::Instructions] ? 1000.0 * counters[event] / counters[PerfEvent::Instructions] : 0.0;
+		}
+
+		PerfCounterReport& operator +=(const PerfCounterReport& another)
+		{
+			nanosec += another.nanosec;
+
+			counters += another.counters;
+
+			return *this;
+		}
+	};
+
+	struct PerfCounterClock
+	{
+		unsigned long long startNanosec = GetNanosec();
+
+		PerfCounterSample start = GetThreadPerfCounters().read();
+
+		Property_Get(PerfCounterReport, elapsed) const
+		{
+			PerfCounterReport report;
+
+			report.counters = GetThreadPerfCounters().read() - start;
+
+			report.nanosec = GetNanosec() - startNanosec;
+
+			return report;
+		}
+	};
+
+	//
+	//	Accumulates the counters of a scope into a report
+	//
+	class ScopedPerfCounters
+	{
+	public:
+
+		explicit ScopedPerfCounters(PerfCounterReport& report)
+			: m_report(report) {}
+
+		~ScopedPerfCounters()
+		{
+#if SIV_HAS_PROPERTY
+			m_report += m_clock.elapsed;
+#else
+			m_report += m_clock.elapsed();
+#endif
+		}
+
+		ScopedPerfCounters(const ScopedPerfCounters&) = delete;
+
+		ScopedPerfCounters& operator=(const ScopedPerfCounters&) = delete;
+
+	private:
+
+		PerfCounterReport& m_report;
+
+		PerfCounterClock m_clock;
+	};
+
+	inline std::ostream& operator <<(std::ostream& os, const PerfCounterReport& report)
+	{
+		return os << report.nanosec / 1000ULL << "us"
+			<< "  cycles: " << report.counters[PerfEvent::Cycles]
+			<< "  instructions: " << report.counters[PerfEvent::Instructions]
+			<< "  IPC: " << report.ipc()
+			<< "  L1D MPKI: " << report.missesPerKiloInstruction(PerfEvent::L1DMisses)
+			<< "  LLC MPKI: " << report.missesPerKiloInstruction(PerfEvent::LLCMisses)
+			<< "  branch MPKI: " << report.missesPerKiloInstruction(PerfEvent::BranchMisses);
+	}
+}
@@ -0,0 +1,891 @@
+﻿//------------------------------------------
+//	ProfileZone.hpp
+//	Copyright (c) 2014 Reputeless
+//	<reputeless@gmail.com>
+//	Distributed under the MIT license.
+//------------------------------------------
+
+# pragma once
+# include <cstring>
+# include <atomic>
+# include <memory>
+# include <vector>
+# include <mutex>
+# include <thread>
+# include <chrono>
+# include <condition_variable>
+# include <algorithm>
+# include <ostream>
+# include "Profiler.hpp"
+
+# ifndef SIV_ZONE_BUFFER_CAPACITY
+#	define SIV_ZONE_BUFFER_CAPACITY 8192
+# endif
+
+# ifndef SIV_ZONE_STACK_CAPACITY
+#	define SIV_ZONE_STACK_CAPACITY 32
+# endif
+
+# define SIV_PROFILE_ZONE_CAT_IMPL(a, b) a##b
+# define SIV_PROFILE_ZONE_CAT(a, b) SIV_PROFILE_ZONE_CAT_IMPL(a, b)
+
+# ifdef SIV_DISABLE_PROFILE_ZONE
+#	define SIV_PROFILE_ZONE(name) ((void)0)
+# else
+#	define SIV_PROFILE_ZONE(name) const siv::ProfileZone SIV_PROFILE_ZONE_CAT(sivProfileZone_, __LINE__)(name)
+# endif
+
+# ifdef SIV_DISABLE_PROFILE_ZONE
+#	define SIV_PROFILE_ZONE_CPU(name) ((void)0)
+# else
+#	define SIV_PROFILE_ZONE_CPU(name) const siv::CpuProfileZone SIV_PROFILE_ZONE_CAT(sivCpuProfileZone_, __LINE__)(name)
+# endif
+
+namespace siv
+{
+	//
+	//	One completed zone: written by the owning thread when the scope closes
+	//
+	struct ZoneRecord
+	{
+		const char* name;
+
+		unsigned long long begin;
+
+		unsigned long long end;
+
+		unsigned depth;
+	};
+
+	//
+	//	Receives drained records on the collector thread
+	//
+	class ZoneSink
+	{
+	public:
+
+		virtual ~ZoneSink() {}
+
+		virtual void onZoneRecords(unsigned threadIndex, const ZoneRecord* records, size_t count) = 0;
+	};
+
+	//
+	//	Single-producer / single-consumer ring owned by one thread
+	//
+	class ZoneBuffer
+	{
+	public:
+
+		static const size_t Capacity = SIV_ZONE_BUFFER_CAPACITY;
+
+		static_assert((Capacity & (Capacity - 1)) == 0, "SIV_ZONE_BUFFER_CAPACITY must be a power of two");
+
+		// open zones visible to other threads; deeper zones are tracked but not named
+		static const unsigned StackCapacity = SIV_ZONE_STACK_CAPACITY;
+
+		explicit ZoneBuffer(unsigned threadIndex)
+			: m_threadIndex(threadIndex) {}
+
+		ZoneBuffer(const ZoneBuffer&) = delete;
+
+		ZoneBuffer& operator=(const ZoneBuffer&) = delete;
+
+		//
+		//	Returns the depth of the new zone; parent receives the zone it nests in
+		//
+		unsigned enter(const char* name, const char*& parent)
+		{
+			parent = m_currentZone;
+
+			m_currentZone = name;
+
+			// only the owning thread writes: plain loads and stores, no read-modify-write
+			const unsigned depth = m_depth.load(std::memory_order_relaxed);
+
+			if (depth < StackCapacity)
+			{
+				m_stack[depth].store(name, std::memory_order_relaxed);
+			}
+
+			m_depth.store(depth + 1, std::memory_order_release);
+
+			return depth;
+		}
+
+		void leave(const char* parent)
+		{
+			m_currentZone = parent;
+
+			m_depth.store(m_depth.load(std::memory_order_relaxed) - 1, std::memory_order_release);
+		}
+
+		//
+		//	Innermost open zone of the owning thread, or nullptr
+		//
+		const char* currentZone() const
+		{
+			return m_currentZone;
+		}
+
+		// number of open zones of the owning thread
+		unsigned depth() const
+		{
+			return m_depth.load(std::memory_order_relaxed);
+		}
+
+		//
+		//	Snapshot of the open zones, outermost first; safe from any thread while the owner runs.
+		//	Returns the number of names written, at most min(maxCount, StackCapacity).
+		//
+		unsigned openZones(const char** names, unsigned maxCount) const
+		{
+			const unsigned capacity = StackCapacity;
+
+			const unsigned count = std::min(std::min(m_depth.load(std::memory_order_acquire), capacity), maxCount);
+
+			for (unsigned i = 0; i < count; ++i)
+			{
+				names[i] = m_stack[i].load(std::memory_order_relaxed);
+			}
+
+			return count;
+		}
+
+		//
+		//	Copies up to maxCount of the most recently completed zones, oldest first, from any thread.
+		//	Drained records stay readable until overwritten; returns 0 if the owner overwrote the copied range meanwhile.
+		//
+		size_t recentRecords(ZoneRecord* records, size_t maxCount) const
+		{
+			const size_t head = m_head.load(std::memory_order_acquire);
+
+			const size_t count = std::min(std::min(head, maxCount), Capacity / 2);
+
+			for (size_t i = 0; i < count; ++i)
+			{
+				records[i] = m_records[(head - count + i) & (Capacity - 1)];
+			}
+
+			std::atomic_thread_fence(std::memory_order_acquire);
+
+			// the owner writes slot (newHead & mask), which aliases index newHead - Capacity
+			if (m_head.load(std::memory_order_relaxed) + count >= head + Capacity)
+			{
+				return 0;
+			}
+
+			return count;
+		}
+
+		void push(const ZoneRecord& record)
+		{
+			const size_t head = m_head.load(std::memory_order_relaxed);
+
+			if (head - m_cachedTail >= Capacity)
+			{
+				m_cachedTail = m_tail.load(std::memory_order_acquire);
+
+				if (head - m_cachedTail >= Capacity)
+				{
+					// never block the instrumented thread: count the loss instead
+					m_dropped.store(m_dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+					return;
+				}
+			}
+
+			m_records[head & (Capacity - 1)] = record;
+
+			m_head.store(head + 1, std::memory_order_release);
+		}
+
+		//
+		//	Collector side
+		//
+		bool drain(ZoneSink** sinks, size_t sinkCount)
+		{
+			const size_t tail = m_tail.load(std::memory_order_relaxed);
+			const size_t head = m_head.load(std::memory_order_acquire);
+
+			if (head == tail)
+			{
+				return false;
+			}
+
+			const size_t first = tail & (Capacity - 1);
+			const size_t count = head - tail;
+			const size_t firstCount = std::min(count, Capacity - first);
+
+			for (size_t i = 0; i < sinkCount; ++i)
+			{
+				sinks[i]->onZoneRecords(m_threadIndex, m_records + first, firstCount);
+
+				if (firstCount < count)
+				{
+					sinks[i]->onZoneRecords(m_threadIndex, m_records, count - firstCount);
+				}
+			}
+
+			m_tail.store(head, std::memory_order_release);
+
+			return true;
+		}
+
+		unsigned threadIndex() const
+		{
+			return m_threadIndex;
+		}
+
+		unsigned long long dropped() const
+		{
+			return m_dropped.load(std::memory_order_relaxed);
+		}
+
+		bool retired() const
+		{
+			return m_retired.load(std::memory_order_acquire);
+		}
+
+		void retire()
+		{
+			m_retired.store(true, std::memory_order_release);
+		}
+
+	private:
+
+		alignas(64) std::atomic<size_t> m_head{ 0 };
+
+		size_t m_cachedTail = 0;
+
+		std::atomic<unsigned> m_depth{ 0 };
+
+		const char* m_currentZone = nullptr;
+
+		std::atomic<const char*> m_stack[StackCapacity];
+
+		const unsigned m_threadIndex;
+
+		std::atomic<unsigned long long> m_dropped{ 0 };
+
+		alignas(64) std::atomic<size_t> m_tail{ 0 };
+
+		std::atomic<bool> m_retired{ false };
+
+		alignas(64) ZoneRecord m_records[Capacity];
+	};
+
+	//
+	//	Aggregated call tree node
+	//
+	struct ZoneNode
+	{
+		const char* name = nullptr;
+
+		unsigned long long calls = 0;
+
+		unsigned long long totalTicks = 0;
+
+		std::vector<ZoneNode> children;
+
+		unsigned long long selfTicks() const
+		{
+			unsigned long long childTicks = 0;
+
+			for (const auto& child : children)
+			{
+				childTicks += child.totalTicks;
+			}
+
+			return childTicks < totalTicks ? totalTicks - childTicks : 0;
+		}
+
+		ZoneNode& child(const char* childName)
+		{
+			for (auto& c : children)
+			{
+				if (c.name == childName || std::strcmp(c.name, childName) == 0)
+				{
+					return c;
+				}
+			}
+
+			children.emplace_back();
+
+			children.back().name = childName;
+
+			return children.back();
+		}
+
+		void merge(const ZoneNode& another)
+		{
+			calls += another.calls;
+
+			totalTicks += another.totalTicks;
+
+			for (const auto& c : another.children)
+			{
+				child(c.name).merge(c);
+			}
+		}
+	};
+
+	struct ZoneCallTree
+	{
+		unsigned threadIndex = 0;
+
+		ZoneNode root;
+
+		unsigned long long dropped = 0;
+	};
+
+	//
+	//	Reassembles one thread's zone subtrees from records that arrive in end order
+	//
+	class ZoneTreeAssembler
+	{
+	public:
+
+		//
+		//	onRoot(ZoneNode&&) is called for every completed top-level zone
+		//
+		template <class Callback>
+		void add(const ZoneRecord& r, Callback&& onRoot)
+		{
+			Pending current;
+			current.depth = r.depth;
+			current.begin = r.begin;
+			current.node.name = r.name;
+			current.node.calls = 1;
+			current.node.totalTicks = detail::SubtractOverhead<RDTSCClock>(r.end - r.begin);
+
+			// zones deeper than this one closed before it: they are its children
+			while (!m_pending.empty() && m_pending.back().depth > r.depth)
+			{
+				Pending& p = m_pending.back();
+
+				if (p.begin >= r.begin)
+				{
+					current.node.child(p.node.name).merge(p.node);
+				}
+				else
+				{
+					// parent record was dropped
+					onRoot(std::move(p.node));
+				}
+
+				m_pending.pop_back();
+			}
+
+			if (r.depth == 0)
+			{
+				onRoot(std::move(current.node));
+			}
+			else
+			{
+				m_pending.push_back(std::move(current));
+			}
+		}
+
+	private:
+
+		struct Pending
+		{
+			unsigned depth;
+
+			unsigned long long begin;
+
+			ZoneNode node;
+		};
+
+		std::vector<Pending> m_pending;
+	};
+
+	//
+	//	Aggregates every thread's records into a call tree
+	//
+	class ZoneCallTreeBuilder : public ZoneSink
+	{
+	public:
+
+		void onZoneRecords(unsigned threadIndex, const ZoneRecord* records, size_t count) override
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			ThreadState& state = getState(threadIndex);
+
+			ZoneNode& root = state.tree.root;
+
+			for (size_t i = 0; i < count; ++i)
+			{
+				state.assembler.add(records[i], [&root](ZoneNode&& node)
+				{
+					root.child(node.name).merge(node);
+				});
+			}
+		}
+
+		std::vector<ZoneCallTree> getCallTrees() const
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			std::vector<ZoneCallTree> trees;
+
+			for (const auto& state : m_states)
+			{
+				trees.push_back(state.tree);
+			}
+
+			return trees;
+		}
+
+		void setDropped(unsigned threadIndex, unsigned long long dropped)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			getState(threadIndex).tree.dropped = dropped;
+		}
+
+		void clear()
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			m_states.clear();
+		}
+
+	private:
+
+		struct ThreadState
+		{
+			ZoneCallTree tree;
+
+			ZoneTreeAssembler assembler;
+		};
+
+		mutable std::mutex m_mutex;
+
+		std::vector<ThreadState> m_states;
+
+		ThreadState& getState(unsigned threadIndex)
+		{
+			for (auto& state : m_states)
+			{
+				if (state.tree.threadIndex == threadIndex)
+				{
+					return state;
+				}
+			}
+
+			m_states.emplace_back();
+
+			m_states.back().tree.threadIndex = threadIndex;
+
+			return m_states.back();
+		}
+	};
+
+	//
+	//	Owns every thread's ZoneBuffer and drains them, optionally from a background thread
+	//
+	class ZoneCollector
+	{
+	public:
+
+		ZoneCollector()
+		{
+			m_sinks.push_back(&m_callTrees);
+		}
+
+		~ZoneCollector()
+		{
+			stop();
+		}
+
+		ZoneCollector(const ZoneCollector&) = delete;
+
+		ZoneCollector& operator=(const ZoneCollector&) = delete;
+
+		std::shared_ptr<ZoneBuffer> registerThread()
+		{
+			std::lock_guard<std::mutex> lock(m_registryMutex);
+
+			auto buffer = std::make_shared<ZoneBuffer>(m_nextThreadIndex++);
+
+			m_buffers.push_back(buffer);
+
+			return buffer;
+		}
+
+		void addSink(ZoneSink* sink)
+		{
+			std::lock_guard<std::mutex> lock(m_collectMutex);
+
+			m_sinks.push_back(sink);
+		}
+
+		void removeSink(ZoneSink* sink)
+		{
+			std::lock_guard<std::mutex> lock(m_collectMutex);
+
+			m_sinks.erase(std::remove(m_sinks.begin(), m_sinks.end(), sink), m_sinks.end());
+		}
+
+		//
+		//	Drains every buffer once
+		//
+		void collect()
+		{
+			std::lock_guard<std::mutex> lock(m_collectMutex);
+
+			std::vector<std::shared_ptr<ZoneBuffer>> buffers;
+
+			{
+				std::lock_guard<std::mutex> registryLock(m_registryMutex);
+
+				buffers = m_buffers;
+			}
+
+			for (const auto& buffer : buffers)
+			{
+				// check before draining so that records pushed just before retirement are not lost
+				const bool retired = buffer->retired();
+
+				buffer->drain(m_sinks.data(), m_sinks.size());
+
+				m_callTrees.setDropped(buffer->threadIndex(), buffer->dropped());
+
+				if (retired)
+				{
+					std::lock_guard<std::mutex> registryLock(m_registryMutex);
+
+					m_buffers.erase(std::remove(m_buffers.begin(), m_buffers.end(), buffer), m_buffers.end());
+				}
+			}
+		}
+
+		void start(std::chrono::milliseconds interval = std::chrono::milliseconds(10))
+		{
+			stop();
+
+			m_running = true;
+
+			m_thread = std::thread([this, interval]()
+			{
+				std::unique_lock<std::mutex> lock(m_threadMutex);
+
+				while (m_running)
+				{
+					m_condition.wait_for(lock, interval);
+
+					lock.unlock();
+
+					collect();
+
+					lock.lock();
+				}
+			});
+		}
+
+		void stop()
+		{
+			if (!m_thread.joinable())
+			{
+				return;
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(m_threadMutex);
+
+				m_running = false;
+			}
+
+			m_condition.notify_all();
+
+			m_thread.join();
+
+			collect();
+		}
+
+		std::vector<ZoneCallTree> getCallTrees() const
+		{
+			return m_callTrees.getCallTrees();
+		}
+
+		void clear()
+		{
+			m_callTrees.clear();
+		}
+
+	private:
+
+		std::mutex m_registryMutex;
+
+		std::vector<std::shared_ptr<ZoneBuffer>> m_buffers;
+
+		unsigned m_nextThreadIndex = 0;
+
+		std::mutex m_collectMutex;
+
+		std::vector<ZoneSink*> m_sinks;
+
+		ZoneCallTreeBuilder m_callTrees;
+
+		std::mutex m_threadMutex;
+
+		std::condition_variable m_condition;
+
+		bool m_running = false;
+
+		std::thread m_thread;
+	};
+
+	inline ZoneCollector& GetZoneCollector()
+	{
+		static ZoneCollector collector;
+
+		return collector;
+	}
+
+	namespace detail
+	{
+		inline ZoneBuffer*& ThreadZoneBufferPtr()
+		{
+			static thread_local ZoneBuffer* buffer = nullptr;
+
+			return buffer;
+		}
+
+		struct ThreadZoneBufferOwner
+		{
+			std::shared_ptr<ZoneBuffer> buffer;
+
+			~ThreadZoneBufferOwner()
+			{
+				if (buffer)
+				{
+					ThreadZoneBufferPtr() = nullptr;
+
+					buffer->retire();
+				}
+			}
+		};
+
+#if defined(_MSC_VER)
+		__declspec(noinline)
+#else
+		__attribute__((noinline))
+#endif
+		inline ZoneBuffer& RegisterThreadZoneBuffer()
+		{
+			static thread_local ThreadZoneBufferOwner owner;
+
+			owner.buffer = GetZoneCollector().registerThread();
+
+			ThreadZoneBufferPtr() = owner.buffer.get();
+
+			return *owner.buffer;
+		}
+	}
+
+	inline ZoneBuffer& GetThreadZoneBuffer()
+	{
+		if (ZoneBuffer* buffer = detail::ThreadZoneBufferPtr())
+		{
+			return *buffer;
+		}
+
+		return detail::RegisterThreadZoneBuffer();
+	}
+
+	//
+	//	RAII zone; use SIV_PROFILE_ZONE("name") with a string literal.
+	//	Enter/leave bookkeeping is a few relaxed stores; the cost of a zone is dominated by its two TSC reads,
+	//	which are much slower under some hypervisors (ProfileZoneTest prints both figures).
+	//
+	class ProfileZone
+	{
+	public:
+
+		explicit ProfileZone(const char* name)
+			: m_buffer(GetThreadZoneBuffer())
+			, m_name(name)
+			, m_depth(m_buffer.enter(name, m_parent))
+			, m_begin(detail::ReadTSC()) {}
+
+		~ProfileZone()
+		{
+			const unsigned long long end = detail::ReadTSC();
+
+			m_buffer.leave(m_parent);
+
+			m_buffer.push(ZoneRecord{ m_name, m_begin, end, m_depth });
+		}
+
+		ProfileZone(const ProfileZone&) = delete;
+
+		ProfileZone& operator=(const ProfileZone&) = delete;
+
+	private:
+
+		ZoneBuffer& m_buffer;
+
+		const char* m_name;
+
+		const char* m_parent;
+
+		unsigned m_depth;
+
+		unsigned long long m_begin;
+	};
+
+	//
+	//	On-CPU time, off-CPU time and context switches of a zone name, summed over all threads
+	//
+	struct ZoneCpuTotal
+	{
+		const char* name;
+
+		unsigned long long calls;
+
+		ThreadCpuTime time;
+	};
+
+	class ZoneCpuAccounting
+	{
+	public:
+
+		void add(const char* name, const ThreadCpuTime& time)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			// the same literal may have different addresses in different translation units
+			auto it = std::find_if(m_totals.begin(), m_totals.end(), [name](const ZoneCpuTotal& total)
+			{
+				return total.name == name || std::strcmp(total.name, name) == 0;
+			});
+
+			if (it == m_totals.end())
+			{
+				m_totals.push_back(ZoneCpuTotal{ name, 1, time });
+			}
+			else
+			{
+				++it->calls;
+
+				it->time += time;
+			}
+		}
+
+		//
+		//	In first-seen order
+		//
+		std::vector<ZoneCpuTotal> getTotals() const
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			return m_totals;
+		}
+
+		void clear()
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			m_totals.clear();
+		}
+
+	private:
+
+		mutable std::mutex m_mutex;
+
+		std::vector<ZoneCpuTotal> m_totals;
+	};
+
+	inline ZoneCpuAccounting& GetZoneCpuAccounting()
+	{
+		static ZoneCpuAccounting accounting;
+
+		return accounting;
+	}
+
+	//
+	//	ProfileZone that also adds its thread's CPU accounting to GetZoneCpuAccounting().
+	//	Opt-in with SIV_PROFILE_ZONE_CPU("name"): the two CPU clock and context switch reads are system calls
+	//	and the totals are updated under a lock, so keep it to zones of a few microseconds or more.
+	//
+	class CpuProfileZone
+	{
+	public:
+
+		explicit CpuProfileZone(const char* name)
+			: m_zone(name)
+			, m_name(name) {}
+
+		~CpuProfileZone()
+		{
+#if SIV_HAS_PROPERTY
+			GetZoneCpuAccounting().add(m_name, m_clock.elapsed);
+#else
+			GetZoneCpuAccounting().add(m_name, m_clock.elapsed());
+#endif
+		}
+
+		CpuProfileZone(const CpuProfileZone&) = delete;
+
+		CpuProfileZone& operator=(const CpuProfileZone&) = delete;
+
+	private:
+
+		ProfileZone m_zone;
+
+		const char* m_name;
+
+		ThreadCpuClock m_clock;
+	};
+
+	//
+	//	Indented text report: calls, total and self time in microseconds
+	//
+	inline void WriteZoneNode(std::ostream& os, const ZoneNode& node, unsigned indent)
+	{
+		os << std::string(indent * 2, ' ') << node.name
+			<< "  calls: " << node.calls
+			<< "  total: " << TSCToNanosec(node.totalTicks) / 1000ULL << "us"
+			<< "  self: " << TSCToNanosec(node.selfTicks()) / 1000ULL << "us\n";
+
+		for (const auto& child : node.children)
+		{
+			WriteZoneNode(os, child, indent + 1);
+		}
+	}
+
+	inline void WriteCallTree(std::ostream& os, const ZoneCallTree& tree)
+	{
+		os << "thread " << tree.threadIndex;
+
+		if (tree.dropped)
+		{
+			os << " (" << tree.dropped << " zones dropped)";
+		}
+
+		os << '\n';
+
+		for (const auto& child : tree.root.children)
+		{
+			WriteZoneNode(os, child, 1);
+		}
+	}
+
+	//
+	//	One line per zone name: calls, on-CPU and off-CPU time in microseconds, context switches
+	//
+	inline void WriteZoneCpuReport(std::ostream& os, const std::vector<ZoneCpuTotal>& totals)
+	{
+		for (const auto& total : totals)
+		{
+			os << total.name
+				<< "  calls: " << total.calls
+				<< "  cpu: " << total.time.cpuNanosec / 1000ULL << "us"
+				<< "  off-cpu: " << total.time.offCpuNanosec() / 1000ULL << "us"
+				<< "  switches: " << total.time.voluntarySwitches << " voluntary, " << total.time.involuntarySwitches << " involuntary\n";
+		}
+	}
+}
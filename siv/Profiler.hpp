@@ -6,62 +6,1103 @@
 //------------------------------------------
 
 # pragma once
-# define  NOMINMAX
-# define  STRICT
-# define  WIN32_LEAN_AND_MEAN
-# include <Windows.h>
+# include <algorithm>
+# include <vector>
+# include <atomic>
+# include <mutex>
+# include <condition_variable>
+# include <thread>
+
+# if defined(_WIN32)
+#	define  NOMINMAX
+#	define  STRICT
+#	define  WIN32_LEAN_AND_MEAN
+#	include <Windows.h>
+#	include <intrin.h>
+# else
+#	include <time.h>
+#	if defined(__x86_64__) || defined(__i386__)
+#		include <x86intrin.h>
+#		include <cpuid.h>
+#	endif
+# endif
+
+# if defined(__linux__)
+#	include <sched.h>
+#	include <pthread.h>
+#	include <sys/resource.h>
+# endif
+
 # include "PropertyMacro.hpp"
 
+# if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__) || defined(__aarch64__)
+#	define SIV_HAS_TSC 1
+# else
+#	define SIV_HAS_TSC 0
+# endif
+
 namespace siv
 {
+	namespace detail
+	{
+		//
+		//	(value * multiplier) >> 32 without overflowing the intermediate product
+		//
+		inline unsigned long long MulShift32(unsigned long long value, unsigned long long multiplier)
+		{
+#if defined(__SIZEOF_INT128__)
+
+			return static_cast<unsigned long long>((static_cast<unsigned __int128>(value) * multiplier) >> 32);
+
+#elif defined(_MSC_VER) && defined(_M_X64)
+
+			unsigned long long high;
+
+			const unsigned long long low = ::_umul128(value, multiplier, &high);
+
+			return (high << 32) | (low >> 32);
+
+#else
+
+			const unsigned long long vl = value & 0xFFFFFFFFULL, vh = value >> 32;
+			const unsigned long long ml = multiplier & 0xFFFFFFFFULL, mh = multiplier >> 32;
+
+			return ((vh * mh) << 32) + vh * ml + vl * mh + ((vl * ml) >> 32);
+
+#endif
+		}
+
+		//
+		//	multiplier such that MulShift32(ticks, multiplier) converts ticks to units
+		//
+		inline unsigned long long MakeMultiplier(unsigned long long unitsPerSecond, unsigned long long ticksPerSecond)
+		{
+			return (unitsPerSecond << 32) / ticksPerSecond;
+		}
+
+		inline unsigned long long ReadTSC()
+		{
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+
+			return ::__rdtsc();
+
+#elif defined(__aarch64__)
+
+			unsigned long long counter;
+
+			asm volatile("mrs %0, cntvct_el0" : "=r"(counter));
+
+			return counter;
+
+#else
+
+			return 0;
+
+#endif
+		}
+
+		//
+		//	Serialized TSC read that also returns IA32_TSC_AUX (Linux stores node << 12 | cpu there).
+		//	rdtscp waits for earlier instructions; the trailing lfence keeps later ones from starting early.
+		//	Without rdtscp, lfence; rdtsc; lfence is used and core is ~0u.
+		//
+		inline unsigned long long ReadTSCP(unsigned& core, bool hasRDTSCP)
+		{
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+
+			unsigned long long counter;
+
+			if (hasRDTSCP)
+			{
+				counter = ::__rdtscp(&core);
+			}
+			else
+			{
+				::_mm_lfence();
+
+				counter = ::__rdtsc();
+
+				core = ~0u;
+			}
+
+			::_mm_lfence();
+
+			return counter;
+
+#elif defined(__aarch64__)
+
+			(void)hasRDTSCP;
+
+			unsigned long long counter;
+
+			asm volatile("isb; mrs %0, cntvct_el0; isb" : "=r"(counter) : : "memory");
+
+			core = ~0u;
+
+			return counter;
+
+#else
+
+			(void)hasRDTSCP;
+
+			core = ~0u;
+
+			return 0;
+
+#endif
+		}
+
+		inline bool CPUID(unsigned leaf, unsigned registers[4])
+		{
+#if defined(_MSC_VER)
+
+			int info[4];
+
+			::__cpuid(info, 0x80000000);
+
+			if (leaf >= 0x80000000 && static_cast<unsigned>(info[0]) < leaf)
+			{
+				return false;
+			}
+
+			::__cpuidex(info, leaf, 0);
+
+			for (int i = 0; i < 4; ++i)
+			{
+				registers[i] = static_cast<unsigned>(info[i]);
+			}
+
+			return true;
+
+#elif defined(__x86_64__) || defined(__i386__)
+
+			return __get_cpuid(leaf, &registers[0], &registers[1], &registers[2], &registers[3]) != 0;
+
+#else
+
+			(void)leaf;
+
+			(void)registers;
+
+			return false;
+
+#endif
+		}
+
+#if !defined(_WIN32)
+
+		inline unsigned long long ReadMonotonicNanosec()
+		{
+			timespec ts;
+
+			::clock_gettime(CLOCK_MONOTONIC, &ts);
+
+			return static_cast<unsigned long long>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+		}
+
+#endif
+	}
+
+# if defined(_WIN32)
+
 	struct CounterFrequency
 	{
 		LARGE_INTEGER frequency;
 
+		unsigned long long microsecMultiplier;
+
+		unsigned long long nanosecMultiplier;
+
 		CounterFrequency()
 		{
 			::QueryPerformanceFrequency(&frequency);
+
+			microsecMultiplier = detail::MakeMultiplier(1000000ULL, frequency.QuadPart);
+
+			nanosecMultiplier = detail::MakeMultiplier(1000000000ULL, frequency.QuadPart);
 		}
 	};
 
-	inline unsigned long long GetMicrosec()
+	inline const CounterFrequency& GetCounterFrequency()
 	{
 		const static CounterFrequency f;
 
+		return f;
+	}
+
+	inline unsigned long long GetMicrosec()
+	{
+		LARGE_INTEGER counter;
+
+		::QueryPerformanceCounter(&counter);
+
+		return detail::MulShift32(counter.QuadPart, GetCounterFrequency().microsecMultiplier);
+	}
+
+	inline unsigned long long GetNanosec()
+	{
 		LARGE_INTEGER counter;
 
 		::QueryPerformanceCounter(&counter);
 
-		return counter.QuadPart * 1000000ULL / f.frequency.QuadPart;
+		return detail::MulShift32(counter.QuadPart, GetCounterFrequency().nanosecMultiplier);
+	}
+
+# else
+
+	inline unsigned long long GetMicrosec()
+	{
+		return detail::ReadMonotonicNanosec() / 1000ULL;
+	}
+
+# endif
+
+	//
+	//	TSC frequency, calibrated once against the monotonic clock
+	//
+	struct TSCFrequency
+	{
+		unsigned long long frequency = 0;
+
+		unsigned long long nanosecMultiplier = 0;
+
+		TSCFrequency()
+		{
+#if defined(__aarch64__)
+
+			asm volatile("mrs %0, cntfrq_el0" : "=r"(frequency));
+
+#elif SIV_HAS_TSC
+
+			// 10ms is enough for a sub-ppm error at GHz tick rates
+			const unsigned long long calibrationNanosec = 10000000ULL;
+
+#if defined(_WIN32)
+
+			const unsigned long long ns0 = GetNanosec();
+			const unsigned long long t0 = detail::ReadTSC();
+			unsigned long long ns1;
+
+			while ((ns1 = GetNanosec()) - ns0 < calibrationNanosec) {}
+
+#else
+
+			const unsigned long long ns0 = detail::ReadMonotonicNanosec();
+			const unsigned long long t0 = detail::ReadTSC();
+			unsigned long long ns1;
+
+			while ((ns1 = detail::ReadMonotonicNanosec()) - ns0 < calibrationNanosec) {}
+
+#endif
+
+			const unsigned long long t1 = detail::ReadTSC();
+
+			frequency = (t1 - t0) * 1000000000ULL / (ns1 - ns0);
+
+#endif
+
+			if (frequency)
+			{
+				nanosecMultiplier = detail::MakeMultiplier(1000000000ULL, frequency);
+			}
+		}
+	};
+
+	inline const TSCFrequency& GetTSCFrequency()
+	{
+		const static TSCFrequency f;
+
+		return f;
+	}
+
+	inline unsigned long long TSCToNanosec(unsigned long long ticks)
+	{
+		return detail::MulShift32(ticks, GetTSCFrequency().nanosecMultiplier);
+	}
+
+# if !defined(_WIN32)
+
+	inline unsigned long long GetNanosec()
+	{
+#if SIV_HAS_TSC
+
+		return TSCToNanosec(detail::ReadTSC());
+
+#else
+
+		return detail::ReadMonotonicNanosec();
+
+#endif
+	}
+
+# endif
+
+	//
+	//	Cost of an empty scope (two consecutive Clock::Now() calls), in the units of Clock::Now()
+	//
+	struct ClockOverhead
+	{
+		unsigned long long min = 0;
+
+		unsigned long long median = 0;
+	};
+
+	template <class Clock>
+	inline ClockOverhead MeasureClockOverhead(size_t samples = 10001)
+	{
+		std::vector<unsigned long long> costs(std::max<size_t>(samples, 1));
+
+		for (int i = 0; i < 100; ++i)
+		{
+			Clock::Now();
+		}
+
+		for (auto& cost : costs)
+		{
+			const unsigned long long start = Clock::Now();
+
+			cost = Clock::Now() - start;
+		}
+
+		ClockOverhead overhead;
+
+		std::nth_element(costs.begin(), costs.begin() + costs.size() / 2, costs.end());
+
+		overhead.median = costs[costs.size() / 2];
+
+		overhead.min = *std::min_element(costs.begin(), costs.end());
+
+		return overhead;
+	}
+
+	//
+	//	Measured on first use; see CalibrateClockOverheads()
+	//
+	template <class Clock>
+	inline const ClockOverhead& GetClockOverhead()
+	{
+		const static ClockOverhead overhead = MeasureClockOverhead<Clock>();
+
+		return overhead;
+	}
+
+	namespace detail
+	{
+		inline std::atomic<bool>& ClockOverheadSubtraction()
+		{
+			static std::atomic<bool> enabled(false);
+
+			return enabled;
+		}
+
+		template <class Clock>
+		inline unsigned long long SubtractOverhead(unsigned long long elapsed)
+		{
+			if (!ClockOverheadSubtraction().load(std::memory_order_relaxed))
+			{
+				return elapsed;
+			}
+
+			const unsigned long long overhead = GetClockOverhead<Clock>().min;
+
+			return elapsed > overhead ? elapsed - overhead : 0;
+		}
+	}
+
+	//
+	//	When enabled, every clock's elapsed excludes the minimum cost of reading that clock
+	//
+	inline void SetClockOverheadSubtraction(bool enabled)
+	{
+		detail::ClockOverheadSubtraction().store(enabled);
+	}
+
+	inline bool IsClockOverheadSubtractionEnabled()
+	{
+		return detail::ClockOverheadSubtraction().load();
 	}
 
 	struct MillisecClock
 	{
-		unsigned long long start = GetMicrosec();
+		unsigned long long start = Now();
 
 		Property_Get(unsigned long long, elapsed) const
 		{
-			return (GetMicrosec() - start) / 1000ULL;
+			return detail::SubtractOverhead<MillisecClock>(Now() - start) / 1000ULL;
+		}
+
+		static unsigned long long Now()
+		{
+			return GetMicrosec();
 		}
 	};
 
 	struct MicrosecClock
 	{
-		unsigned long long start = GetMicrosec();
+		unsigned long long start = Now();
 
 		Property_Get(unsigned long long, elapsed) const
 		{
-			return GetMicrosec() - start;
+			return detail::SubtractOverhead<MicrosecClock>(Now() - start);
+		}
+
+		static unsigned long long Now()
+		{
+			return GetMicrosec();
+		}
+	};
+
+	struct NanosecClock
+	{
+		unsigned long long start = Now();
+
+		Property_Get(unsigned long long, elapsed) const
+		{
+			return detail::SubtractOverhead<NanosecClock>(Now() - start);
+		}
+
+		static unsigned long long Now()
+		{
+			return GetNanosec();
+		}
+	};
+
+	namespace detail
+	{
+		struct alignas(64) CoarseTime
+		{
+			// 0 while no ticker runs
+			std::atomic<unsigned long long> microsec;
+
+			char padding[64 - sizeof(std::atomic<unsigned long long>)];
+		};
+
+		//
+		//	A static member of a class template can be defined in a header and is constant-initialized,
+		//	so reading it needs no initialization guard
+		//
+		template <class Tag>
+		struct CoarseTimeHolder
+		{
+			static CoarseTime value;
+		};
+
+		template <class Tag>
+		CoarseTime CoarseTimeHolder<Tag>::value;
+
+		inline CoarseTime& GetCoarseTime()
+		{
+			return CoarseTimeHolder<void>::value;
+		}
+	}
+
+	//
+	//	Background thread publishing GetMicrosec() every tick for CoarseClock
+	//
+	class CoarseClockTicker
+	{
+	public:
+
+		CoarseClockTicker() = default;
+
+		CoarseClockTicker(const CoarseClockTicker&) = delete;
+
+		CoarseClockTicker& operator=(const CoarseClockTicker&) = delete;
+
+		~CoarseClockTicker()
+		{
+			stop();
+		}
+
+		void start(unsigned long long tickMicrosec)
+		{
+			stop();
+
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			m_tickMicrosec = tickMicrosec ? tickMicrosec : 1;
+
+			m_running = true;
+
+			// readers see a value as soon as start() returns
+			detail::GetCoarseTime().microsec.store(GetMicrosec(), std::memory_order_relaxed);
+
+			m_thread = std::thread([this]() { run(); });
+		}
+
+		void stop()
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+
+				if (!m_running)
+				{
+					return;
+				}
+
+				m_running = false;
+			}
+
+			m_condition.notify_one();
+
+			m_thread.join();
+
+			// readers fall back to the precise clock, which is never behind the last tick
+			detail::GetCoarseTime().microsec.store(0, std::memory_order_relaxed);
+		}
+
+		// 0 while stopped
+		unsigned long long tickMicrosec() const
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			return m_running ? m_tickMicrosec : 0;
+		}
+
+	private:
+
+		mutable std::mutex m_mutex;
+
+		std::condition_variable m_condition;
+
+		std::thread m_thread;
+
+		unsigned long long m_tickMicrosec = 0;
+
+		bool m_running = false;
+
+		void run()
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+
+			while (m_running)
+			{
+				detail::GetCoarseTime().microsec.store(GetMicrosec(), std::memory_order_relaxed);
+
+				m_condition.wait_for(lock, std::chrono::microseconds(m_tickMicrosec));
+			}
+		}
+	};
+
+	inline CoarseClockTicker& GetCoarseClockTicker()
+	{
+		static CoarseClockTicker ticker;
+
+		return ticker;
+	}
+
+	//
+	//	Starts (or restarts with a new tick) the thread behind CoarseClock
+	//
+	inline void StartCoarseClock(unsigned long long tickMicrosec = 1000)
+	{
+		GetCoarseClockTicker().start(tickMicrosec);
+	}
+
+	inline void StopCoarseClock()
+	{
+		GetCoarseClockTicker().stop();
+	}
+
+	//
+	//	Microseconds, as GetMicrosec(), at the cost of one relaxed load while the ticker runs.
+	//	The value lags real time by at most one tick plus the ticker's wakeup latency and never goes backwards.
+	//	Without a ticker it is GetMicrosec() itself.
+	//
+	inline unsigned long long GetCoarseMicrosec()
+	{
+		const unsigned long long microsec = detail::GetCoarseTime().microsec.load(std::memory_order_relaxed);
+
+		return microsec ? microsec : GetMicrosec();
+	}
+
+	//
+	//	Millisecond clock for timeouts and TTLs on hot paths; see GetCoarseMicrosec() for its precision
+	//
+	struct CoarseClock
+	{
+		unsigned long long start = Now();
+
+		Property_Get(unsigned long long, elapsed) const
+		{
+			return (Now() - start) / 1000ULL;
+		}
+
+		static unsigned long long Now()
+		{
+			return GetCoarseMicrosec();
 		}
 	};
 
 	struct RDTSCClock
 	{
-		unsigned long long start = ::__rdtsc();
+		unsigned long long start = Now();
+
+		Property_Get(unsigned long long, elapsed) const
+		{
+			return detail::SubtractOverhead<RDTSCClock>(Now() - start);
+		}
+
+		static unsigned long long Now()
+		{
+			return detail::ReadTSC();
+		}
+	};
+
+	//
+	//	TSC capabilities, detected once; synchronization is only measured by CheckTSCSynchronization()
+	//
+	struct TSCInfo
+	{
+		// ticks at a constant rate across P-/C-states (CPUID 80000007h EDX[8])
+		bool invariant = false;
+
+		// rdtscp is available (CPUID 80000001h EDX[27])
+		bool rdtscp = false;
+
+		// no core saw another core's TSC go backwards; assumed until CheckTSCSynchronization() has run
+		bool synchronized = true;
+
+		// largest backwards step observed between two cores, in ticks
+		unsigned long long maxWarp = 0;
+
+		unsigned checkedCores = 0;
+
+		TSCInfo()
+		{
+#if defined(__aarch64__)
+
+			// the generic timer is architecturally constant-rate and shared by all cores
+			invariant = true;
+
+#else
+
+			unsigned registers[4];
+
+			if (detail::CPUID(0x80000007, registers))
+			{
+				invariant = (registers[3] & (1u << 8)) != 0;
+			}
+
+			if (detail::CPUID(0x80000001, registers))
+			{
+				rdtscp = (registers[3] & (1u << 27)) != 0;
+			}
+
+#endif
+		}
+
+#if defined(__linux__)
+
+		void checkSynchronization()
+		{
+			cpu_set_t allowed;
+
+			if (::sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+			{
+				return;
+			}
+
+			int reference = -1;
+
+			// 64 cores are enough to catch a socket whose TSC was not synchronized
+			for (int cpu = 0; cpu < CPU_SETSIZE && checkedCores < 64; ++cpu)
+			{
+				if (!CPU_ISSET(cpu, &allowed))
+				{
+					continue;
+				}
+
+				if (reference == -1)
+				{
+					reference = cpu;
+
+					continue;
+				}
+
+				maxWarp = std::max(maxWarp, measureWarp(reference, cpu));
+
+				++checkedCores;
+			}
+
+			synchronized = (maxWarp == 0);
+		}
+
+	private:
+
+		static bool PinCurrentThread(unsigned cpu)
+		{
+			cpu_set_t set;
+
+			CPU_ZERO(&set);
+
+			CPU_SET(cpu, &set);
+
+			return ::pthread_setaffinity_np(::pthread_self(), sizeof(set), &set) == 0;
+		}
+
+		//
+		//	Two threads pinned to different cores hand a TSC reading back and forth;
+		//	a reading smaller than the one just handed over means the TSCs disagree.
+		//
+		unsigned long long measureWarp(unsigned cpuA, unsigned cpuB) const
+		{
+			const unsigned rounds = 2000;
+
+			std::atomic<unsigned long long> last(0);
+
+			std::atomic<unsigned> turn(0);
+
+			std::atomic<unsigned long long> warp(0);
+
+			std::atomic<bool> aborted(false);
+
+			const bool hasRDTSCP = rdtscp;
+
+			const auto run = [&](unsigned cpu, unsigned parity)
+			{
+				if (!PinCurrentThread(cpu))
+				{
+					aborted = true;
+
+					return;
+				}
+
+				unsigned long long maxWarp = 0;
+
+				for (unsigned i = parity; i < rounds * 2; i += 2)
+				{
+					while (turn.load(std::memory_order_acquire) != i)
+					{
+						if (aborted.load(std::memory_order_relaxed))
+						{
+							return;
+						}
+
+						// the other thread may share this core's time slice on a busy or quota-limited host
+						std::this_thread::yield();
+					}
+
+					unsigned core;
+
+					const unsigned long long now = detail::ReadTSCP(core, hasRDTSCP);
+
+					const unsigned long long previous = last.load(std::memory_order_relaxed);
+
+					if (now < previous)
+					{
+						maxWarp = std::max(maxWarp, previous - now);
+					}
+
+					last.store(now, std::memory_order_relaxed);
+
+					turn.store(i + 1, std::memory_order_release);
+				}
+
+				unsigned long long current = warp.load();
+
+				while (current < maxWarp && !warp.compare_exchange_weak(current, maxWarp)) {}
+			};
+
+			std::thread a(run, cpuA, 0u);
+
+			std::thread b(run, cpuB, 1u);
+
+			a.join();
+
+			b.join();
+
+			return warp.load();
+		}
+
+#else
+
+		void checkSynchronization() {}
+
+#endif
+	};
+
+	namespace detail
+	{
+		inline TSCInfo& MutableTSCInfo()
+		{
+			static TSCInfo info;
+
+			return info;
+		}
+	}
+
+	inline const TSCInfo& GetTSCInfo()
+	{
+		return detail::MutableTSCInfo();
+	}
+
+	//
+	//	Hands TSC readings between pinned thread pairs on up to 64 cores and records the result in GetTSCInfo().
+	//	Takes from milliseconds to seconds: call it once at startup, before other threads use RDTSCPClock.
+	//
+	inline const TSCInfo& CheckTSCSynchronization()
+	{
+		static std::once_flag once;
+
+		std::call_once(once, []()
+		{
+			detail::MutableTSCInfo().checkSynchronization();
+		});
+
+		return GetTSCInfo();
+	}
+
+	//
+	//	Ticks between two serialized readings and whether they can be trusted
+	//
+	struct TSCInterval
+	{
+		unsigned long long ticks = 0;
+
+		unsigned startCore = ~0u;
+
+		unsigned endCore = ~0u;
+
+		// the thread was observed on another core at the end
+		bool migrated = false;
+
+		// false if the TSC is not invariant, or if the thread migrated between cores whose TSCs disagree
+		bool reliable = true;
+	};
+
+	//
+	//	RDTSCClock fenced against out-of-order execution around the measured code
+	//
+	struct SerializedRDTSCClock
+	{
+		unsigned long long start = Now();
 
 		Property_Get(unsigned long long, elapsed) const
 		{
-			return ::__rdtsc() - start;
+			return detail::SubtractOverhead<SerializedRDTSCClock>(Now() - start);
+		}
+
+		static unsigned long long Now()
+		{
+			unsigned core;
+
+			return detail::ReadTSCP(core, GetTSCInfo().rdtscp);
+		}
+	};
+
+	//
+	//	Serialized clock that records the core of each reading (IA32_TSC_AUX)
+	//
+	struct RDTSCPClock
+	{
+		unsigned startCore;
+
+		unsigned long long start;
+
+		RDTSCPClock()
+			: start(detail::ReadTSCP(startCore, GetTSCInfo().rdtscp)) {}
+
+		Property_Get(TSCInterval, elapsed) const
+		{
+			const TSCInfo& info = GetTSCInfo();
+
+			TSCInterval interval;
+
+			const unsigned long long end = detail::ReadTSCP(interval.endCore, info.rdtscp);
+
+			interval.ticks = detail::SubtractOverhead<RDTSCPClock>(end - start);
+
+			interval.startCore = startCore;
+
+			interval.migrated = (interval.startCore != interval.endCore);
+
+			interval.reliable = info.invariant && (!interval.migrated || info.synchronized) && end >= start;
+
+			return interval;
+		}
+
+		static unsigned long long Now()
+		{
+			unsigned core;
+
+			return detail::ReadTSCP(core, GetTSCInfo().rdtscp);
 		}
 	};
+
+	//
+	//	Time a thread spent on and off the CPU over an interval, and why it left the CPU
+	//
+	struct ThreadCpuTime
+	{
+		unsigned long long wallNanosec = 0;
+
+		unsigned long long cpuNanosec = 0;
+
+		// the thread blocked (I/O, lock, sleep); Linux only
+		unsigned long long voluntarySwitches = 0;
+
+		// the thread was preempted; Linux only
+		unsigned long long involuntarySwitches = 0;
+
+		// waiting or descheduled
+		unsigned long long offCpuNanosec() const
+		{
+			return wallNanosec > cpuNanosec ? wallNanosec - cpuNanosec : 0;
+		}
+
+		ThreadCpuTime& operator +=(const ThreadCpuTime& another)
+		{
+			wallNanosec += another.wallNanosec;
+			cpuNanosec += another.cpuNanosec;
+			voluntarySwitches += another.voluntarySwitches;
+			involuntarySwitches += another.involuntarySwitches;
+
+			return *this;
+		}
+	};
+
+	namespace detail
+	{
+		//
+		//	CPU time of the calling thread. Windows accounts it at scheduler-tick granularity (about 15.6ms).
+		//
+		inline unsigned long long ReadThreadCpuNanosec()
+		{
+#if defined(_WIN32)
+
+			FILETIME creation, exit, kernel, user;
+
+			::GetThreadTimes(::GetCurrentThread(), &creation, &exit, &kernel, &user);
+
+			const unsigned long long k = (static_cast<unsigned long long>(kernel.dwHighDateTime) << 32) | kernel.dwLowDateTime;
+
+			const unsigned long long u = (static_cast<unsigned long long>(user.dwHighDateTime) << 32) | user.dwLowDateTime;
+
+			return (k + u) * 100ULL;
+
+#else
+
+			timespec ts;
+
+			::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+
+			return static_cast<unsigned long long>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+
+#endif
+		}
+
+		inline void ReadThreadContextSwitches(unsigned long long& voluntary, unsigned long long& involuntary)
+		{
+#if defined(__linux__)
+
+			rusage usage;
+
+			if (::getrusage(RUSAGE_THREAD, &usage) == 0)
+			{
+				voluntary = static_cast<unsigned long long>(usage.ru_nvcsw);
+
+				involuntary = static_cast<unsigned long long>(usage.ru_nivcsw);
+
+				return;
+			}
+
+#endif
+
+			voluntary = involuntary = 0;
+		}
+	}
+
+	//
+	//	On-CPU time of the calling thread, with wall time and context switches for comparison.
+	//	Must be read on the thread that created it.
+	//
+	struct ThreadCpuClock
+	{
+		unsigned long long start = Now();
+
+		unsigned long long startWall = GetNanosec();
+
+		unsigned long long startVoluntary;
+
+		unsigned long long startInvoluntary;
+
+		ThreadCpuClock()
+		{
+			detail::ReadThreadContextSwitches(startVoluntary, startInvoluntary);
+		}
+
+		Property_Get(ThreadCpuTime, elapsed) const
+		{
+			ThreadCpuTime time;
+
+			const unsigned long long cpu = Now() - start;
+
+			const unsigned long long wall = GetNanosec() - startWall;
+
+			// the same correction on both, so that it does not show up as off-CPU time
+			time.cpuNanosec = detail::SubtractOverhead<ThreadCpuClock>(cpu);
+
+			const unsigned long long overhead = cpu - time.cpuNanosec;
+
+			time.wallNanosec = wall > overhead ? wall - overhead : 0;
+
+			detail::ReadThreadContextSwitches(time.voluntarySwitches, time.involuntarySwitches);
+
+			time.voluntarySwitches -= startVoluntary;
+
+			time.involuntarySwitches -= startInvoluntary;
+
+			return time;
+		}
+
+		static unsigned long long Now()
+		{
+			return detail::ReadThreadCpuNanosec();
+		}
+	};
+
+	//
+	//	Accumulates the CPU accounting of a scope
+	//
+	class ScopedThreadCpuTime
+	{
+	public:
+
+		explicit ScopedThreadCpuTime(ThreadCpuTime& total)
+			: m_total(total) {}
+
+		~ScopedThreadCpuTime()
+		{
+#if SIV_HAS_PROPERTY
+			m_total += m_clock.elapsed;
+#else
+			m_total += m_clock.elapsed();
+#endif
+		}
+
+		ScopedThreadCpuTime(const ScopedThreadCpuTime&) = delete;
+
+		ScopedThreadCpuTime& operator=(const ScopedThreadCpuTime&) = delete;
+
+	private:
+
+		ThreadCpuTime& m_total;
+
+		ThreadCpuClock m_clock;
+	};
+
+	//
+	//	Measures every clock now instead of on first use, e.g. at the start of main()
+	//
+	inline void CalibrateClockOverheads()
+	{
+		GetClockOverhead<MillisecClock>();
+		GetClockOverhead<MicrosecClock>();
+		GetClockOverhead<NanosecClock>();
+		GetClockOverhead<RDTSCClock>();
+		GetClockOverhead<SerializedRDTSCClock>();
+		GetClockOverhead<RDTSCPClock>();
+		GetClockOverhead<ThreadCpuClock>();
+	}
 }
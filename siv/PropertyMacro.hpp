@@ -6,4 +6,16 @@
 //------------------------------------------
 
 # pragma once
-# define Property_Get(type,name) __declspec(property(get=_get_##name))type name;type _get_##name()
+
+# if defined(_MSC_VER) || defined(_MSC_EXTENSIONS)
+
+#	define SIV_HAS_PROPERTY 1
+#	define Property_Get(type,name) __declspec(property(get=_get_##name))type name;type _get_##name()
+
+# else
+
+//	__declspec(property) is not available: the property becomes a getter function, i.e. obj.name()
+#	define SIV_HAS_PROPERTY 0
+#	define Property_Get(type,name) type name()
+
+# endif
@@ -0,0 +1,778 @@
+﻿//------------------------------------------
+//	SamplingProfiler.hpp
+//	Copyright (c) 2014 Reputeless
+//	<reputeless@gmail.com>
+//	Distributed under the MIT license.
+//------------------------------------------
+
+# pragma once
+
+# if !defined(__linux__)
+#	error "SamplingProfiler.hpp requires Linux (timer_create / SIGPROF)"
+# endif
+
+# include <cerrno>
+# include <cstdio>
+# include <cstdlib>
+# include <cstring>
+# include <cstdint>
+# include <atomic>
+# include <memory>
+# include <mutex>
+# include <thread>
+# include <vector>
+# include <string>
+# include <algorithm>
+# include <unordered_map>
+# include <ostream>
+# include <signal.h>
+# include <time.h>
+# include <unistd.h>
+# include <ucontext.h>
+# include <pthread.h>
+# include <dlfcn.h>
+# include <cxxabi.h>
+# include <sys/syscall.h>
+
+# ifndef SIV_SAMPLING_MAX_DEPTH
+#	define SIV_SAMPLING_MAX_DEPTH 32
+# endif
+
+# ifndef sigev_notify_thread_id
+#	define sigev_notify_thread_id _sigev_un._tid
+# endif
+
+namespace siv
+{
+	//
+	//	One SIGPROF sample: frames[0] is the interrupted instruction, the rest are return addresses
+	//
+	struct ProfileSample
+	{
+		// UnregisteredThread for threads sampled by the process-wide timer
+		unsigned threadIndex;
+
+		unsigned depth;
+
+		void* frames[SIV_SAMPLING_MAX_DEPTH];
+	};
+
+	//
+	//	Statistical profiler: each registered thread gets a CPU-time timer that raises SIGPROF,
+	//	and the handler walks frame pointers into a buffer preallocated by start().
+	//	Threads that never call registerCurrentThread() are sampled by a process CPU-time timer, which
+	//	interrupts whichever thread is running; their stack bounds are unknown, so only the interrupted
+	//	instruction is recorded (self time, no callers).
+	//	Build with -fno-omit-frame-pointer for full stacks and -rdynamic for symbol names.
+	//
+	class SamplingProfiler
+	{
+	public:
+
+		static const unsigned UnregisteredThread = ~0u;
+
+		SamplingProfiler() = default;
+
+		SamplingProfiler(const SamplingProfiler&) = delete;
+
+		SamplingProfiler& operator=(const SamplingProfiler&) = delete;
+
+		~SamplingProfiler()
+		{
+			stop();
+		}
+
+		//
+		//	frequency: samples per CPU-second of each thread, e.g. 100 - 1000 Hz
+		//	sampleUnregistered: also sample threads that did not register, through the process-wide timer
+		//
+		bool start(unsigned frequency = 997, size_t capacity = 1 << 16, bool sampleUnregistered = true)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			if (m_running || !SignalHandler().installed)
+			{
+				return false;
+			}
+
+			m_samples.reset(new ProfileSample[capacity]);
+
+			m_ready.reset(new std::atomic<bool>[capacity]);
+
+			for (size_t i = 0; i < capacity; ++i)
+			{
+				m_ready[i].store(false, std::memory_order_relaxed);
+			}
+
+			m_capacity = capacity;
+
+			m_next.store(0);
+
+			m_dropped.store(0);
+
+			m_intervalNanosec = 1000000000ULL / std::max(1u, frequency);
+
+			Instance().store(this, std::memory_order_release);
+
+			m_running = true;
+
+			for (auto& thread : m_threads)
+			{
+				armTimer(thread);
+			}
+
+			if (sampleUnregistered)
+			{
+				armProcessTimer();
+			}
+
+			return true;
+		}
+
+		//
+		//	Deletes every timer; samples stay available until the next start().
+		//	The handler stays installed, so a SIGPROF still queued for some thread is ignored rather than fatal.
+		//
+		void stop()
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			if (!m_running)
+			{
+				return;
+			}
+
+			for (auto& thread : m_threads)
+			{
+				disarmTimer(thread);
+			}
+
+			if (m_processTimerArmed)
+			{
+				::timer_delete(m_processTimer);
+
+				m_processTimerArmed = false;
+			}
+
+			m_running = false;
+
+			Instance().store(nullptr);
+
+			// a handler that loaded the pointer before it was cleared may still be writing a sample:
+			// start() and the destructor free the buffers it writes to
+			while (InFlightHandlers().load() != 0)
+			{
+				std::this_thread::yield();
+			}
+		}
+
+		//
+		//	Samples the calling thread while the profiler runs (until unregisterCurrentThread or exit)
+		//
+		void registerCurrentThread()
+		{
+			ThreadState& state = CurrentThread();
+
+			if (state.registered)
+			{
+				return;
+			}
+
+			pthread_attr_t attr;
+
+			if (::pthread_getattr_np(::pthread_self(), &attr) == 0)
+			{
+				void* stackAddress;
+
+				size_t stackSize;
+
+				::pthread_attr_getstack(&attr, &stackAddress, &stackSize);
+
+				::pthread_attr_destroy(&attr);
+
+				state.stackLow = reinterpret_cast<std::uintptr_t>(stackAddress);
+
+				state.stackHigh = state.stackLow + stackSize;
+			}
+
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			state.threadIndex = m_nextThreadIndex++;
+
+			state.registered = true;
+
+			Thread thread;
+
+			thread.tid = static_cast<pid_t>(::syscall(SYS_gettid));
+
+			thread.handle = ::pthread_self();
+
+			thread.state = &state;
+
+			m_threads.push_back(thread);
+
+			if (m_running)
+			{
+				armTimer(m_threads.back());
+			}
+
+			ThreadGuard().profiler = this;
+		}
+
+		void unregisterCurrentThread()
+		{
+			ThreadState& state = CurrentThread();
+
+			if (!state.registered)
+			{
+				return;
+			}
+
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			for (auto it = m_threads.begin(); it != m_threads.end(); ++it)
+			{
+				if (it->state == &state)
+				{
+					disarmTimer(*it);
+
+					m_threads.erase(it);
+
+					break;
+				}
+			}
+
+			state.registered = false;
+
+			ThreadGuard().profiler = nullptr;
+		}
+
+		//
+		//	Completed samples (copies; safe to call while running)
+		//
+		std::vector<ProfileSample> getSamples() const
+		{
+			std::vector<ProfileSample> samples;
+
+			const size_t count = std::min(m_next.load(std::memory_order_acquire), m_capacity);
+
+			for (size_t i = 0; i < count; ++i)
+			{
+				if (m_ready[i].load(std::memory_order_acquire))
+				{
+					samples.push_back(m_samples[i]);
+				}
+			}
+
+			return samples;
+		}
+
+		unsigned long long dropped() const
+		{
+			return m_dropped.load();
+		}
+
+		bool running() const
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			return m_running;
+		}
+
+	private:
+
+		struct ThreadState
+		{
+			bool registered;
+
+			unsigned threadIndex;
+
+			std::uintptr_t stackLow;
+
+			std::uintptr_t stackHigh;
+		};
+
+		struct Thread
+		{
+			pid_t tid;
+
+			pthread_t handle;
+
+			ThreadState* state;
+
+			timer_t timer;
+
+			bool armed = false;
+		};
+
+		//
+		//	SIGPROF handler, installed once for the process: the previous action (usually SIG_DFL, which terminates)
+		//	is restored only at exit, because timers deleted by stop() may already have queued a signal
+		//
+		struct SignalHandlerInstallation
+		{
+			bool installed = false;
+
+			struct sigaction previousAction;
+
+			SignalHandlerInstallation()
+			{
+				struct sigaction action;
+
+				std::memset(&action, 0, sizeof(action));
+
+				action.sa_sigaction = &SamplingProfiler::OnSignal;
+
+				action.sa_flags = SA_SIGINFO | SA_RESTART;
+
+				sigemptyset(&action.sa_mask);
+
+				installed = ::sigaction(SIGPROF, &action, &previousAction) == 0;
+			}
+
+			~SignalHandlerInstallation()
+			{
+				// a profiler still running at exit keeps its timers: keep the handler too
+				if (installed && !Instance().load(std::memory_order_acquire))
+				{
+					::sigaction(SIGPROF, &previousAction, nullptr);
+				}
+			}
+		};
+
+		// sigev_value of the process-wide timer, to tell its signals from the per-thread timers'
+		static const int ProcessTimerTag = 1;
+
+		struct ThreadExitGuard
+		{
+			SamplingProfiler* profiler = nullptr;
+
+			~ThreadExitGuard()
+			{
+				if (profiler)
+				{
+					profiler->unregisterCurrentThread();
+				}
+			}
+		};
+
+		mutable std::mutex m_mutex;
+
+		bool m_running = false;
+
+		timer_t m_processTimer;
+
+		bool m_processTimerArmed = false;
+
+		unsigned long long m_intervalNanosec = 0;
+
+		std::vector<Thread> m_threads;
+
+		unsigned m_nextThreadIndex = 0;
+
+		std::unique_ptr<ProfileSample[]> m_samples;
+
+		std::unique_ptr<std::atomic<bool>[]> m_ready;
+
+		size_t m_capacity = 0;
+
+		std::atomic<size_t> m_next{ 0 };
+
+		std::atomic<unsigned long long> m_dropped{ 0 };
+
+		static std::atomic<SamplingProfiler*>& Instance()
+		{
+			static std::atomic<SamplingProfiler*> instance(nullptr);
+
+			return instance;
+		}
+
+		// handlers between loading Instance() and finishing record()
+		static std::atomic<unsigned>& InFlightHandlers()
+		{
+			static std::atomic<unsigned> inFlight(0);
+
+			return inFlight;
+		}
+
+		// trivially initialized so that the signal handler can read it without a guard
+		static ThreadState& CurrentThread()
+		{
+			static thread_local ThreadState state;
+
+			return state;
+		}
+
+		static ThreadExitGuard& ThreadGuard()
+		{
+			static thread_local ThreadExitGuard guard;
+
+			return guard;
+		}
+
+		static SignalHandlerInstallation& SignalHandler()
+		{
+			static SignalHandlerInstallation installation;
+
+			return installation;
+		}
+
+		void setInterval(timer_t timer) const
+		{
+			itimerspec spec;
+
+			spec.it_interval.tv_sec = static_cast<time_t>(m_intervalNanosec / 1000000000ULL);
+
+			spec.it_interval.tv_nsec = static_cast<long>(m_intervalNanosec % 1000000000ULL);
+
+			spec.it_value = spec.it_interval;
+
+			::timer_settime(timer, 0, &spec, nullptr);
+		}
+
+		void armTimer(Thread& thread)
+		{
+			sigevent event;
+
+			std::memset(&event, 0, sizeof(event));
+
+			event.sigev_notify = SIGEV_THREAD_ID;
+
+			event.sigev_signo = SIGPROF;
+
+			event.sigev_notify_thread_id = thread.tid;
+
+			// the thread's own CPU clock, so that arming from another thread still samples the right one
+			clockid_t clock;
+
+			if (::pthread_getcpuclockid(thread.handle, &clock) != 0
+				|| ::timer_create(clock, &event, &thread.timer) != 0)
+			{
+				return;
+			}
+
+			setInterval(thread.timer);
+
+			thread.armed = true;
+		}
+
+		//
+		//	Process CPU-time timer: the signal is process-directed; Linux 6.4 and later deliver it to the running thread,
+		//	older kernels prefer the main thread, which biases the fallback samples towards it
+		//
+		void armProcessTimer()
+		{
+			sigevent event;
+
+			std::memset(&event, 0, sizeof(event));
+
+			event.sigev_notify = SIGEV_SIGNAL;
+
+			event.sigev_signo = SIGPROF;
+
+			event.sigev_value.sival_int = ProcessTimerTag;
+
+			if (::timer_create(CLOCK_PROCESS_CPUTIME_ID, &event, &m_processTimer) != 0)
+			{
+				return;
+			}
+
+			setInterval(m_processTimer);
+
+			m_processTimerArmed = true;
+		}
+
+		void disarmTimer(Thread& thread)
+		{
+			if (thread.armed)
+			{
+				::timer_delete(thread.timer);
+
+				thread.armed = false;
+			}
+		}
+
+		//
+		//	Async-signal-safe: no locks, no allocation
+		//
+		static void OnSignal(int, siginfo_t* info, void* context)
+		{
+			// counted before the load (both sequentially consistent): stop() either sees this handler or it sees nullptr
+			InFlightHandlers().fetch_add(1);
+
+			SamplingProfiler* profiler = Instance().load();
+
+			const ThreadState& state = CurrentThread();
+
+			const bool processTimer = info->si_code == SI_TIMER && info->si_value.sival_int == ProcessTimerTag;
+
+			// registered threads are sampled by their own timers only
+			if (profiler && state.registered != processTimer)
+			{
+				const int savedErrno = errno;
+
+				profiler->record(state, static_cast<const ucontext_t*>(context));
+
+				errno = savedErrno;
+			}
+
+			InFlightHandlers().fetch_sub(1, std::memory_order_release);
+		}
+
+		void record(const ThreadState& state, const ucontext_t* context)
+		{
+			const size_t index = m_next.fetch_add(1, std::memory_order_relaxed);
+
+			if (index >= m_capacity)
+			{
+				m_dropped.fetch_add(1, std::memory_order_relaxed);
+
+				return;
+			}
+
+			ProfileSample& sample = m_samples[index];
+
+			sample.threadIndex = state.registered ? state.threadIndex : UnregisteredThread;
+
+			sample.depth = 0;
+
+#if defined(__x86_64__)
+
+			std::uintptr_t pc = static_cast<std::uintptr_t>(context->uc_mcontext.gregs[REG_RIP]);
+
+			std::uintptr_t fp = static_cast<std::uintptr_t>(context->uc_mcontext.gregs[REG_RBP]);
+
+#elif defined(__aarch64__)
+
+			std::uintptr_t pc = static_cast<std::uintptr_t>(context->uc_mcontext.pc);
+
+			std::uintptr_t fp = static_cast<std::uintptr_t>(context->uc_mcontext.regs[29]);
+
+#else
+
+			(void)context;
+
+			std::uintptr_t pc = 0, fp = 0;
+
+#endif
+
+			if (pc)
+			{
+				sample.frames[sample.depth++] = reinterpret_cast<void*>(pc);
+			}
+
+			// frame record: [fp] = caller's fp, [fp + 1 word] = return address; never walked on a thread that did not register
+			while (sample.depth < SIV_SAMPLING_MAX_DEPTH
+				&& fp >= state.stackLow && fp + 2 * sizeof(void*) <= state.stackHigh
+				&& fp % sizeof(void*) == 0)
+			{
+				const std::uintptr_t* frame = reinterpret_cast<const std::uintptr_t*>(fp);
+
+				const std::uintptr_t returnAddress = frame[1];
+
+				const std::uintptr_t next = frame[0];
+
+				if (!returnAddress)
+				{
+					break;
+				}
+
+				sample.frames[sample.depth++] = reinterpret_cast<void*>(returnAddress);
+
+				// stacks grow down: the caller's frame must be above this one
+				if (next <= fp)
+				{
+					break;
+				}
+
+				fp = next;
+			}
+
+			m_ready[index].store(true, std::memory_order_release);
+		}
+	};
+
+	//
+	//	Lazy, cached address -> "function" or "module+0xoffset"
+	//
+	class SampleSymbolizer
+	{
+	public:
+
+		//
+		//	isReturnAddress: look up address - 1 so that calls at the end of a function resolve correctly
+		//
+		const std::string& symbolize(void* address, bool isReturnAddress)
+		{
+			void* const lookup = static_cast<char*>(address) - (isReturnAddress ? 1 : 0);
+
+			auto it = m_cache.find(lookup);
+
+			if (it != m_cache.end())
+			{
+				return it->second;
+			}
+
+			std::string name;
+
+			Dl_info info;
+
+			const bool found = ::dladdr(lookup, &info) != 0;
+
+			if (found && info.dli_sname)
+			{
+				int status = 0;
+
+				char* demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+
+				name = (status == 0 && demangled) ? demangled : info.dli_sname;
+
+				std::free(demangled);
+			}
+			else if (found && info.dli_fname)
+			{
+				char offset[32];
+
+				std::snprintf(offset, sizeof(offset), "+0x%llx", static_cast<unsigned long long>(
+					static_cast<char*>(lookup) - static_cast<char*>(info.dli_fbase)));
+
+				const char* base = std::strrchr(info.dli_fname, '/');
+
+				name = std::string(base ? base + 1 : info.dli_fname) + offset;
+			}
+			else
+			{
+				char buffer[32];
+
+				std::snprintf(buffer, sizeof(buffer), "%p", lookup);
+
+				name = buffer;
+			}
+
+			return m_cache.emplace(lookup, std::move(name)).first->second;
+		}
+
+	private:
+
+		std::unordered_map<void*, std::string> m_cache;
+	};
+
+	struct Hotspot
+	{
+		std::string function;
+
+		// samples with the function on top of the stack
+		size_t selfSamples = 0;
+
+		// samples with the function anywhere on the stack
+		size_t totalSamples = 0;
+	};
+
+	inline std::vector<Hotspot> MakeHotspots(const std::vector<ProfileSample>& samples, SampleSymbolizer& symbolizer)
+	{
+		std::unordered_map<std::string, Hotspot> hotspots;
+
+		// unordered_map nodes are stable; names are not unique per address (every return address has its own)
+		std::vector<const Hotspot*> seen;
+
+		for (const auto& sample : samples)
+		{
+			seen.clear();
+
+			for (unsigned i = 0; i < sample.depth; ++i)
+			{
+				const std::string& name = symbolizer.symbolize(sample.frames[i], i != 0);
+
+				Hotspot& hotspot = hotspots[name];
+
+				if (i == 0)
+				{
+					++hotspot.selfSamples;
+				}
+
+				// recursion counts once per sample
+				if (std::find(seen.begin(), seen.end(), &hotspot) == seen.end())
+				{
+					++hotspot.totalSamples;
+
+					seen.push_back(&hotspot);
+				}
+			}
+		}
+
+		std::vector<Hotspot> result;
+
+		for (auto& entry : hotspots)
+		{
+			entry.second.function = entry.first;
+
+			result.push_back(entry.second);
+		}
+
+		std::sort(result.begin(), result.end(), [](const Hotspot& a, const Hotspot& b)
+		{
+			return a.selfSamples != b.selfSamples ? a.selfSamples > b.selfSamples : a.totalSamples > b.totalSamples;
+		});
+
+		return result;
+	}
+
+	inline void WriteHotspots(std::ostream& os, const std::vector<ProfileSample>& samples, size_t top = 20)
+	{
+		SampleSymbolizer symbolizer;
+
+		const auto hotspots = MakeHotspots(samples, symbolizer);
+
+		const double total = std::max<size_t>(1, samples.size());
+
+		os << "self%\ttotal%\tfunction (" << samples.size() << " samples)\n";
+
+		for (size_t i = 0; i < std::min(top, hotspots.size()); ++i)
+		{
+			char line[32];
+
+			std::snprintf(line, sizeof(line), "%5.1f\t%5.1f\t", 100.0 * hotspots[i].selfSamples / total, 100.0 * hotspots[i].totalSamples / total);
+
+			os << line << hotspots[i].function << '\n';
+		}
+	}
+
+	//
+	//	Collapsed stacks (root first) for flamegraph.pl
+	//
+	inline void WriteSampledStacks(std::ostream& os, const std::vector<ProfileSample>& samples)
+	{
+		SampleSymbolizer symbolizer;
+
+		std::unordered_map<std::string, size_t> stacks;
+
+		for (const auto& sample : samples)
+		{
+			std::string stack;
+
+			for (unsigned i = sample.depth; i-- > 0;)
+			{
+				if (!stack.empty())
+				{
+					stack += ';';
+				}
+
+				stack += symbolizer.symbolize(sample.frames[i], i != 0);
+			}
+
+			++stacks[stack];
+		}
+
+		for (const auto& entry : stacks)
+		{
+			os << entry.first << ' ' << entry.second << '\n';
+		}
+	}
+
+	inline SamplingProfiler& GetSamplingProfiler()
+	{
+		static SamplingProfiler profiler;
+
+		return profiler;
+	}
+}
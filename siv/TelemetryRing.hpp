@@ -0,0 +1,660 @@
+﻿//------------------------------------------
+//	TelemetryRing.hpp
+//	Copyright (c) 2014 Reputeless
+//	<reputeless@gmail.com>
+//	Distributed under the MIT license.
+//------------------------------------------
+
+# pragma once
+
+# if defined(_WIN32)
+#	error "TelemetryRing.hpp requires POSIX shared memory (shm_open)"
+# endif
+
+# include <cstdint>
+# include <cstdio>
+# include <cstdlib>
+# include <cstring>
+# include <atomic>
+# include <string>
+# include <vector>
+# include <mutex>
+# include <thread>
+# include <chrono>
+# include <unordered_map>
+# include <algorithm>
+# include <iostream>
+# include <fcntl.h>
+# include <unistd.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include "ProfileZone.hpp"
+
+// longest zone name kept in shared memory, including the terminator
+# ifndef SIV_TELEMETRY_NAME_LENGTH
+#	define SIV_TELEMETRY_NAME_LENGTH 48
+# endif
+
+namespace siv
+{
+	//
+	//	Shared memory layout: header, zone slots, event ring.
+	//	There is a single writer (the publisher, on the collector thread); readers never write,
+	//	so attaching a viewer cannot slow the process down.
+	//
+	struct TelemetryHeader
+	{
+		char magic[8];
+
+		std::uint32_t version;
+
+		std::uint32_t zoneCapacity;
+
+		std::uint32_t eventCapacity;
+
+		std::uint32_t processID;
+
+		// slots [0, zoneCount) have their names set; released after the name is written
+		std::atomic<std::uint32_t> zoneCount;
+
+		std::atomic<std::uint64_t> publishCount;
+
+		// total events ever written; event i lives in slot i % eventCapacity
+		std::atomic<std::uint64_t> eventHead;
+	};
+
+	//
+	//	Aggregate of one zone name. The counters are guarded by a seqlock: odd while being written.
+	//
+	struct TelemetryZoneSlot
+	{
+		std::atomic<std::uint32_t> sequence;
+
+		char name[SIV_TELEMETRY_NAME_LENGTH];
+
+		std::atomic<std::uint64_t> count;
+
+		std::atomic<std::uint64_t> totalNanosec;
+
+		std::atomic<std::uint64_t> maxNanosec;
+	};
+
+	struct TelemetryEventSlot
+	{
+		// index of the event + 1 once written, 0 while being written
+		std::atomic<std::uint64_t> sequence;
+
+		std::atomic<std::uint32_t> zone;
+
+		std::atomic<std::uint32_t> thread;
+
+		std::atomic<std::uint64_t> endNanosec;
+
+		std::atomic<std::uint64_t> durationNanosec;
+	};
+
+	struct TelemetryZoneStats
+	{
+		std::string name;
+
+		unsigned long long count = 0;
+
+		unsigned long long totalNanosec = 0;
+
+		unsigned long long maxNanosec = 0;
+
+		// the publisher stayed mid-update (it may have died there): the counters may be torn
+		bool stale = false;
+	};
+
+	struct TelemetryEvent
+	{
+		std::string zone;
+
+		unsigned thread;
+
+		unsigned long long endNanosec;
+
+		unsigned long long durationNanosec;
+	};
+
+	namespace detail
+	{
+		const char TelemetryMagic[8] = { 'S', 'I', 'V', 'T', 'E', 'L', 'E', 'M' };
+
+		const std::uint32_t TelemetryVersion = 1;
+
+		inline size_t TelemetrySize(std::uint32_t zoneCapacity, std::uint32_t eventCapacity)
+		{
+			return sizeof(TelemetryHeader) + zoneCapacity * sizeof(TelemetryZoneSlot) + eventCapacity * sizeof(TelemetryEventSlot);
+		}
+
+		inline TelemetryZoneSlot* TelemetryZones(void* base)
+		{
+			return reinterpret_cast<TelemetryZoneSlot*>(static_cast<char*>(base) + sizeof(TelemetryHeader));
+		}
+
+		inline TelemetryEventSlot* TelemetryEvents(void* base, std::uint32_t zoneCapacity)
+		{
+			return reinterpret_cast<TelemetryEventSlot*>(reinterpret_cast<char*>(TelemetryZones(base) + zoneCapacity));
+		}
+	}
+
+	inline std::string GetTelemetryName(unsigned processID = static_cast<unsigned>(::getpid()))
+	{
+		return "/siv-telemetry-" + std::to_string(processID);
+	}
+
+	//
+	//	ZoneSink publishing per-zone totals and the most recent zones to POSIX shared memory.
+	//	Runs on the collector thread; profiled threads are not affected.
+	//
+	class TelemetryPublisher : public ZoneSink
+	{
+	public:
+
+		explicit TelemetryPublisher(const std::string& name = GetTelemetryName(), std::uint32_t zoneCapacity = 256, std::uint32_t eventCapacity = 4096)
+			: m_name(name)
+			, m_zoneCapacity(std::max(zoneCapacity, 1u))
+			, m_eventCapacity(std::max(eventCapacity, 1u))
+			, m_size(detail::TelemetrySize(m_zoneCapacity, m_eventCapacity))
+		{
+			const int fd = ::shm_open(m_name.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0644);
+
+			if (fd == -1)
+			{
+				return;
+			}
+
+			void* base = (::ftruncate(fd, static_cast<off_t>(m_size)) == 0)
+				? ::mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+
+			::close(fd);
+
+			if (base == MAP_FAILED)
+			{
+				::shm_unlink(m_name.c_str());
+
+				return;
+			}
+
+			// the new object is zero-filled; the magic is written last so readers never see a partial header
+			m_base = base;
+
+			TelemetryHeader& h = header();
+
+			h.version = detail::TelemetryVersion;
+			h.zoneCapacity = m_zoneCapacity;
+			h.eventCapacity = m_eventCapacity;
+			h.processID = static_cast<std::uint32_t>(::getpid());
+
+			std::atomic_thread_fence(std::memory_order_release);
+
+			std::memcpy(h.magic, detail::TelemetryMagic, sizeof(h.magic));
+		}
+
+		~TelemetryPublisher()
+		{
+			if (m_base)
+			{
+				::munmap(m_base, m_size);
+
+				::shm_unlink(m_name.c_str());
+			}
+		}
+
+		TelemetryPublisher(const TelemetryPublisher&) = delete;
+
+		TelemetryPublisher& operator=(const TelemetryPublisher&) = delete;
+
+		bool isOpen() const
+		{
+			return m_base != nullptr;
+		}
+
+		const std::string& name() const
+		{
+			return m_name;
+		}
+
+		void onZoneRecords(unsigned threadIndex, const ZoneRecord* records, size_t count) override
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			if (!m_base)
+			{
+				return;
+			}
+
+			TelemetryZoneSlot* zones = detail::TelemetryZones(m_base);
+
+			TelemetryEventSlot* events = detail::TelemetryEvents(m_base, m_zoneCapacity);
+
+			std::uint64_t head = header().eventHead.load(std::memory_order_relaxed);
+
+			for (size_t i = 0; i < count; ++i)
+			{
+				const ZoneRecord& r = records[i];
+
+				const std::uint32_t index = slot(r.name);
+
+				if (index == m_zoneCapacity)
+				{
+					continue;
+				}
+
+				const unsigned long long duration = TSCToNanosec(r.end - r.begin);
+
+				// seqlock write: readers retry while the sequence is odd or has changed
+				TelemetryZoneSlot& zone = zones[index];
+
+				const std::uint32_t sequence = zone.sequence.load(std::memory_order_relaxed);
+
+				zone.sequence.store(sequence + 1, std::memory_order_relaxed);
+
+				std::atomic_thread_fence(std::memory_order_release);
+
+				zone.count.store(zone.count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+				zone.totalNanosec.store(zone.totalNanosec.load(std::memory_order_relaxed) + duration, std::memory_order_relaxed);
+
+				if (duration > zone.maxNanosec.load(std::memory_order_relaxed))
+				{
+					zone.maxNanosec.store(duration, std::memory_order_relaxed);
+				}
+
+				zone.sequence.store(sequence + 2, std::memory_order_release);
+
+				TelemetryEventSlot& event = events[head % m_eventCapacity];
+
+				event.sequence.store(0, std::memory_order_relaxed);
+
+				std::atomic_thread_fence(std::memory_order_release);
+
+				event.zone.store(index, std::memory_order_relaxed);
+				event.thread.store(threadIndex, std::memory_order_relaxed);
+				event.endNanosec.store(TSCToNanosec(r.end), std::memory_order_relaxed);
+				event.durationNanosec.store(duration, std::memory_order_relaxed);
+
+				event.sequence.store(head + 1, std::memory_order_release);
+
+				++head;
+			}
+
+			header().eventHead.store(head, std::memory_order_release);
+
+			header().publishCount.fetch_add(1, std::memory_order_release);
+		}
+
+	private:
+
+		std::mutex m_mutex;
+
+		const std::string m_name;
+
+		const std::uint32_t m_zoneCapacity;
+
+		const std::uint32_t m_eventCapacity;
+
+		const size_t m_size;
+
+		void* m_base = nullptr;
+
+		std::unordered_map<const char*, std::uint32_t> m_slots;
+
+		TelemetryHeader& header()
+		{
+			return *static_cast<TelemetryHeader*>(m_base);
+		}
+
+		//
+		//	Slot of the zone, assigned on first sight; m_zoneCapacity when full
+		//
+		std::uint32_t slot(const char* name)
+		{
+			const auto it = m_slots.find(name);
+
+			if (it != m_slots.end())
+			{
+				return it->second;
+			}
+
+			TelemetryZoneSlot* zones = detail::TelemetryZones(m_base);
+
+			const std::uint32_t used = header().zoneCount.load(std::memory_order_relaxed);
+
+			std::uint32_t index = used;
+
+			// equal names from different literals share a slot
+			for (std::uint32_t i = 0; i < used; ++i)
+			{
+				if (std::strncmp(zones[i].name, name, SIV_TELEMETRY_NAME_LENGTH - 1) == 0)
+				{
+					index = i;
+
+					break;
+				}
+			}
+
+			if (index == used && used < m_zoneCapacity)
+			{
+				std::strncpy(zones[index].name, name, SIV_TELEMETRY_NAME_LENGTH - 1);
+
+				header().zoneCount.store(used + 1, std::memory_order_release);
+			}
+
+			if (index < m_zoneCapacity)
+			{
+				m_slots.emplace(name, index);
+			}
+
+			return index;
+		}
+	};
+
+	//
+	//	Read-only view of another process's telemetry
+	//
+	class TelemetryReader
+	{
+	public:
+
+		explicit TelemetryReader(const std::string& name)
+		{
+			const int fd = ::shm_open(name.c_str(), O_RDONLY, 0);
+
+			if (fd == -1)
+			{
+				return;
+			}
+
+			struct stat st;
+
+			void* base = (::fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) >= sizeof(TelemetryHeader))
+				? ::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+
+			::close(fd);
+
+			if (base == MAP_FAILED)
+			{
+				return;
+			}
+
+			const TelemetryHeader& h = *static_cast<const TelemetryHeader*>(base);
+
+			if (std::memcmp(h.magic, detail::TelemetryMagic, sizeof(h.magic)) != 0 || h.version != detail::TelemetryVersion
+				|| detail::TelemetrySize(h.zoneCapacity, h.eventCapacity) > static_cast<size_t>(st.st_size))
+			{
+				::munmap(base, static_cast<size_t>(st.st_size));
+
+				return;
+			}
+
+			m_base = base;
+
+			m_size = static_cast<size_t>(st.st_size);
+		}
+
+		~TelemetryReader()
+		{
+			if (m_base)
+			{
+				::munmap(m_base, m_size);
+			}
+		}
+
+		TelemetryReader(const TelemetryReader&) = delete;
+
+		TelemetryReader& operator=(const TelemetryReader&) = delete;
+
+		bool isOpen() const
+		{
+			return m_base != nullptr;
+		}
+
+		unsigned processID() const
+		{
+			return header().processID;
+		}
+
+		unsigned long long publishCount() const
+		{
+			return header().publishCount.load(std::memory_order_acquire);
+		}
+
+		std::vector<TelemetryZoneStats> readZones() const
+		{
+			std::vector<TelemetryZoneStats> stats;
+
+			const std::uint32_t count = std::min(header().zoneCount.load(std::memory_order_acquire), header().zoneCapacity);
+
+			TelemetryZoneSlot* zones = detail::TelemetryZones(m_base);
+
+			for (std::uint32_t i = 0; i < count; ++i)
+			{
+				TelemetryZoneStats s;
+
+				s.name = zoneName(i);
+
+				// a publisher that died between the two sequence stores leaves it odd for good
+				s.stale = true;
+
+				for (unsigned attempt = 0; attempt < MaxReadAttempts; ++attempt)
+				{
+					const std::uint32_t before = zones[i].sequence.load(std::memory_order_acquire);
+
+					s.count = zones[i].count.load(std::memory_order_relaxed);
+					s.totalNanosec = zones[i].totalNanosec.load(std::memory_order_relaxed);
+					s.maxNanosec = zones[i].maxNanosec.load(std::memory_order_relaxed);
+
+					std::atomic_thread_fence(std::memory_order_acquire);
+
+					if (!(before & 1) && zones[i].sequence.load(std::memory_order_relaxed) == before)
+					{
+						s.stale = false;
+
+						break;
+					}
+
+					std::this_thread::yield();
+				}
+
+				stats.push_back(s);
+			}
+
+			return stats;
+		}
+
+		//
+		//	Up to maxCount most recent events, oldest first; events overwritten while reading are skipped
+		//
+		std::vector<TelemetryEvent> readEvents(size_t maxCount) const
+		{
+			std::vector<TelemetryEvent> events;
+
+			const std::uint32_t capacity = header().eventCapacity;
+
+			const std::uint64_t head = header().eventHead.load(std::memory_order_acquire);
+
+			const std::uint64_t first = head - std::min<std::uint64_t>(head, std::min<std::uint64_t>(maxCount, capacity));
+
+			TelemetryEventSlot* slots = detail::TelemetryEvents(m_base, header().zoneCapacity);
+
+			for (std::uint64_t i = first; i < head; ++i)
+			{
+				const TelemetryEventSlot& slot = slots[i % capacity];
+
+				if (slot.sequence.load(std::memory_order_acquire) != i + 1)
+				{
+					continue;
+				}
+
+				const std::uint32_t zone = slot.zone.load(std::memory_order_relaxed);
+
+				TelemetryEvent event = { std::string(), slot.thread.load(std::memory_order_relaxed),
+					slot.endNanosec.load(std::memory_order_relaxed), slot.durationNanosec.load(std::memory_order_relaxed) };
+
+				std::atomic_thread_fence(std::memory_order_acquire);
+
+				if (slot.sequence.load(std::memory_order_relaxed) != i + 1)
+				{
+					continue;
+				}
+
+				event.zone = zoneName(zone);
+
+				events.push_back(event);
+			}
+
+			return events;
+		}
+
+	private:
+
+		// a live publisher holds a zone's seqlock for a few stores
+		static const unsigned MaxReadAttempts = 1000;
+
+		void* m_base = nullptr;
+
+		size_t m_size = 0;
+
+		const TelemetryHeader& header() const
+		{
+			return *static_cast<const TelemetryHeader*>(m_base);
+		}
+
+		std::string zoneName(std::uint32_t index) const
+		{
+			if (index >= header().zoneCapacity)
+			{
+				return std::string();
+			}
+
+			const char* name = detail::TelemetryZones(m_base)[index].name;
+
+			return std::string(name, ::strnlen(name, SIV_TELEMETRY_NAME_LENGTH));
+		}
+	};
+
+	//
+	//	Zones with the most time since the previous snapshot, largest first
+	//
+	inline std::vector<TelemetryZoneStats> MakeTelemetryDelta(const std::vector<TelemetryZoneStats>& previous, const std::vector<TelemetryZoneStats>& current)
+	{
+		std::vector<TelemetryZoneStats> delta;
+
+		for (const auto& c : current)
+		{
+			TelemetryZoneStats d = c;
+
+			for (const auto& p : previous)
+			{
+				if (p.name == c.name)
+				{
+					d.count -= p.count;
+
+					d.totalNanosec -= p.totalNanosec;
+
+					break;
+				}
+			}
+
+			delta.push_back(d);
+		}
+
+		std::sort(delta.begin(), delta.end(), [](const TelemetryZoneStats& a, const TelemetryZoneStats& b)
+		{
+			return a.totalNanosec > b.totalNanosec;
+		});
+
+		return delta;
+	}
+
+	inline void WriteTelemetryTop(std::ostream& os, const std::vector<TelemetryZoneStats>& delta, size_t top, double seconds)
+	{
+		char line[256];
+
+		std::snprintf(line, sizeof(line), "%-40s %10s %12s %10s %12s\n", "zone", "calls/s", "time/s(ms)", "mean(us)", "max(us)");
+
+		os << line;
+
+		for (size_t i = 0; i < std::min(top, delta.size()); ++i)
+		{
+			const TelemetryZoneStats& z = delta[i];
+
+			std::snprintf(line, sizeof(line), "%-40s %10.0f %12.2f %10.2f %12.2f\n", (z.stale ? z.name + " (stale)" : z.name).c_str(),
+				z.count / seconds, z.totalNanosec / seconds / 1.0e6,
+				z.count ? z.totalNanosec / 1000.0 / z.count : 0.0, z.maxNanosec / 1000.0);
+
+			os << line;
+		}
+	}
+
+	//
+	//	Viewer command line: <pid | shm name> [--top=<n>] [--interval=<ms>] [--count=<refreshes>]
+	//
+	inline int RunTelemetryViewerMain(int argc, char** argv)
+	{
+		std::string name;
+
+		size_t top = 20;
+
+		unsigned long long intervalMillisec = 1000, refreshes = 0;
+
+		for (int i = 1; i < argc; ++i)
+		{
+			const std::string arg = argv[i];
+
+			if (arg.compare(0, 6, "--top=") == 0)
+			{
+				top = std::strtoul(arg.c_str() + 6, nullptr, 10);
+			}
+			else if (arg.compare(0, 11, "--interval=") == 0)
+			{
+				intervalMillisec = std::max(1ULL, std::strtoull(arg.c_str() + 11, nullptr, 10));
+			}
+			else if (arg.compare(0, 8, "--count=") == 0)
+			{
+				refreshes = std::strtoull(arg.c_str() + 8, nullptr, 10);
+			}
+			else if (name.empty() && arg.compare(0, 2, "--") != 0)
+			{
+				name = (arg[0] == '/') ? arg : GetTelemetryName(static_cast<unsigned>(std::strtoul(arg.c_str(), nullptr, 10)));
+			}
+			else
+			{
+				std::cerr << "unknown option: " << arg << '\n';
+
+				return 2;
+			}
+		}
+
+		TelemetryReader reader(name);
+
+		if (!reader.isOpen())
+		{
+			std::cerr << "cannot attach to " << name << '\n';
+
+			return 1;
+		}
+
+		std::vector<TelemetryZoneStats> previous = reader.readZones();
+
+		for (unsigned long long n = 0; refreshes == 0 || n < refreshes; ++n)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(intervalMillisec));
+
+			const std::vector<TelemetryZoneStats> current = reader.readZones();
+
+			// clear the terminal and home the cursor
+			std::cout << "\x1b[2J\x1b[H" << "pid " << reader.processID() << "  (" << intervalMillisec << "ms)\n";
+
+			WriteTelemetryTop(std::cout, MakeTelemetryDelta(previous, current), top, intervalMillisec / 1000.0);
+
+			std::cout << std::flush;
+
+			previous = current;
+		}
+
+		return 0;
+	}
+}
@@ -0,0 +1,362 @@
+﻿//------------------------------------------
+//	TraceExport.hpp
+//	Copyright (c) 2014 Reputeless
+//	<reputeless@gmail.com>
+//	Distributed under the MIT license.
+//------------------------------------------
+
+# pragma once
+# include <cstdio>
+# include <string>
+# include <vector>
+# include <mutex>
+# include <ostream>
+# include "ProfileZone.hpp"
+
+# ifndef SIV_TRACE_CHUNK_SIZE
+#	define SIV_TRACE_CHUNK_SIZE (64 * 1024)
+# endif
+
+namespace siv
+{
+	//
+	//	Fixed-size output chunk: the document is never held in memory as a whole
+	//
+	class TraceChunkWriter
+	{
+	public:
+
+		explicit TraceChunkWriter(std::ostream& os, size_t chunkSize = SIV_TRACE_CHUNK_SIZE)
+			: m_os(os)
+			, m_chunk(chunkSize) {}
+
+		~TraceChunkWriter()
+		{
+			flush();
+		}
+
+		TraceChunkWriter(const TraceChunkWriter&) = delete;
+
+		TraceChunkWriter& operator=(const TraceChunkWriter&) = delete;
+
+		void write(const char* s, size_t length)
+		{
+			while (length)
+			{
+				if (m_size == m_chunk.size())
+				{
+					flushChunk();
+				}
+
+				const size_t n = std::min(length, m_chunk.size() - m_size);
+
+				std::memcpy(m_chunk.data() + m_size, s, n);
+
+				m_size += n;
+
+				s += n;
+
+				length -= n;
+			}
+		}
+
+		void write(const char* s)
+		{
+			write(s, std::strlen(s));
+		}
+
+		void write(char ch)
+		{
+			write(&ch, 1);
+		}
+
+		void writeUInt(unsigned long long value)
+		{
+			char buffer[24];
+
+			const int length = std::snprintf(buffer, sizeof(buffer), "%llu", value);
+
+			write(buffer, length);
+		}
+
+		//
+		//	Nanoseconds as fractional microseconds, e.g. 1234567 -> "1234.567"
+		//
+		void writeMicrosec(unsigned long long nanosec)
+		{
+			char buffer[32];
+
+			const int length = std::snprintf(buffer, sizeof(buffer), "%llu.%03llu", nanosec / 1000ULL, nanosec % 1000ULL);
+
+			write(buffer, length);
+		}
+
+		void writeJSONString(const char* s)
+		{
+			write('"');
+
+			for (; *s; ++s)
+			{
+				const unsigned char ch = static_cast<unsigned char>(*s);
+
+				if (ch == '"' || ch == '\\')
+				{
+					write('\\');
+
+					write(*s);
+				}
+				else if (ch < 0x20)
+				{
+					char buffer[8];
+
+					const int length = std::snprintf(buffer, sizeof(buffer), "\\u%04x", ch);
+
+					write(buffer, length);
+				}
+				else
+				{
+					write(*s);
+				}
+			}
+
+			write('"');
+		}
+
+		void flush()
+		{
+			flushChunk();
+
+			m_os.flush();
+		}
+
+	private:
+
+		std::ostream& m_os;
+
+		std::vector<char> m_chunk;
+
+		size_t m_size = 0;
+
+		void flushChunk()
+		{
+			if (m_size)
+			{
+				m_os.write(m_chunk.data(), m_size);
+
+				m_size = 0;
+			}
+		}
+	};
+
+	//
+	//	Chrome trace_event JSON (chrome://tracing, ui.perfetto.dev)
+	//
+	class ChromeTraceWriter : public ZoneSink
+	{
+	public:
+
+		//
+		//	Timestamps are written relative to baseTicks (by default, the time the writer is created)
+		//
+		explicit ChromeTraceWriter(std::ostream& os, unsigned processID = 1, unsigned long long baseTicks = detail::ReadTSC())
+			: m_writer(os)
+			, m_processID(processID)
+			, m_baseTicks(baseTicks)
+		{
+			m_writer.write("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+		}
+
+		~ChromeTraceWriter()
+		{
+			finish();
+		}
+
+		void onZoneRecords(unsigned threadIndex, const ZoneRecord* records, size_t count) override
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			if (m_finished)
+			{
+				return;
+			}
+
+			if (std::find(m_threads.begin(), m_threads.end(), threadIndex) == m_threads.end())
+			{
+				m_threads.push_back(threadIndex);
+
+				beginEvent();
+				m_writer.write("{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":");
+				m_writer.writeUInt(m_processID);
+				m_writer.write(",\"tid\":");
+				m_writer.writeUInt(threadIndex);
+				m_writer.write(",\"args\":{\"name\":\"thread ");
+				m_writer.writeUInt(threadIndex);
+				m_writer.write("\"}}");
+			}
+
+			for (size_t i = 0; i < count; ++i)
+			{
+				const ZoneRecord& r = records[i];
+
+				// records older than the writer are clamped to its start
+				const unsigned long long begin = r.begin > m_baseTicks ? r.begin - m_baseTicks : 0;
+
+				beginEvent();
+				m_writer.write("{\"ph\":\"X\",\"name\":");
+				m_writer.writeJSONString(r.name);
+				m_writer.write(",\"pid\":");
+				m_writer.writeUInt(m_processID);
+				m_writer.write(",\"tid\":");
+				m_writer.writeUInt(threadIndex);
+				m_writer.write(",\"ts\":");
+				m_writer.writeMicrosec(TSCToNanosec(begin));
+				m_writer.write(",\"dur\":");
+				m_writer.writeMicrosec(TSCToNanosec(r.end - r.begin));
+				m_writer.write('}');
+			}
+		}
+
+		void flush()
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			m_writer.flush();
+		}
+
+		//
+		//	Closes the JSON document; later records are ignored
+		//
+		void finish()
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			if (m_finished)
+			{
+				return;
+			}
+
+			m_writer.write("\n]}\n");
+
+			m_writer.flush();
+
+			m_finished = true;
+		}
+
+	private:
+
+		std::mutex m_mutex;
+
+		TraceChunkWriter m_writer;
+
+		const unsigned m_processID;
+
+		const unsigned long long m_baseTicks;
+
+		std::vector<unsigned> m_threads;
+
+		bool m_hasEvent = false;
+
+		bool m_finished = false;
+
+		void beginEvent()
+		{
+			m_writer.write(m_hasEvent ? ",\n" : "\n");
+
+			m_hasEvent = true;
+		}
+	};
+
+	//
+	//	Brendan Gregg's collapsed stacks ("outer;inner;leaf <self ns>") for flamegraph.pl
+	//
+	class CollapsedStackWriter : public ZoneSink
+	{
+	public:
+
+		explicit CollapsedStackWriter(std::ostream& os)
+			: m_writer(os) {}
+
+		void onZoneRecords(unsigned threadIndex, const ZoneRecord* records, size_t count) override
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			ZoneTreeAssembler& assembler = getAssembler(threadIndex);
+
+			for (size_t i = 0; i < count; ++i)
+			{
+				// a top-level zone is written, merged by call path, as soon as it closes
+				assembler.add(records[i], [this](ZoneNode&& node)
+				{
+					m_stack.clear();
+
+					writeNode(node);
+				});
+			}
+		}
+
+		void flush()
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			m_writer.flush();
+		}
+
+	private:
+
+		std::mutex m_mutex;
+
+		TraceChunkWriter m_writer;
+
+		std::vector<std::pair<unsigned, ZoneTreeAssembler>> m_assemblers;
+
+		std::string m_stack;
+
+		ZoneTreeAssembler& getAssembler(unsigned threadIndex)
+		{
+			for (auto& assembler : m_assemblers)
+			{
+				if (assembler.first == threadIndex)
+				{
+					return assembler.second;
+				}
+			}
+
+			m_assemblers.emplace_back(threadIndex, ZoneTreeAssembler());
+
+			return m_assemblers.back().second;
+		}
+
+		void writeNode(const ZoneNode& node)
+		{
+			const size_t length = m_stack.size();
+
+			if (length)
+			{
+				m_stack += ';';
+			}
+
+			for (const char* s = node.name; *s; ++s)
+			{
+				// ';' separates frames and a newline ends the record
+				m_stack += (*s == ';' || *s == '\n') ? '_' : *s;
+			}
+
+			const unsigned long long self = TSCToNanosec(node.selfTicks());
+
+			if (self)
+			{
+				m_writer.write(m_stack.data(), m_stack.size());
+				m_writer.write(' ');
+				m_writer.writeUInt(self);
+				m_writer.write('\n');
+			}
+
+			for (const auto& child : node.children)
+			{
+				writeNode(child);
+			}
+
+			m_stack.resize(length);
+		}
+	};
+}
@@ -0,0 +1,202 @@
+﻿//------------------------------------------
+//	AllocationProfilerTest.cpp
+//	Copyright (c) 2014 Reputeless
+//	<reputeless@gmail.com>
+//	Distributed under the MIT license.
+//------------------------------------------
+
+# define SIV_ALLOCATION_PROFILER_IMPLEMENTATION
+# define SIV_ALLOCATION_PROFILER_HOOK_MALLOC
+# include <iostream>
+# include <cassert>
+# include <thread>
+# include <vector>
+# include <memory>
+# include <siv/AllocationProfiler.hpp>
+
+const siv::AllocationReport* Find(const std::vector<siv::AllocationReport>& reports, const std::string& zone)
+{
+	for (const auto& report : reports)
+	{
+		if (report.zone == zone)
+		{
+			return &report;
+		}
+	}
+
+	return nullptr;
+}
+
+void Churn(int n)
+{
+	SIV_PROFILE_ZONE("Churn");
+
+	for (int i = 0; i < n; ++i)
+	{
+		std::unique_ptr<char[]> p(new char[100]);
+
+		p[0] = static_cast<char>(i);
+	}
+}
+
+void ShortLived()
+{
+	SIV_PROFILE_ZONE("ShortLived");
+
+	for (int i = 0; i < 10; ++i)
+	{
+		std::unique_ptr<int> p(new int(i));
+	}
+}
+
+void Hold()
+{
+	SIV_PROFILE_ZONE("Hold");
+
+	std::vector<void*> blocks;
+
+	blocks.reserve(16);
+
+	for (int i = 0; i < 10; ++i)
+	{
+		blocks.push_back(std::malloc(1000));
+	}
+
+	{
+		SIV_PROFILE_ZONE("Inner");
+
+		std::free(std::malloc(10));
+	}
+
+	for (void* p : blocks)
+	{
+		std::free(p);
+	}
+}
+
+# if defined(__cpp_aligned_new)
+
+struct alignas(64) CacheLine
+{
+	char bytes[64];
+};
+
+void OverAligned()
+{
+	SIV_PROFILE_ZONE("OverAligned");
+
+	for (int i = 0; i < 10; ++i)
+	{
+		std::unique_ptr<CacheLine> line(new CacheLine());
+
+		assert(reinterpret_cast<std::uintptr_t>(line.get()) % 64 == 0);
+
+		std::unique_ptr<CacheLine[]> lines(new CacheLine[4]);
+	}
+}
+
+# endif
+
+int main()
+{
+	siv::ZoneHistogramSink histograms;
+
+	siv::GetZoneCollector().addSink(&histograms);
+
+	siv::SetAllocationProfiling(true);
+
+	Churn(1000);
+
+	Hold();
+
+	std::thread([] { Churn(500); }).join();
+
+	siv::SetAllocationProfiling(false);
+
+	// not counted
+	Churn(10);
+
+	siv::GetZoneCollector().collect();
+
+	const auto reports = siv::GetAllocationReports();
+
+	const siv::AllocationReport* churn = Find(reports, "Churn");
+
+	assert(churn);
+	assert(churn->allocations == 1500);
+	assert(churn->frees == 1500);
+	assert(churn->bytesAllocated >= 1500 * 100);
+	assert(churn->bytesAllocated == churn->bytesFreed);
+	assert(churn->peakBytes >= 100 && churn->peakBytes < 1000);
+
+	const siv::AllocationReport* hold = Find(reports, "Hold");
+
+	assert(hold);
+	assert(hold->allocations >= 10);
+	assert(hold->peakBytes >= 10 * 1000);
+
+	// the nested zone is attributed separately and restores its parent on exit
+	const siv::AllocationReport* inner = Find(reports, "Inner");
+
+	assert(inner);
+	assert(inner->allocations == 1);
+	assert(inner->frees == 1);
+
+	assert(siv::GetPeakHeapBytes() >= siv::GetLiveHeapBytes());
+
+	// more threads over the lifetime than tables: exited threads return theirs to the pool
+	{
+		siv::SetAllocationProfiling(true);
+
+		const int threadCount = SIV_ALLOCATION_MAX_THREADS + 44;
+
+		for (int i = 0; i < threadCount; ++i)
+		{
+			std::thread(ShortLived).join();
+		}
+
+		siv::SetAllocationProfiling(false);
+
+		const auto afterThreads = siv::GetAllocationReports();
+
+		const siv::AllocationReport* shortLived = Find(afterThreads, "ShortLived");
+
+		assert(shortLived);
+		assert(shortLived->allocations == threadCount * 10ULL);
+		assert(shortLived->frees == threadCount * 10ULL);
+
+		// exited threads are kept in the totals
+		assert(Find(afterThreads, "Churn")->allocations == 1500);
+
+		assert(siv::detail::GetAllocationProfilerState().untrackedAllocations.load() == 0);
+	}
+
+# if defined(__cpp_aligned_new)
+
+	// operator new(size_t, std::align_val_t) is counted too
+	{
+		siv::SetAllocationProfiling(true);
+
+		OverAligned();
+
+		siv::SetAllocationProfiling(false);
+
+		const auto afterAligned = siv::GetAllocationReports();
+
+		const siv::AllocationReport* aligned = Find(afterAligned, "OverAligned");
+
+		assert(aligned);
+		assert(aligned->allocations == 20);
+		assert(aligned->frees == 20);
+		assert(aligned->bytesAllocated >= 10 * 64 * 5ULL);
+		assert(aligned->bytesAllocated == aligned->bytesFreed);
+	}
+
+# endif
+
+	siv::WriteZoneReport(std::cout, histograms.getReports(), reports);
+
+	std::cout << "heap high-water: " << siv::GetPeakHeapBytes() << " bytes\n";
+
+	siv::GetZoneCollector().removeSink(&histograms);
+}
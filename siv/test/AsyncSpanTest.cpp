@@ -0,0 +1,252 @@
+﻿//------------------------------------------
+//	AsyncSpanTest.cpp
+//	Copyright (c) 2014 Reputeless
+//	<reputeless@gmail.com>
+//	Distributed under the MIT license.
+//------------------------------------------
+
+# include <iostream>
+# include <sstream>
+# include <cassert>
+# include <thread>
+# include <mutex>
+# include <deque>
+# include <vector>
+# include <string>
+# include <condition_variable>
+# include <siv/AsyncSpan.hpp>
+
+struct Task
+{
+	siv::AsyncSpan request;
+
+	siv::AsyncSpan queued;
+};
+
+class TaskQueue
+{
+public:
+
+	void push(Task&& task)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		m_tasks.push_back(std::move(task));
+
+		m_condition.notify_one();
+	}
+
+	Task pop()
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+
+		m_condition.wait(lock, [this] { return !m_tasks.empty(); });
+
+		Task task = std::move(m_tasks.front());
+
+		m_tasks.pop_front();
+
+		return task;
+	}
+
+private:
+
+	std::mutex m_mutex;
+
+	std::condition_variable m_condition;
+
+	std::deque<Task> m_tasks;
+};
+
+void SleepMillisec(int ms)
+{
+	std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+int main()
+{
+	// ids
+	{
+		siv::AsyncSpan a("a"), b("b", a.context());
+
+		assert(a.context().spanId != b.context().spanId);
+		assert(b.context().traceId == a.context().spanId);
+		assert(a.context().traceId == a.context().spanId);
+
+		siv::AsyncSpan moved(std::move(b));
+
+		assert(!b.active() && moved.active());
+	}
+
+	siv::GetSpanCollector().collect();
+
+	assert(siv::GetSpanCollector().getSpans().size() == 2);
+
+	siv::GetSpanCollector().clear();
+
+	// every collector has its own buffer on each thread
+	{
+		siv::SpanCollector other;
+
+		siv::SpanRecord record = siv::SpanRecord();
+
+		record.name = "other";
+		record.spanId = record.traceId = 1;
+
+		other.submit(record);
+
+		{
+			siv::AsyncSpan global("global");
+		}
+
+		other.collect();
+
+		siv::GetSpanCollector().collect();
+
+		assert(other.getSpans().size() == 1);
+		assert(std::string(other.getSpans()[0].name) == "other");
+
+		assert(siv::GetSpanCollector().getSpans().size() == 1);
+		assert(std::string(siv::GetSpanCollector().getSpans()[0].name) == "global");
+		assert(siv::GetSpanCollector().dropped() == 0);
+
+		siv::GetSpanCollector().clear();
+	}
+
+	// request: [queue 3ms] decode 2ms [queue 1ms] respond 1ms, over two worker threads
+	TaskQueue decodeQueue, respondQueue;
+
+	std::thread decoder([&]()
+	{
+		Task task = decodeQueue.pop();
+
+		task.queued.end();
+
+		{
+			siv::AsyncSpan decode("decode", task.request.context());
+
+			SleepMillisec(2);
+		}
+
+		task.queued = siv::AsyncSpan("respondQueue", task.request.context(), siv::SpanKind::Queue);
+
+		respondQueue.push(std::move(task));
+	});
+
+	std::thread responder([&]()
+	{
+		SleepMillisec(6);
+
+		Task task = respondQueue.pop();
+
+		task.queued.end();
+
+		{
+			siv::AsyncSpan respond("respond", task.request.context());
+
+			SleepMillisec(1);
+		}
+
+		// closed on a different thread than it was opened on
+		task.request.end();
+	});
+
+	{
+		Task task;
+
+		task.request = siv::AsyncSpan("request");
+
+		task.queued = siv::AsyncSpan("decodeQueue", task.request.context(), siv::SpanKind::Queue);
+
+		SleepMillisec(3);
+
+		decodeQueue.push(std::move(task));
+	}
+
+	decoder.join();
+
+	responder.join();
+
+	siv::GetSpanCollector().collect();
+
+	const auto spans = siv::GetSpanCollector().getSpans();
+
+	assert(spans.size() == 5);
+
+	const auto paths = siv::ComputeCriticalPaths(spans);
+
+	assert(paths.size() == 1);
+
+	const siv::CriticalPath& path = paths[0];
+
+	siv::WriteCriticalPath(std::cout, path);
+
+	assert(std::string(path.name) == "request");
+
+	// the gaps between stages are the request's own time
+	std::vector<std::string> stages;
+
+	for (const auto& segment : path.segments)
+	{
+		if (std::string(segment.name) != "request")
+		{
+			stages.push_back(segment.name);
+		}
+	}
+
+	assert((stages == std::vector<std::string>{ "decodeQueue", "decode", "respondQueue", "respond" }));
+
+	// 3ms in the first queue, about 1ms in the second
+	assert(path.queueNanosec >= 3500000ULL);
+	assert(path.totalNanosec >= path.queueNanosec + 3000000ULL);
+
+	for (const auto& span : spans)
+	{
+		if (std::string(span.name) == "request")
+		{
+			assert(span.beginThread != span.endThread);
+		}
+
+		// no thread here opened a zone
+		assert(span.beginThread >= siv::detail::SpanOnlyThreadBase);
+	}
+
+	// span-only threads are not registered with the zone collector
+	siv::GetZoneCollector().collect();
+
+	assert(siv::GetZoneCollector().getCallTrees().empty());
+
+	// many traces: one critical path each
+	{
+		std::vector<siv::SpanRecord> many;
+
+		const int traceCount = 5000;
+
+		for (int t = 0; t < traceCount; ++t)
+		{
+			const std::uint64_t root = 1 + t * 3ULL;
+
+			const unsigned long long base = t * 100ULL;
+
+			many.push_back(siv::SpanRecord{ "root", root, root, 0, base, base + 90, 0, 0, siv::SpanKind::Work });
+			many.push_back(siv::SpanRecord{ "queue", root, root + 1, root, base + 10, base + 40, 0, 0, siv::SpanKind::Queue });
+			many.push_back(siv::SpanRecord{ "work", root, root + 2, root, base + 40, base + 80, 0, 0, siv::SpanKind::Work });
+		}
+
+		const auto manyPaths = siv::ComputeCriticalPaths(many);
+
+		assert(manyPaths.size() == traceCount);
+
+		for (const auto& p : manyPaths)
+		{
+			// root 10, queue 30, work 40, root 10
+			assert(p.segments.size() == 4);
+		}
+	}
+
+	std::ostringstream json;
+
+	siv::WriteSpanChromeTrace(json, spans);
+
+	assert(json.str().find("\"ph\":\"b\",\"cat\":\"request\",\"name\":\"decode\"") != std::string::npos);
+}
@@ -0,0 +1,211 @@
+﻿//------------------------------------------
+//	BenchmarkTest.cpp
+//	Copyright (c) 2014 Reputeless
+//	<reputeless@gmail.com>
+//	Distributed under the MIT license.
+//------------------------------------------
+
+# include <iostream>
+# include <sstream>
+# include <cassert>
+# include <siv/Benchmark.hpp>
+# include <siv/Optional.hpp>
+
+SIV_BENCHMARK(Empty)
+{
+	while (state.keepRunning())
+	{
+		siv::ClobberMemory();
+	}
+}
+
+SIV_BENCHMARK(OptionalValueOr)
+{
+	siv::optional<int> oi;
+
+	while (state.keepRunning())
+	{
+		siv::DoNotOptimize(oi);
+
+		siv::DoNotOptimize(oi.value_or(1));
+	}
+}
+
+SIV_BENCHMARK(Sum1000)
+{
+	int values[1000];
+
+	for (int i = 0; i < 1000; ++i)
+	{
+		values[i] = i;
+	}
+
+	while (state.keepRunning())
+	{
+		int sum = 0;
+
+		for (int i = 0; i < 1000; ++i)
+		{
+			sum += values[i];
+		}
+
+		siv::DoNotOptimize(sum);
+	}
+}
+
+int main()
+{
+	// statistics and outlier rejection
+	{
+		siv::BenchmarkResult r;
+
+		r.samples = { 10.0, 11.0, 9.0, 10.0, 10.5, 9.5, 1000.0 };
+
+		siv::ComputeBenchmarkStatistics(r, 3.0);
+
+		assert(r.outliers == 1);
+		assert(r.median == 10.0);
+		assert(r.max == 11.0);
+		assert(r.min == 9.0);
+		assert(r.mad > 0.0 && r.mad < 2.0);
+	}
+
+	siv::BenchmarkOptions options;
+
+	options.warmupMillisec = 10;
+	options.minMillisec = 50;
+	options.sampleCount = 10;
+
+	const auto results = siv::RunBenchmarks(options, &std::cout);
+
+	assert(results.size() == 3);
+
+	for (const auto& r : results)
+	{
+		assert(r.samples.size() == 10);
+		assert(r.iterationsPerSample >= 1);
+		assert(r.min <= r.median && r.median <= r.max);
+	}
+
+	assert(results[2].name == "Sum1000");
+	assert(results[2].median > results[0].median);
+
+	std::ostringstream json;
+
+	siv::WriteBenchmarkJSON(json, results);
+
+	std::cout << json.str();
+
+	assert(json.str().find("\"name\": \"OptionalValueOr\"") != std::string::npos);
+	assert(json.str().find("\"samples\": [") != std::string::npos);
+
+	// baseline round trip
+	std::vector<siv::BenchmarkResult> loaded;
+
+	std::istringstream is(json.str());
+
+	const bool read = siv::ReadBenchmarkJSON(is, loaded);
+
+	assert(read);
+	assert(loaded.size() == results.size());
+	assert(loaded[2].name == "Sum1000");
+	assert(loaded[2].samples.size() == 10);
+	assert(std::fabs(loaded[2].median - results[2].median) <= 1e-5 * results[2].median);
+
+	// Mann-Whitney U
+	{
+		const std::vector<double> a = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10 };
+		const std::vector<double> b = { 11, 12, 13, 14, 15, 16, 17, 18, 19, 20 };
+
+		const auto separated = siv::MannWhitneyU(a, b);
+
+		assert(separated.u == 0.0);
+		assert(separated.pValue < 0.001);
+
+		const auto same = siv::MannWhitneyU(a, a);
+
+		assert(same.pValue > 0.9);
+	}
+
+	// a 3% slowdown in noisy samples is detected; the same data is not
+	{
+		siv::BenchmarkResult before, after;
+
+		before.name = after.name = "Noisy";
+
+		for (int i = 0; i < 30; ++i)
+		{
+			const double noise = ((i * 7919) % 31 - 15) * 0.05;
+
+			before.samples.push_back(100.0 + noise);
+
+			after.samples.push_back(103.0 + noise);
+		}
+
+		siv::ComputeBenchmarkStatistics(before, 3.0);
+
+		siv::ComputeBenchmarkStatistics(after, 3.0);
+
+		siv::BenchmarkComparisonOptions strict;
+
+		strict.thresholdPercent = 2.0;
+
+		const auto slower = siv::CompareBenchmarks({ before }, { after }, strict);
+
+		assert(slower.size() == 1);
+		assert(slower[0].significant);
+		assert(slower[0].regression);
+		assert(slower[0].changeLow < 3.0 && 3.0 < slower[0].changeHigh + 1e-9);
+
+		const auto unchanged = siv::CompareBenchmarks({ before }, { before }, strict);
+
+		assert(!unchanged[0].significant);
+		assert(!siv::HasBenchmarkRegression(unchanged));
+
+		// a slowdown below the threshold is reported but does not fail
+		siv::BenchmarkComparisonOptions lenient;
+
+		lenient.thresholdPercent = 5.0;
+
+		assert(!siv::HasBenchmarkRegression(siv::CompareBenchmarks({ before }, { after }, lenient)));
+
+		siv::WriteBenchmarkComparison(std::cout, slower);
+	}
+
+	// the interval bounds are the k-th smallest and largest differences, k 1-based
+	{
+		siv::BenchmarkResult before, after;
+
+		before.name = after.name = "Steps";
+
+		for (int i = 0; i < 10; ++i)
+		{
+			before.samples.push_back(100.0 + i);
+
+			after.samples.push_back(100.0 + 10 * i);
+		}
+
+		siv::ComputeBenchmarkStatistics(before, 3.0);
+
+		siv::ComputeBenchmarkStatistics(after, 3.0);
+
+		std::vector<double> differences;
+
+		for (double x : after.samples)
+		{
+			for (double y : before.samples)
+			{
+				differences.push_back(x - y);
+			}
+		}
+
+		std::sort(differences.begin(), differences.end());
+
+		// n1 = n2 = 10, alpha = 0.05: k = floor(50 - 1.96 * sqrt(175)) = 24
+		const auto steps = siv::CompareBenchmarks({ before }, { after });
+
+		assert(steps.size() == 1);
+		assert(std::fabs(steps[0].changeLow - 100.0 * differences[23] / before.median) < 1e-9);
+		assert(std::fabs(steps[0].changeHigh - 100.0 * differences[76] / before.median) < 1e-9);
+	}
+}
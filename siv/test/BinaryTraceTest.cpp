@@ -0,0 +1,231 @@
+﻿//------------------------------------------
+//	BinaryTraceTest.cpp
+//	Copyright (c) 2014 Reputeless
+//	<reputeless@gmail.com>
+//	Distributed under the MIT license.
+//------------------------------------------
+
+# include <iostream>
+# include <sstream>
+# include <cassert>
+# include <cstdio>
+# include <string>
+# include <vector>
+# include <siv/BinaryTrace.hpp>
+
+class CapturingSink : public siv::ZoneSink
+{
+public:
+
+	std::vector<std::pair<unsigned, siv::ZoneRecord>> records;
+
+	void onZoneRecords(unsigned threadIndex, const siv::ZoneRecord* r, size_t count) override
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			records.emplace_back(threadIndex, r[i]);
+		}
+	}
+};
+
+void Work()
+{
+	SIV_PROFILE_ZONE("Work");
+
+	{
+		SIV_PROFILE_ZONE("Inner");
+	}
+}
+
+int main()
+{
+	const std::string basePath = "BinaryTraceTest";
+
+	// round trip, including deltas and durations that do not fit in 32 bits
+	{
+		{
+			siv::BinaryTraceWriter writer(basePath, 1024 * 1024, 2);
+
+			assert(writer.isOpen());
+
+			const siv::ZoneRecord t0[] =
+			{
+				{ "Inner", 1000, 1500, 1 },
+				{ "Outer", 900, 2000, 0 },
+				{ "Long", 2000, 2000 + (1ULL << 36), 0 },
+				{ "Inner", (1ULL << 40), (1ULL << 40) + 7, 0 },
+			};
+
+			const siv::ZoneRecord t1[] =
+			{
+				{ "Outer", 5000, 6000, 0 },
+			};
+
+			writer.onZoneRecords(0, t0, 4);
+
+			writer.onZoneRecords(3, t1, 1);
+
+			assert(writer.dropped() == 0);
+		}
+
+		siv::BinaryTraceReader reader(basePath);
+
+		assert(reader.isOpen());
+
+		CapturingSink sink;
+
+		assert(reader.replay(sink) == 5);
+
+		assert(sink.records.size() == 5);
+
+		assert(sink.records[0].first == 0);
+		assert(std::string(sink.records[0].second.name) == "Inner");
+		assert(sink.records[0].second.end - sink.records[0].second.begin == 500);
+		assert(sink.records[0].second.depth == 1);
+
+		assert(sink.records[1].second.end - sink.records[1].second.begin == 1100);
+		assert(sink.records[2].second.end - sink.records[2].second.begin == (1ULL << 36));
+		assert(sink.records[3].second.end == (1ULL << 40) + 7);
+
+		// equal names share one pointer
+		assert(sink.records[0].second.name == sink.records[3].second.name);
+
+		assert(sink.records[4].first == 3);
+		assert(sink.records[4].second.end == 6000);
+
+		assert(reader.baseTicks() == 900);
+	}
+
+	// rotation keeps at most fileCount files and every file decodes on its own
+	{
+		{
+			siv::BinaryTraceWriter writer(basePath, 64 * 1024, 3);
+
+			std::vector<siv::ZoneRecord> records;
+
+			for (unsigned long long i = 0; i < 100000; ++i)
+			{
+				records.push_back(siv::ZoneRecord{ (i % 2) ? "A" : "B", i * 10, i * 10 + 5, 0 });
+			}
+
+			writer.onZoneRecords(1, records.data(), records.size());
+
+			assert(writer.recordCount() > 100000);
+		}
+
+		siv::BinaryTraceReader reader(basePath);
+
+		assert(reader.fileCount() == 3);
+
+		CapturingSink sink;
+
+		const unsigned long long count = reader.replay(sink);
+
+		// two full files of 4092 records (minus the names and timestamp at the start of each) and the partial newest one
+		assert(count > 2 * 4000 && count < 3 * 4092);
+
+		// the newest zones survive, in order
+		assert(sink.records.back().second.end == 999995);
+
+		for (size_t i = 1; i < sink.records.size(); ++i)
+		{
+			assert(sink.records[i].second.end == sink.records[i - 1].second.end + 10);
+		}
+	}
+
+	// more names than a file can repeat: the overflow is dropped instead of rotating forever
+	{
+		std::vector<std::string> names;
+
+		for (int i = 0; i < 2000; ++i)
+		{
+			names.push_back(std::string(44, 'z') + std::to_string(1000 + i));
+		}
+
+		unsigned long long dropped = 0;
+
+		{
+			siv::BinaryTraceWriter writer(basePath, 64 * 1024, 3);
+
+			std::vector<siv::ZoneRecord> records;
+
+			for (unsigned long long i = 0; i < names.size(); ++i)
+			{
+				records.push_back(siv::ZoneRecord{ names[i].c_str(), i * 10, i * 10 + 5, 0 });
+			}
+
+			writer.onZoneRecords(0, records.data(), records.size());
+
+			dropped = writer.dropped();
+
+			// 48-character names take 4 records each; at most half of a 4092-record file is names
+			assert(dropped > 0 && dropped < names.size());
+			assert(names.size() - dropped <= 4092 / 2 / 4);
+		}
+
+		siv::BinaryTraceReader reader(basePath);
+
+		CapturingSink sink;
+
+		assert(reader.replay(sink) == names.size() - dropped);
+
+		assert(std::string(sink.records.front().second.name) == names.front());
+	}
+
+	// live capture through the collector, decoded to the usual formats
+	{
+		{
+			siv::BinaryTraceWriter writer(basePath, 1024 * 1024, 2);
+
+			siv::GetZoneCollector().addSink(&writer);
+
+			for (int i = 0; i < 1000; ++i)
+			{
+				Work();
+			}
+
+			siv::GetZoneCollector().collect();
+
+			siv::GetZoneCollector().removeSink(&writer);
+		}
+
+		siv::BinaryTraceReader reader(basePath);
+
+		siv::ZoneHistogramSink histograms;
+
+		assert(reader.replay(histograms) == 2000);
+
+		const auto reports = histograms.getReports();
+
+		assert(reports.size() == 2);
+
+		siv::WriteLatencyReports(std::cout, reports);
+
+		std::ostringstream chrome;
+
+		{
+			siv::ChromeTraceWriter writer(chrome, 1, reader.baseTicks());
+
+			reader.replay(writer);
+		}
+
+		assert(chrome.str().find("\"name\":\"Inner\"") != std::string::npos);
+
+		std::ostringstream collapsed;
+
+		{
+			siv::CollapsedStackWriter writer(collapsed);
+
+			reader.replay(writer);
+
+			writer.flush();
+		}
+
+		assert(collapsed.str().find("Work;Inner ") != std::string::npos);
+	}
+
+	for (unsigned i = 0; i < 3; ++i)
+	{
+		std::remove(siv::detail::BinaryTracePath(basePath, i).c_str());
+	}
+}
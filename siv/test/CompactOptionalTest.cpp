@@ -0,0 +1,148 @@
+﻿//------------------------------------------
+//	CompactOptionalTest.cpp
+//	Copyright (c) 2014 Reputeless
+//	<reputeless@gmail.com>
+//	Distributed under the MIT license.
+//------------------------------------------
+
+# include <iostream>
+# include <cassert>
+# include <cmath>
+# include <vector>
+# include <unordered_set>
+# include <siv/CompactOptional.hpp>
+
+int main()
+{
+	static_assert(sizeof(siv::compact_optional<double>) == sizeof(double), "");
+	static_assert(sizeof(siv::compact_optional<float>) == sizeof(float), "");
+	static_assert(sizeof(siv::compact_optional<int, siv::index_policy<int>>) == sizeof(int), "");
+	static_assert(sizeof(siv::compact_optional<const char*>) == sizeof(const char*), "");
+	static_assert(siv::detail::is_trivially_copyable<siv::compact_optional<double>>::value, "");
+
+	// NaN payload
+	{
+		siv::compact_optional<double> od;
+
+		assert(!od);
+		assert(od == siv::nullopt);
+		assert(od.value_or(1.5) == 1.5);
+		assert(std::isnan(od.raw()));
+
+		od = 2.5;
+
+		assert(od);
+		assert(*od == 2.5);
+		assert(od.value() == 2.5);
+		assert(od == 2.5);
+
+		// other NaNs are values
+		od = std::nan("");
+
+		assert(od);
+		assert(std::isnan(*od));
+
+		od = siv::nullopt;
+
+		// negation keeps emptiness; float/double conversion does not
+		assert(siv::nan_policy<double>::is_empty(-od.raw()));
+		assert(!siv::nan_policy<float>::is_empty(static_cast<float>(od.raw())));
+		assert(!siv::nan_policy<double>::is_empty(static_cast<double>(siv::nan_policy<float>::empty_value())));
+
+		try
+		{
+			od.value();
+
+			assert(false);
+		}
+		catch (const siv::bad_optional_access&)
+		{
+
+		}
+
+		siv::compact_optional<float> of = 1.0f;
+
+		assert(of == 1.0f);
+	}
+
+	// index and user-specified sentinels
+	{
+		siv::compact_optional<unsigned, siv::index_policy<unsigned>> index;
+
+		assert(!index);
+		assert(index.raw() == 0xFFFFFFFFu);
+
+		index = 0u;
+
+		assert(index && *index == 0u);
+
+		siv::compact_optional<int, siv::sentinel_policy<int, 0>> id = 7;
+
+		assert(id == 7);
+
+		id.emplace(8);
+
+		assert(id.value_or(0) == 8);
+
+		id = siv::nullopt;
+
+		assert(!id && id.raw() == 0);
+	}
+
+	// pointers
+	{
+		const char* text = "text";
+
+		siv::compact_optional<const char*> op;
+
+		assert(!op);
+
+		op = text;
+
+		assert(op && *op == text);
+	}
+
+	// relational operators, conversion from and to optional
+	{
+		typedef siv::compact_optional<int, siv::index_policy<int>> CompactInt;
+
+		const CompactInt oN, o0 = 0, o1 = 1;
+
+		assert(oN < o0 && o0 < o1 && !(o1 < oN));
+		assert(oN == CompactInt() && o0 != o1);
+
+		const CompactInt fromOptional = siv::optional<int>(5);
+
+		assert(fromOptional == 5);
+		assert(fromOptional.to_optional() == 5);
+		assert(!CompactInt(siv::optional<int>()));
+		assert(!oN.to_optional());
+
+		std::unordered_set<CompactInt> set;
+
+		set.insert(o1);
+
+		assert(set.count(o1) == 1 && set.count(o0) == 0);
+	}
+
+	// table of compact values: half the size of optional<double>
+	{
+		std::vector<siv::compact_optional<double>> table(1000);
+
+		for (size_t i = 0; i < table.size(); i += 3)
+		{
+			table[i] = static_cast<double>(i);
+		}
+
+		double sum = 0.0;
+
+		for (const auto& v : table)
+		{
+			sum += v.value_or(0.0);
+		}
+
+		assert(sum == 166833.0);
+
+		std::cout << sizeof(siv::optional<double>) << " -> " << sizeof(siv::compact_optional<double>) << " bytes\n";
+	}
+}
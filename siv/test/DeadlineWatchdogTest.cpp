@@ -0,0 +1,121 @@
+﻿//------------------------------------------
+//	DeadlineWatchdogTest.cpp
+//	Copyright (c) 2014 Reputeless
+//	<reputeless@gmail.com>
+//	Distributed under the MIT license.
+//------------------------------------------
+
+# include <iostream>
+# include <cassert>
+# include <string>
+# include <thread>
+# include <siv/DeadlineWatchdog.hpp>
+
+void Parse()
+{
+	SIV_PROFILE_ZONE("Parse");
+}
+
+void Stall()
+{
+	SIV_PROFILE_ZONE("Stall");
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+}
+
+void HandleRequest(bool stall)
+{
+	SIV_DEADLINE_SCOPE("request", 5000);
+
+	SIV_PROFILE_ZONE("HandleRequest");
+
+	for (int i = 0; i < 3; ++i)
+	{
+		Parse();
+	}
+
+	if (stall)
+	{
+		Stall();
+	}
+}
+
+int main()
+{
+	siv::DeadlineWatchdog& watchdog = siv::GetDeadlineWatchdog();
+
+	watchdog.start(std::chrono::milliseconds(1));
+
+	// within budget
+	for (int i = 0; i < 10; ++i)
+	{
+		HandleRequest(false);
+	}
+
+	// one stall, on another thread
+	std::thread([]() { HandleRequest(true); }).join();
+
+	HandleRequest(false);
+
+	watchdog.stop();
+
+	assert(watchdog.missedCount() == 1);
+	assert(watchdog.violationCount() == 1);
+
+	const auto violations = watchdog.getViolations();
+
+	assert(violations.size() == 1);
+
+	const siv::DeadlineViolation& v = violations[0];
+
+	siv::WriteDeadlineViolation(std::cout, v);
+
+	assert(std::string(v.name) == "request");
+	assert(v.budgetMicrosec == 5000);
+	assert(v.elapsedMicrosec > 5000);
+	assert(v.threadIndex != siv::GetThreadZoneBuffer().threadIndex());
+
+	// caught inside the stall
+	assert(v.zoneCount == 2);
+	assert(std::string(v.zones[0]) == "HandleRequest");
+	assert(std::string(v.zones[1]) == "Stall");
+
+	assert(v.eventCount == 3);
+	assert(std::string(v.events[2].name) == "Parse");
+
+	// the watchdog reports only late scopes that are still open
+	{
+		SIV_DEADLINE_SCOPE("late", 1000);
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(3));
+	}
+
+	watchdog.check();
+
+	assert(watchdog.missedCount() == 2);
+	assert(watchdog.violationCount() == 1);
+
+	// nested scopes: the innermost is watched
+	{
+		SIV_DEADLINE_SCOPE("outer", 100000);
+
+		{
+			SIV_DEADLINE_SCOPE("inner", 1000);
+
+			std::this_thread::sleep_for(std::chrono::milliseconds(3));
+
+			watchdog.check();
+
+			watchdog.check();
+		}
+
+		watchdog.check();
+	}
+
+	assert(watchdog.violationCount() == 2);
+	assert(std::string(watchdog.getViolations().back().name) == "inner");
+
+	watchdog.clear();
+
+	assert(watchdog.getViolations().empty());
+}
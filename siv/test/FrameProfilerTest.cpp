@@ -0,0 +1,146 @@
+﻿//------------------------------------------
+//	FrameProfilerTest.cpp
+//	Copyright (c) 2014 Reputeless
+//	<reputeless@gmail.com>
+//	Distributed under the MIT license.
+//------------------------------------------
+
+# include <iostream>
+# include <cassert>
+# include <thread>
+# include <siv/FrameProfiler.hpp>
+
+void SleepMicrosec(int us)
+{
+	std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+int main()
+{
+	// 20ms budget, keep 50 frames
+	siv::FrameProfiler profiler(20000, 50, 64, 4);
+
+	size_t callbacks = 0;
+
+	profiler.setOverrunCallback([&callbacks](const siv::FrameRecord& frame)
+	{
+		++callbacks;
+
+		siv::WriteFrameSnapshot(std::cout, frame);
+	});
+
+	for (int i = 0; i < 100; ++i)
+	{
+		profiler.markFrame();
+
+		{
+			SIV_FRAME_ZONE(profiler, "Update");
+
+			{
+				SIV_FRAME_ZONE(profiler, "Physics");
+
+				SleepMicrosec(i == 77 ? 30000 : 100);
+			}
+
+			{
+				SIV_FRAME_ZONE(profiler, "AI");
+
+				SleepMicrosec(100);
+			}
+		}
+
+		{
+			SIV_FRAME_ZONE(profiler, "Render");
+
+			SleepMicrosec(100);
+		}
+	}
+
+	profiler.endFrame();
+
+	assert(profiler.frameCount() == 100);
+
+	const auto history = profiler.getHistory();
+
+	assert(history.size() == 50);
+	assert(history.front().index == 50);
+	assert(history.back().index == 99);
+
+	for (const auto& frame : history)
+	{
+		assert(frame.zones.size() == 4);
+		assert(!frame.truncated);
+	}
+
+	// the 1-in-100 stall is the only overrun, captured with its zone tree
+	assert(profiler.overrunCount() == 1);
+	assert(callbacks == 1);
+
+	const auto overruns = profiler.getOverruns();
+
+	assert(overruns.size() == 1);
+	assert(overruns[0].index == 77);
+
+	const siv::FrameZoneNode tree = siv::BuildFrameZoneTree(overruns[0]);
+
+	assert(tree.children.size() == 2);
+	assert(std::strcmp(tree.children[0].name, "Update") == 0);
+	assert(tree.children[0].children.size() == 2);
+	assert(std::strcmp(tree.children[0].children[0].name, "Physics") == 0);
+	assert(tree.children[0].children[0].duration >= 30000);
+
+	const auto breakdown = siv::MakeFrameBreakdown(overruns[0]);
+
+	assert(breakdown.front().first == "Physics");
+
+	for (const auto& entry : breakdown)
+	{
+		std::cout << entry.first << '\t' << entry.second << "us\n";
+	}
+
+	// a zone open across a frame mark is split between the two frames
+	{
+		siv::FrameProfiler straddle(20000);
+
+		straddle.beginFrame();
+
+		{
+			SIV_FRAME_ZONE(straddle, "Stream");
+
+			SleepMicrosec(2000);
+
+			straddle.markFrame();
+
+			{
+				SIV_FRAME_ZONE(straddle, "Decode");
+
+				SleepMicrosec(3000);
+			}
+		}
+
+		straddle.endFrame();
+
+		const auto frames = straddle.getHistory();
+
+		assert(frames.size() == 2);
+
+		assert(frames[0].zones.size() == 1);
+		assert(std::strcmp(frames[0].zones[0].name, "Stream") == 0);
+		assert(frames[0].zones[0].end - frames[0].zones[0].begin >= 2000);
+		assert(frames[0].zones[0].end <= frames[0].begin + frames[0].duration);
+
+		assert(frames[1].zones.size() == 2);
+		assert(std::strcmp(frames[1].zones[0].name, "Stream") == 0);
+		assert(frames[1].zones[0].begin == frames[1].begin);
+		assert(frames[1].zones[0].depth == 0);
+		assert(std::strcmp(frames[1].zones[1].name, "Decode") == 0);
+		assert(frames[1].zones[1].depth == 1);
+		assert(frames[1].zones[0].end >= frames[1].zones[1].end);
+		assert(frames[1].zones[1].end - frames[1].zones[1].begin >= 3000);
+
+		const siv::FrameZoneNode tree = siv::BuildFrameZoneTree(frames[1]);
+
+		assert(tree.children.size() == 1);
+		assert(tree.children[0].children.size() == 1);
+	}
+}
@@ -0,0 +1,130 @@
+﻿//------------------------------------------
+//	LatencyHistogramTest.cpp
+//	Copyright (c) 2014 Reputeless
+//	<reputeless@gmail.com>
+//	Distributed under the MIT license.
+//------------------------------------------
+
+# include <iostream>
+# include <cassert>
+# include <thread>
+# include <vector>
+# include <siv/LatencyHistogram.hpp>
+
+bool Near(unsigned long long value, unsigned long long expected)
+{
+	const double error = (static_cast<double>(value) - expected) / expected;
+
+	return -0.02 < error && error < 0.02;
+}
+
+void Work(int n)
+{
+	SIV_PROFILE_ZONE("Work");
+
+	volatile int sink = 0;
+
+	for (int i = 0; i < n; ++i)
+	{
+		sink = sink + i;
+	}
+}
+
+int main()
+{
+	// bucket layout
+	{
+		for (unsigned long long v = 0; v < 1000000; v += 7)
+		{
+			const size_t index = siv::LatencyHistogram::BucketIndex(v);
+
+			assert(index < siv::LatencyHistogram::BucketCount);
+			assert(siv::LatencyHistogram::BucketUpperBound(index) >= v);
+			assert(index == 0 || siv::LatencyHistogram::BucketUpperBound(index - 1) < v);
+		}
+
+		assert(siv::LatencyHistogram::BucketIndex(~0ULL) == siv::LatencyHistogram::BucketCount - 1);
+	}
+
+	// percentiles
+	{
+		siv::LatencyHistogram h;
+
+		for (unsigned long long v = 1; v <= 100000; ++v)
+		{
+			h.record(v);
+		}
+
+		assert(h.count() == 100000);
+		assert(h.min() == 1);
+		assert(h.max() == 100000);
+		assert(Near(h.percentile(0.5), 50000));
+		assert(Near(h.percentile(0.9), 90000));
+		assert(Near(h.percentile(0.99), 99000));
+		assert(Near(h.percentile(0.999), 99900));
+		assert(h.percentile(1.0) == 100000);
+	}
+
+	// merge
+	{
+		siv::LatencyHistogram a, b;
+
+		for (int i = 0; i < 990; ++i)
+		{
+			a.record(1000);
+		}
+
+		for (int i = 0; i < 10; ++i)
+		{
+			b.record(1000000);
+		}
+
+		a.merge(b);
+
+		assert(a.count() == 1000);
+		assert(Near(a.percentile(0.5), 1000));
+		assert(Near(a.percentile(0.995), 1000000));
+		assert(a.max() == 1000000);
+	}
+
+	// zone aggregation
+	{
+		siv::ZoneHistogramSink histograms;
+
+		siv::ZoneCollector& collector = siv::GetZoneCollector();
+
+		collector.addSink(&histograms);
+
+		std::vector<std::thread> threads;
+
+		for (int t = 0; t < 4; ++t)
+		{
+			threads.emplace_back([]()
+			{
+				for (int i = 0; i < 1000; ++i)
+				{
+					Work(i % 100 == 0 ? 100000 : 1000);
+				}
+			});
+		}
+
+		for (auto& thread : threads)
+		{
+			thread.join();
+		}
+
+		collector.collect();
+
+		collector.removeSink(&histograms);
+
+		const auto reports = histograms.getReports();
+
+		assert(reports.size() == 1);
+		assert(reports[0].name == "Work");
+		assert(reports[0].count == 4000);
+		assert(reports[0].p50 <= reports[0].p99);
+		assert(reports[0].p99 <= reports[0].max);
+
+		siv::WriteLatencyReports(std::cout, reports);
+	}
+}
@@ -0,0 +1,182 @@
+﻿//------------------------------------------
+//	LockProfilerTest.cpp
+//	Copyright (c) 2014 Reputeless
+//	<reputeless@gmail.com>
+//	Distributed under the MIT license.
+//------------------------------------------
+
+# include <iostream>
+# include <cassert>
+# include <thread>
+# include <vector>
+# include <siv/LockProfiler.hpp>
+# include <siv/LatencyHistogram.hpp>
+
+const siv::LockReport* Find(const std::vector<siv::LockReport>& reports, const std::string& name)
+{
+	for (const auto& report : reports)
+	{
+		if (report.name == name)
+		{
+			return &report;
+		}
+	}
+
+	return nullptr;
+}
+
+int main()
+{
+	siv::ZoneHistogramSink histograms;
+
+	siv::GetZoneCollector().addSink(&histograms);
+
+	// one hot lock, one private lock
+	{
+		siv::ProfiledMutex hot("hot");
+
+		std::vector<std::thread> threads;
+
+		for (int t = 0; t < 4; ++t)
+		{
+			threads.emplace_back([&hot]()
+			{
+				siv::ProfiledMutex cold("cold");
+
+				for (int i = 0; i < 20; ++i)
+				{
+					{
+						std::lock_guard<siv::ProfiledMutex> lock(cold);
+					}
+
+					std::lock_guard<siv::ProfiledMutex> lock(hot);
+
+					std::this_thread::sleep_for(std::chrono::microseconds(200));
+				}
+			});
+		}
+
+		for (auto& thread : threads)
+		{
+			thread.join();
+		}
+
+		const siv::LockReport report = hot.report();
+
+		assert(report.acquisitions == 80);
+		assert(report.contentions > 0);
+		assert(report.holdNanosec >= 80 * 200000ULL);
+		assert(report.maxHoldNanosec >= 200000ULL);
+		assert(report.waitNanosec >= report.maxWaitNanosec);
+	}
+
+	// destroyed locks are kept by name; the hot lock is reported first
+	{
+		const auto reports = siv::GetLockReports();
+
+		const siv::LockReport* hot = Find(reports, "hot");
+
+		const siv::LockReport* cold = Find(reports, "cold");
+
+		assert(hot && cold);
+		assert(cold->acquisitions == 80);
+		assert(cold->contentions == 0);
+		assert(reports.front().name == "hot");
+
+		siv::WriteLockReports(std::cout, reports);
+	}
+
+	// condition variable
+	{
+		siv::ProfiledMutex mutex("queue");
+
+		siv::ProfiledConditionVariable condition("queueNotEmpty");
+
+		std::vector<int> queue;
+
+		std::thread consumer([&]()
+		{
+			for (int received = 0; received < 10;)
+			{
+				std::unique_lock<siv::ProfiledMutex> lock(mutex);
+
+				condition.wait(lock, [&] { return !queue.empty(); });
+
+				received += static_cast<int>(queue.size());
+
+				queue.clear();
+			}
+
+			std::unique_lock<siv::ProfiledMutex> lock(mutex);
+
+			assert(!condition.wait_for(lock, std::chrono::milliseconds(1), [] { return false; }));
+		});
+
+		for (int i = 0; i < 10; ++i)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+			std::lock_guard<siv::ProfiledMutex> lock(mutex);
+
+			queue.push_back(i);
+
+			condition.notify_one();
+		}
+
+		consumer.join();
+
+		assert(mutex.report().acquisitions >= 11);
+	}
+
+# if SIV_HAS_SHARED_MUTEX
+
+	{
+		siv::ProfiledSharedMutex shared("table");
+
+		std::vector<std::thread> readers;
+
+		for (int t = 0; t < 4; ++t)
+		{
+			readers.emplace_back([&shared]()
+			{
+				for (int i = 0; i < 100; ++i)
+				{
+					std::shared_lock<siv::ProfiledSharedMutex> lock(shared);
+				}
+			});
+		}
+
+		{
+			std::lock_guard<siv::ProfiledSharedMutex> lock(shared);
+		}
+
+		for (auto& reader : readers)
+		{
+			reader.join();
+		}
+
+		assert(shared.report().acquisitions == 401);
+	}
+
+# endif
+
+	// waits and holds feed the zone histograms
+	siv::GetZoneCollector().collect();
+
+	const auto latencies = histograms.getReports();
+
+	bool hold = false, wait = false;
+
+	for (const auto& l : latencies)
+	{
+		hold |= (l.name == "hot.hold" && l.count == 80);
+
+		wait |= (l.name == "queueNotEmpty.wait");
+	}
+
+	assert(hold && wait);
+
+	siv::WriteLatencyReports(std::cout, latencies);
+
+	siv::GetZoneCollector().removeSink(&histograms);
+}
@@ -0,0 +1,107 @@
+﻿//------------------------------------------
+//	MetricsTest.cpp
+//	Copyright (c) 2014 Reputeless
+//	<reputeless@gmail.com>
+//	Distributed under the MIT license.
+//------------------------------------------
+
+# include <iostream>
+# include <sstream>
+# include <cassert>
+# include <thread>
+# include <vector>
+# include <siv/Metrics.hpp>
+
+int main()
+{
+	static_assert(sizeof(siv::detail::MetricShard) == 64, "one slot per cache line");
+
+	assert(reinterpret_cast<std::uintptr_t>(&siv::GetMetricsRegistry().counter("requests")) % 64 == 0);
+
+	// concurrent increments are all counted
+	{
+		std::vector<std::thread> threads;
+
+		for (int t = 0; t < 8; ++t)
+		{
+			threads.emplace_back([]()
+			{
+				for (int i = 0; i < 100000; ++i)
+				{
+					SIV_METRIC_COUNTER("requests").increment();
+
+					SIV_METRIC_RATE("events").mark();
+				}
+
+				SIV_METRIC_GAUGE("inFlight").add(3);
+
+				SIV_METRIC_GAUGE("inFlight").sub(1);
+			});
+		}
+
+		for (auto& thread : threads)
+		{
+			thread.join();
+		}
+
+		assert(siv::GetMetricsRegistry().counter("requests").value() == 800000);
+		assert(siv::GetMetricsRegistry().rate("events").count() == 800000);
+		assert(siv::GetMetricsRegistry().gauge("inFlight").value() == 16);
+	}
+
+	// the same name is the same metric
+	assert(&siv::GetMetricsRegistry().counter("requests") == &SIV_METRIC_COUNTER("requests"));
+
+	siv::GetMetricsRegistry().gauge("inFlight").set(5);
+
+	assert(siv::GetMetricsRegistry().gauge("inFlight").value() == 5);
+
+	// snapshots
+	{
+		const siv::MetricsSnapshot first = siv::GetMetricsRegistry().snapshot();
+
+		assert(first.metrics.size() == 3);
+
+		SIV_METRIC_RATE("events").mark(1000);
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+		const siv::MetricsSnapshot second = siv::GetMetricsRegistry().snapshot();
+
+		for (const auto& m : second.metrics)
+		{
+			if (m.type == siv::MetricType::Rate)
+			{
+				// 1000 events in about 20ms
+				assert(m.value == 801000);
+				assert(m.rate > 1000.0 && m.rate < 60000.0);
+			}
+		}
+
+		std::ostringstream os;
+
+		siv::WriteMetricsJSON(os, second);
+
+		std::cout << os.str();
+
+		assert(os.str().find("{\"name\":\"requests\",\"type\":\"counter\",\"value\":800000}") != std::string::npos);
+	}
+
+	// periodic reporting
+	{
+		size_t reports = 0;
+
+		{
+			siv::MetricsReporter reporter([&reports](const siv::MetricsSnapshot& snapshot)
+			{
+				assert(snapshot.metrics.size() == 3);
+
+				++reports;
+			}, std::chrono::milliseconds(5));
+
+			std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		}
+
+		assert(reports >= 2);
+	}
+}
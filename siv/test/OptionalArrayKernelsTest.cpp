@@ -0,0 +1,179 @@
+﻿//------------------------------------------
+//	OptionalArrayKernelsTest.cpp
+//	Copyright (c) 2014 Reputeless
+//	<reputeless@gmail.com>
+//	Distributed under the MIT license.
+//------------------------------------------
+
+# include <iostream>
+# include <cassert>
+# include <cmath>
+# include <random>
+# include <vector>
+# include <siv/OptionalArrayKernels.hpp>
+# include <siv/Profiler.hpp>
+
+# if SIV_HAS_PROPERTY
+#	define ELAPSED(clock) clock.elapsed
+# else
+#	define ELAPSED(clock) clock.elapsed()
+# endif
+
+template <class T>
+void Check(size_t size)
+{
+	std::mt19937 rng(static_cast<unsigned>(size));
+
+	std::uniform_int_distribution<int> dist(-1000, 1000);
+
+	siv::optional_array<T> a;
+
+	std::vector<siv::optional<T>> expected;
+
+	for (size_t i = 0; i < size; ++i)
+	{
+		if (rng() % 4 == 0)
+		{
+			a.push_back(siv::nullopt);
+
+			expected.push_back(siv::nullopt);
+		}
+		else
+		{
+			const T v = static_cast<T>(dist(rng));
+
+			a.push_back(v);
+
+			expected.push_back(v);
+		}
+	}
+
+	T sum = T();
+
+	size_t count = 0;
+
+	siv::optional<T> min, max;
+
+	for (const auto& e : expected)
+	{
+		if (e)
+		{
+			sum += *e;
+
+			++count;
+
+			min = (!min || *e < *min) ? *e : *min;
+
+			max = (!max || *max < *e) ? *e : *max;
+		}
+	}
+
+	// small integers: every summation order is exact
+	assert(siv::sum(a) == sum);
+	assert(siv::count(a) == count);
+	assert(siv::min(a) == min);
+	assert(siv::max(a) == max);
+
+	const siv::optional<double> mean = siv::mean(a);
+
+	assert(count ? (std::fabs(*mean - static_cast<double>(sum) / count) < 1e-9) : !mean);
+
+	const siv::optional_array<T> positive = siv::filter(a, [](T v) { return v > 0; });
+
+	size_t index = 0;
+
+	for (const auto& e : expected)
+	{
+		if (e && *e > 0)
+		{
+			assert(positive[index++] == *e);
+		}
+	}
+
+	assert(positive.size() == index && positive.null_count() == 0);
+
+	const auto doubled = siv::transform(a, [](T v) { return static_cast<double>(v) * 2.0; });
+
+	static_assert(std::is_same<decltype(doubled), const siv::optional_array<double>>::value, "");
+
+	for (size_t i = 0; i < size; ++i)
+	{
+		assert(expected[i] ? (doubled[i] == *expected[i] * 2.0) : !doubled[i]);
+	}
+}
+
+int main()
+{
+# if defined(SIV_OPTIONAL_AVX512)
+	std::cout << "AVX-512\n";
+# elif defined(SIV_OPTIONAL_AVX2)
+	std::cout << "AVX2\n";
+# else
+	std::cout << "scalar\n";
+# endif
+
+	for (size_t size : { 0, 1, 63, 64, 65, 200, 1000 })
+	{
+		Check<double>(size);
+
+		Check<float>(size);
+
+		Check<int>(size);
+	}
+
+	// all null
+	{
+		siv::optional_array<double> a(100);
+
+		assert(siv::sum(a) == 0.0 && !siv::min(a) && !siv::max(a) && !siv::mean(a));
+	}
+
+	// null-aware sum against branching over std::vector<optional<double>>
+	{
+		const size_t n = 1 << 20;
+
+		siv::optional_array<double> a;
+
+		std::vector<siv::optional<double>> v;
+
+		for (size_t i = 0; i < n; ++i)
+		{
+			if (i % 3)
+			{
+				a.push_back(static_cast<double>(i % 100));
+
+				v.push_back(static_cast<double>(i % 100));
+			}
+			else
+			{
+				a.push_back(siv::nullopt);
+
+				v.push_back(siv::nullopt);
+			}
+		}
+
+		siv::MicrosecClock branching;
+
+		double s0 = 0.0;
+
+		for (const auto& o : v)
+		{
+			if (o)
+			{
+				s0 += *o;
+			}
+		}
+
+		const unsigned long long branchingMicrosec = ELAPSED(branching);
+
+		siv::MicrosecClock masked;
+
+		const double s1 = siv::sum(a);
+
+		const unsigned long long maskedMicrosec = ELAPSED(masked);
+
+		std::cout << "vector<optional<double>>: " << branchingMicrosec << "us, optional_array<double>: " << maskedMicrosec << "us\n";
+
+		assert(s0 == s1);
+	}
+}
@@ -0,0 +1,127 @@
+﻿//------------------------------------------
+//	OptionalArrayTest.cpp
+//	Copyright (c) 2014 Reputeless
+//	<reputeless@gmail.com>
+//	Distributed under the MIT license.
+//------------------------------------------
+
+# include <iostream>
+# include <cassert>
+# include <vector>
+# include <siv/OptionalArray.hpp>
+
+int main()
+{
+	// element proxies
+	{
+		siv::optional_array<double> a = { 1.0, siv::nullopt, 3.0 };
+
+		assert(a.size() == 3);
+		assert(a[0] && *a[0] == 1.0);
+		assert(!a[1] && a[1] == siv::nullopt);
+		assert(a[1].value_or(-1.0) == -1.0);
+		assert(a[2] == 3.0 && a[2] != 1.0);
+
+		a[1] = 2.0;
+		a[0] = siv::nullopt;
+		a[2] = siv::optional<double>();
+
+		assert(!a[0] && a[1] == 2.0 && !a[2]);
+		assert(a.values()[0] == 0.0);
+
+		a[0] = a[1];
+
+		assert(a[0] == 2.0);
+
+		const siv::optional<double> o = a[0];
+
+		assert(o == 2.0);
+
+		try
+		{
+			a[2].value();
+
+			assert(false);
+		}
+		catch (const siv::bad_optional_access&)
+		{
+
+		}
+
+		const siv::optional_array<double>& c = a;
+
+		assert(c[1] == 2.0 && !c[2]);
+	}
+
+	// bulk append, set_null and counting across word boundaries
+	{
+		siv::optional_array<int> a;
+
+		a.append_null(3);
+
+		std::vector<int> values(200);
+
+		for (int i = 0; i < 200; ++i)
+		{
+			values[i] = i + 1;
+		}
+
+		a.append(values.data(), values.size());
+
+		assert(a.size() == 203);
+		assert(a.null_count() == 3);
+		assert(a.validity_word_count() == 4);
+		assert(a[66] == 64);
+
+		a.set_null(10, 100);
+
+		assert(a.null_count() == 103);
+		assert(!a[10] && !a[109] && a[110] == 108 && a[9] == 7);
+		assert(a.values()[50] == 0);
+
+		a.resize(100);
+
+		assert(a.size() == 100 && a.null_count() == 93);
+
+		a.resize(130);
+
+		assert(a.null_count() == 123 && !a[129]);
+	}
+
+	// append with a validity bitmap at an unaligned offset
+	{
+		siv::optional_array<float> a;
+
+		a.push_back(1.0f);
+		a.push_back(siv::nullopt);
+		a.push_back(siv::optional<float>(3.0f));
+
+		std::vector<float> values(100, 5.0f);
+
+		// every third value is null
+		std::uint64_t validity[2] = {};
+
+		for (int i = 0; i < 100; ++i)
+		{
+			if (i % 3)
+			{
+				validity[i / 64] |= 1ull << (i % 64);
+			}
+		}
+
+		a.append(values.data(), validity, values.size());
+
+		assert(a.size() == 103);
+		assert(a.null_count() == 1 + 34);
+
+		for (int i = 0; i < 100; ++i)
+		{
+			assert(a.is_valid(3 + i) == (i % 3 != 0));
+			assert(a.values()[3 + i] == (i % 3 ? 5.0f : 0.0f));
+		}
+
+		std::cout << a.size() << " elements, " << a.null_count() << " null, "
+			<< a.size() * sizeof(float) + a.validity_word_count() * 8 << " bytes (optional<float>: "
+			<< a.size() * sizeof(siv::optional<float>) << " bytes)\n";
+	}
+}
@@ -412,6 +412,98 @@ void Test14()
 	static_assert(__alignof(siv::optional<Bb>) == __alignof(Bb), "");
 }
 
+// trivial copies
+void Test15()
+{
+	static_assert(siv::detail::is_trivially_copyable<siv::optional<int>>::value, "");
+	static_assert(siv::detail::is_trivially_copyable<siv::optional<double>>::value, "");
+	static_assert(std::is_trivially_destructible<siv::optional<double>>::value, "");
+	static_assert(!siv::detail::is_trivially_copyable<siv::optional<std::string>>::value, "");
+	static_assert(!std::is_trivially_destructible<siv::optional<std::string>>::value, "");
+
+	std::vector<siv::optional<double>> v(1000);
+
+	v[10] = 1.5;
+
+	std::vector<siv::optional<double>> w = v;
+
+	assert(w[10] == 1.5);
+	assert(!w[11]);
+
+	siv::optional<std::string> a{ "a" }, b{ "b" }, n;
+
+	a = b;
+	assert(a == std::string("b"));
+	assert(b == std::string("b"));
+
+	a = n;
+	assert(!a);
+
+	n = std::move(b);
+	assert(n == std::string("b"));
+
+	siv::optional<std::string> c{ n };
+	assert(c == std::string("b"));
+}
+
+# ifdef SIV_CPP11_IMPLEMENTED
+
+struct Range
+{
+	int first, last;
+
+	constexpr Range(int f, int l)
+		: first(f), last(l) {}
+};
+
+// lookup tables are constants: no static initialization
+constexpr siv::optional<int> digitTable[] = { siv::nullopt, 1, 2, siv::nullopt, 4 };
+
+constexpr siv::optional<Range> rangeTable[] = { siv::optional<Range>(siv::in_place, 0, 10), siv::nullopt };
+
+# endif
+
+// constant expressions
+void Test16()
+{
+# ifdef SIV_CPP11_IMPLEMENTED
+
+	static_assert(!digitTable[0], "");
+	static_assert(digitTable[1] && *digitTable[1] == 1, "");
+	static_assert(digitTable[2].value() == 2, "");
+	static_assert(digitTable[3].value_or(-1) == -1, "");
+	static_assert(digitTable[4] == 4 && digitTable[3] == siv::nullopt, "");
+	static_assert(digitTable[1] < digitTable[2] && digitTable[0] < digitTable[1], "");
+	static_assert(digitTable[1] != digitTable[2] && digitTable[0] == digitTable[3], "");
+	static_assert(rangeTable[0]->last == 10 && !rangeTable[1], "");
+	static_assert(siv::make_optional(3) == 3, "");
+
+	constexpr siv::optional<const double> half{ 0.5 };
+	static_assert(*half == 0.5, "");
+
+	// still modifiable at run time
+	siv::optional<int> a = digitTable[2];
+	a.emplace(5);
+	assert(a == 5);
+	a = siv::nullopt;
+	assert(!a);
+
+	bool thrown = false;
+
+	try
+	{
+		digitTable[0].value();
+	}
+	catch (const siv::bad_optional_access&)
+	{
+		thrown = true;
+	}
+
+	assert(thrown);
+
+# endif
+}
+
 int main()
 {
 	{
@@ -495,4 +587,8 @@ int main()
 	Test13();
 
 	Test14();
+
+	Test15();
+
+	Test16();
 }
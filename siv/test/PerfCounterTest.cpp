@@ -0,0 +1,74 @@
+﻿//------------------------------------------
+//	PerfCounterTest.cpp
+//	Copyright (c) 2014 Reputeless
+//	<reputeless@gmail.com>
+//	Distributed under the MIT license.
+//------------------------------------------
+
+# include <iostream>
+# include <cassert>
+# include <vector>
+# include <siv/PerfCounter.hpp>
+
+volatile unsigned long long g_sink;
+
+int main()
+{
+	const siv::PerfCounterGroup& group = siv::GetThreadPerfCounters();
+
+	if (!group.available())
+	{
+		std::cout << "perf_event_open is not permitted: counters read as zero\n";
+	}
+	else
+	{
+		std::cout << "rdpmc: " << (group.usesRDPMC() ? "yes" : "no") << '\n';
+	}
+
+	siv::PerfCounterReport sequential, random;
+
+	std::vector<unsigned> data(1 << 22);
+
+	for (size_t i = 0; i < data.size(); ++i)
+	{
+		data[i] = static_cast<unsigned>((i * 2654435761u) & (data.size() - 1));
+	}
+
+	{
+		siv::ScopedPerfCounters scope(sequential);
+
+		unsigned long long sum = 0;
+
+		for (size_t i = 0; i < data.size(); ++i)
+		{
+			sum += data[i];
+		}
+
+		g_sink = sum;
+	}
+
+	{
+		siv::ScopedPerfCounters scope(random);
+
+		unsigned long long sum = 0;
+
+		for (size_t i = 0; i < data.size(); ++i)
+		{
+			sum += data[data[i]];
+		}
+
+		g_sink = sum;
+	}
+
+	std::cout << "sequential: " << sequential << '\n';
+	std::cout << "random:     " << random << '\n';
+
+	assert(sequential.nanosec > 0);
+	assert(random.nanosec > 0);
+
+	if (group.available(siv::PerfEvent::Instructions))
+	{
+		assert(sequential.counters[siv::PerfEvent::Instructions] > data.size());
+		assert(sequential.ipc() > 0.0);
+	}
+}
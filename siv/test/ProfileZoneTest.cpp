@@ -0,0 +1,199 @@
+﻿//------------------------------------------
+//	ProfileZoneTest.cpp
+//	Copyright (c) 2014 Reputeless
+//	<reputeless@gmail.com>
+//	Distributed under the MIT license.
+//------------------------------------------
+
+# include <iostream>
+# include <cassert>
+# include <vector>
+# include <string>
+# include <thread>
+# include <siv/ProfileZone.hpp>
+
+volatile unsigned long long g_sink;
+
+void Leaf()
+{
+	SIV_PROFILE_ZONE("Leaf");
+
+	for (int i = 0; i < 100; ++i)
+	{
+		g_sink = g_sink + i;
+	}
+}
+
+void Inner()
+{
+	SIV_PROFILE_ZONE("Inner");
+
+	Leaf();
+
+	Leaf();
+}
+
+void Outer(int n)
+{
+	SIV_PROFILE_ZONE("Outer");
+
+	for (int i = 0; i < n; ++i)
+	{
+		Inner();
+	}
+}
+
+const siv::ZoneNode* Find(const siv::ZoneNode& node, const char* name)
+{
+	for (const auto& child : node.children)
+	{
+		if (std::strcmp(child.name, name) == 0)
+		{
+			return &child;
+		}
+	}
+
+	return nullptr;
+}
+
+int main()
+{
+	siv::ZoneCollector& collector = siv::GetZoneCollector();
+
+	collector.start(std::chrono::milliseconds(1));
+
+	const int threadCount = 4;
+
+	{
+		std::vector<std::thread> threads;
+
+		for (int t = 0; t < threadCount; ++t)
+		{
+			threads.emplace_back([]()
+			{
+				for (int i = 0; i < 100; ++i)
+				{
+					Outer(10);
+				}
+			});
+		}
+
+		for (auto& thread : threads)
+		{
+			thread.join();
+		}
+	}
+
+	collector.stop();
+
+	const auto trees = collector.getCallTrees();
+
+	assert(trees.size() == threadCount);
+
+	for (const auto& tree : trees)
+	{
+		siv::WriteCallTree(std::cout, tree);
+
+		assert(tree.dropped == 0);
+
+		const siv::ZoneNode* outer = Find(tree.root, "Outer");
+		assert(outer && outer->calls == 100);
+
+		const siv::ZoneNode* inner = Find(*outer, "Inner");
+		assert(inner && inner->calls == 1000);
+
+		const siv::ZoneNode* leaf = Find(*inner, "Leaf");
+		assert(leaf && leaf->calls == 2000);
+		assert(leaf->totalTicks <= inner->totalTicks);
+		assert(inner->totalTicks <= outer->totalTicks);
+	}
+
+	// CPU accounting: a spinning zone is on-CPU, a sleeping one is off-CPU
+	{
+		collector.start(std::chrono::milliseconds(1));
+
+		for (int i = 0; i < 3; ++i)
+		{
+			{
+				SIV_PROFILE_ZONE_CPU("Spin");
+
+				siv::NanosecClock spin;
+
+# if SIV_HAS_PROPERTY
+				while (spin.elapsed < 2000000ULL)
+# else
+				while (spin.elapsed() < 2000000ULL)
+# endif
+				{
+					g_sink = g_sink + 1;
+				}
+			}
+
+			{
+				SIV_PROFILE_ZONE_CPU("Sleep");
+
+				std::this_thread::sleep_for(std::chrono::milliseconds(2));
+			}
+		}
+
+		collector.stop();
+
+		const auto totals = siv::GetZoneCpuAccounting().getTotals();
+
+		siv::WriteZoneCpuReport(std::cout, totals);
+
+		assert(totals.size() == 2);
+
+		assert(std::string(totals[0].name) == "Spin" && totals[0].calls == 3);
+		assert(totals[0].time.cpuNanosec >= totals[0].time.offCpuNanosec());
+
+		assert(std::string(totals[1].name) == "Sleep" && totals[1].calls == 3);
+		assert(totals[1].time.offCpuNanosec() >= 6000000ULL);
+		assert(totals[1].time.cpuNanosec < totals[1].time.offCpuNanosec());
+		assert(totals[1].time.voluntarySwitches >= 3);
+
+		siv::GetZoneCpuAccounting().clear();
+	}
+
+	// overhead of an empty zone
+	{
+		const int n = 1000000;
+
+		collector.start(std::chrono::milliseconds(1));
+
+		siv::NanosecClock clock;
+
+		for (int i = 0; i < n; ++i)
+		{
+			SIV_PROFILE_ZONE("Empty");
+		}
+
+# if SIV_HAS_PROPERTY
+		const unsigned long long elapsed = clock.elapsed;
+# else
+		const unsigned long long elapsed = clock.elapsed();
+# endif
+
+		collector.stop();
+
+		std::cout << "zone overhead: " << static_cast<double>(elapsed) / n << "ns\n";
+
+		// the floor: the two timestamps every zone takes
+		siv::NanosecClock tscClock;
+
+		for (int i = 0; i < n; ++i)
+		{
+			siv::detail::ReadTSC();
+
+			siv::detail::ReadTSC();
+		}
+
+# if SIV_HAS_PROPERTY
+		const unsigned long long tscElapsed = tscClock.elapsed;
+# else
+		const unsigned long long tscElapsed = tscClock.elapsed();
+# endif
+
+		std::cout << "timestamp pair: " << static_cast<double>(tscElapsed) / n << "ns\n";
+	}
+}
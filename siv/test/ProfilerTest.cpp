@@ -6,38 +6,224 @@
 //------------------------------------------
 
 # include <iostream>
-# define  NOMINMAX
-# define  STRICT
-# define  WIN32_LEAN_AND_MEAN
-# include <Windows.h>
+# include <cassert>
+# include <thread>
+# include <chrono>
 # include <siv/Profiler.hpp>
 
+# if SIV_HAS_PROPERTY
+#	define ELAPSED(clock) clock.elapsed
+# else
+#	define ELAPSED(clock) clock.elapsed()
+# endif
+
+void Sleep100ms()
+{
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+}
+
 int main()
 {
 	for (int i = 0; i < 5; ++i)
 	{
 		siv::MillisecClock ms;
 
-		::Sleep(100);
+		Sleep100ms();
 
-		std::cout << ms.elapsed << "ms\n";
+		std::cout << ELAPSED(ms) << "ms\n";
 	}
 
 	for (int i = 0; i < 5; ++i)
 	{
 		siv::MicrosecClock us;
 
-		::Sleep(100);
+		Sleep100ms();
+
+		std::cout << ELAPSED(us) << "μs\n";
+	}
+
+	for (int i = 0; i < 5; ++i)
+	{
+		siv::NanosecClock ns;
+
+		Sleep100ms();
 
-		std::cout << us.elapsed << "μs\n";
+		std::cout << ELAPSED(ns) << "ns\n";
 	}
 
 	for (int i = 0; i < 5; ++i)
 	{
 		siv::RDTSCClock cycles;
 
-		::Sleep(100);
+		Sleep100ms();
+
+		std::cout << ELAPSED(cycles) << "cycles\n";
+	}
+
+	{
+		assert(siv::detail::MulShift32(0, 1ULL << 32) == 0);
+		assert(siv::detail::MulShift32(123456789ULL, 1ULL << 32) == 123456789ULL);
+		assert(siv::detail::MulShift32(1ULL << 40, 3ULL << 31) == (3ULL << 39));
+
+		const unsigned long long ns0 = siv::GetNanosec();
+
+		Sleep100ms();
+
+		const unsigned long long ns1 = siv::GetNanosec();
+
+		assert(ns1 - ns0 >= 90000000ULL);
+		assert(ns1 - ns0 < 1000000000ULL);
+
+		std::cout << "TSC frequency: " << siv::GetTSCFrequency().frequency << "Hz\n";
+	}
+
+	{
+		const siv::TSCInfo& info = siv::CheckTSCSynchronization();
+
+		std::cout << "invariant TSC: " << info.invariant << ", rdtscp: " << info.rdtscp
+			<< ", synchronized: " << info.synchronized << " (" << info.checkedCores << " cores checked, max warp "
+			<< info.maxWarp << " cycles)\n";
+
+		for (int i = 0; i < 5; ++i)
+		{
+			siv::SerializedRDTSCClock cycles;
+
+			Sleep100ms();
+
+			std::cout << ELAPSED(cycles) << "cycles (serialized)\n";
+		}
+
+		for (int i = 0; i < 5; ++i)
+		{
+			siv::RDTSCPClock cycles;
+
+			Sleep100ms();
+
+			const siv::TSCInterval interval = ELAPSED(cycles);
+
+			assert(interval.ticks > 0);
+			assert(interval.migrated == (interval.startCore != interval.endCore));
+			assert(!interval.reliable || info.invariant);
+
+			std::cout << interval.ticks << "cycles, core " << interval.startCore << " -> " << interval.endCore
+				<< (interval.reliable ? "" : " (unreliable)") << '\n';
+		}
+	}
+
+	{
+		siv::CalibrateClockOverheads();
+
+		const siv::ClockOverhead rdtsc = siv::GetClockOverhead<siv::RDTSCClock>();
+		const siv::ClockOverhead serialized = siv::GetClockOverhead<siv::SerializedRDTSCClock>();
+		const siv::ClockOverhead nanosec = siv::GetClockOverhead<siv::NanosecClock>();
+
+		std::cout << "overhead RDTSCClock: " << rdtsc.min << " / " << rdtsc.median << " cycles (min / median)\n";
+		std::cout << "overhead SerializedRDTSCClock: " << serialized.min << " / " << serialized.median << " cycles\n";
+		std::cout << "overhead NanosecClock: " << nanosec.min << " / " << nanosec.median << " ns\n";
+
+		assert(rdtsc.min <= rdtsc.median);
+		assert(!siv::IsClockOverheadSubtractionEnabled());
+
+		unsigned long long raw = ~0ULL, corrected = ~0ULL;
+
+		for (int i = 0; i < 1000; ++i)
+		{
+			siv::RDTSCClock empty;
+
+			raw = std::min<unsigned long long>(raw, ELAPSED(empty));
+		}
+
+		siv::SetClockOverheadSubtraction(true);
+
+		for (int i = 0; i < 1000; ++i)
+		{
+			siv::RDTSCClock empty;
+
+			corrected = std::min<unsigned long long>(corrected, ELAPSED(empty));
+		}
+
+		siv::SetClockOverheadSubtraction(false);
+
+		std::cout << "empty RDTSCClock scope: " << raw << " cycles, " << corrected << " cycles corrected\n";
+
+		assert(corrected <= raw);
+	}
+
+	// busy: on the CPU the whole time
+	{
+		siv::ThreadCpuClock clock;
+
+		const auto until = std::chrono::steady_clock::now() + std::chrono::milliseconds(50);
+
+		while (std::chrono::steady_clock::now() < until);
+
+		const siv::ThreadCpuTime time = ELAPSED(clock);
+
+		std::cout << "busy: " << time.cpuNanosec / 1000 << "us on CPU, " << time.offCpuNanosec() / 1000 << "us off CPU, "
+			<< time.voluntarySwitches << " / " << time.involuntarySwitches << " switches\n";
+
+		assert(time.cpuNanosec > 0);
+		assert(time.cpuNanosec <= time.wallNanosec + 20000000ULL);
+	}
+
+	// sleeping: off the CPU, blocked voluntarily
+	{
+		siv::ThreadCpuTime total;
+
+		for (int i = 0; i < 2; ++i)
+		{
+			siv::ScopedThreadCpuTime scoped(total);
+
+			std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		}
+
+		std::cout << "sleep: " << total.cpuNanosec / 1000 << "us on CPU, " << total.offCpuNanosec() / 1000 << "us off CPU, "
+			<< total.voluntarySwitches << " / " << total.involuntarySwitches << " switches\n";
+
+		assert(total.wallNanosec >= 40000000ULL);
+		assert(total.offCpuNanosec() >= 30000000ULL);
+
+# if defined(__linux__)
+
+		assert(total.voluntarySwitches >= 2);
+
+# endif
+	}
+
+	// coarse clock
+	{
+		assert(siv::GetCoarseClockTicker().tickMicrosec() == 0);
+
+		siv::StartCoarseClock(1000);
+
+		assert(siv::GetCoarseClockTicker().tickMicrosec() == 1000);
+
+		siv::CoarseClock clock;
+
+		unsigned long long last = siv::CoarseClock::Now(), maxLag = 0;
+
+		const unsigned long long until = siv::GetMicrosec() + 50000;
+
+		while (siv::GetMicrosec() < until)
+		{
+			const unsigned long long now = siv::CoarseClock::Now();
+
+			assert(now >= last);
+
+			maxLag = std::max(maxLag, siv::GetMicrosec() - now);
+
+			last = now;
+
+			std::this_thread::yield();
+		}
+
+		std::cout << "coarse: " << ELAPSED(clock) << "ms, " << maxLag << "us max lag\n";
+
+		assert(ELAPSED(clock) >= 40 && ELAPSED(clock) <= 60);
+
+		siv::StopCoarseClock();
 
-		std::cout << cycles.elapsed << "cycles\n";
+		assert(siv::GetCoarseClockTicker().tickMicrosec() == 0);
+		assert(siv::CoarseClock::Now() >= last);
 	}
 }
@@ -9,6 +9,12 @@
 # include <cassert>
 # include <siv/PropertyMacro.hpp>
 
+# if SIV_HAS_PROPERTY
+#	define GET(obj, name) obj.name
+# else
+#	define GET(obj, name) obj.name()
+# endif
+
 class Size
 {
 private:
@@ -44,23 +50,23 @@ int main()
 {
 	Size s;
 
-	assert(s.width == 0);
+	assert(GET(s, width) == 0);
 
-	assert(s.height == 0);
+	assert(GET(s, height) == 0);
 
 	s.setWidth(100);
 
 	s.setHeight(200);
 
-	assert(s.width == 100);
+	assert(GET(s, width) == 100);
 
-	assert(s.height == 200);
+	assert(GET(s, height) == 200);
 
-	s.setWidth(s.width * 2);
+	s.setWidth(GET(s, width) * 2);
 
-	s.setHeight(s.height * 2);
+	s.setHeight(GET(s, height) * 2);
 
-	assert(s.width == 200);
+	assert(GET(s, width) == 200);
 
-	assert(s.height == 400);
+	assert(GET(s, height) == 400);
 }
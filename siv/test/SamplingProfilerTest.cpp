@@ -0,0 +1,129 @@
+﻿//------------------------------------------
+//	SamplingProfilerTest.cpp
+//	Copyright (c) 2014 Reputeless
+//	<reputeless@gmail.com>
+//	Distributed under the MIT license.
+//------------------------------------------
+
+# include <iostream>
+# include <cassert>
+# include <thread>
+# include <vector>
+# include <siv/SamplingProfiler.hpp>
+# include <siv/Profiler.hpp>
+
+volatile unsigned long long g_sink;
+
+__attribute__((noinline)) void Spin(unsigned long long nanosec)
+{
+	const unsigned long long end = siv::GetNanosec() + nanosec;
+
+	while (siv::GetNanosec() < end)
+	{
+		g_sink = g_sink + 1;
+	}
+}
+
+__attribute__((noinline)) void Heavy()
+{
+	Spin(300000000ULL);
+}
+
+__attribute__((noinline)) void Light()
+{
+	Spin(100000000ULL);
+}
+
+int main()
+{
+	siv::SamplingProfiler& profiler = siv::GetSamplingProfiler();
+
+	profiler.registerCurrentThread();
+
+	const bool started = profiler.start(1000);
+
+	assert(started);
+
+	std::thread worker([&profiler]()
+	{
+		profiler.registerCurrentThread();
+
+		Light();
+	});
+
+	// never registers: sampled by the process-wide timer
+	std::thread unregistered([]()
+	{
+		Light();
+	});
+
+	Heavy();
+
+	worker.join();
+
+	unregistered.join();
+
+	profiler.stop();
+
+	const auto samples = profiler.getSamples();
+
+	std::cout << samples.size() << " samples, " << profiler.dropped() << " dropped\n";
+
+	siv::WriteHotspots(std::cout, samples, 10);
+
+	siv::WriteSampledStacks(std::cout, samples);
+
+	assert(!samples.empty());
+
+	size_t mainThread = 0, workerThread = 0, unregisteredThread = 0;
+
+	for (const auto& sample : samples)
+	{
+		assert(sample.depth >= 1 && sample.depth <= SIV_SAMPLING_MAX_DEPTH);
+
+		if (sample.threadIndex == siv::SamplingProfiler::UnregisteredThread)
+		{
+			// no stack bounds: only the interrupted instruction
+			assert(sample.depth == 1);
+
+			++unregisteredThread;
+		}
+		else
+		{
+			(sample.threadIndex == 0 ? mainThread : workerThread) += 1;
+		}
+	}
+
+	std::cout << mainThread << " / " << workerThread << " / " << unregisteredThread << " samples (main / worker / unregistered)\n";
+
+	// CPU-time timers: each thread is sampled in proportion to the CPU it used
+	assert(mainThread > workerThread);
+
+	assert(unregisteredThread > 0);
+
+	// recursion: three frames in one function, at different addresses, count once per sample
+	{
+		char* const function = static_cast<char*>(::dlsym(RTLD_DEFAULT, "qsort"));
+
+		assert(function);
+
+		std::vector<siv::ProfileSample> recursive(5);
+
+		for (auto& sample : recursive)
+		{
+			sample.threadIndex = 0;
+			sample.depth = 3;
+			sample.frames[0] = function + 1;
+			sample.frames[1] = function + 2;
+			sample.frames[2] = function + 3;
+		}
+
+		siv::SampleSymbolizer symbolizer;
+
+		const auto hotspots = siv::MakeHotspots(recursive, symbolizer);
+
+		assert(hotspots.size() == 1);
+		assert(hotspots[0].selfSamples == 5);
+		assert(hotspots[0].totalSamples == 5);
+	}
+}
@@ -0,0 +1,136 @@
+﻿//------------------------------------------
+//	TelemetryRingTest.cpp
+//	Copyright (c) 2014 Reputeless
+//	<reputeless@gmail.com>
+//	Distributed under the MIT license.
+//------------------------------------------
+
+# include <iostream>
+# include <sstream>
+# include <cassert>
+# include <thread>
+# include <siv/TelemetryRing.hpp>
+
+void Hot()
+{
+	SIV_PROFILE_ZONE("Hot");
+
+	std::this_thread::sleep_for(std::chrono::microseconds(100));
+}
+
+void Cold()
+{
+	SIV_PROFILE_ZONE("Cold");
+}
+
+int main()
+{
+	siv::TelemetryPublisher publisher(siv::GetTelemetryName(), 4, 16);
+
+	assert(publisher.isOpen());
+
+	siv::GetZoneCollector().addSink(&publisher);
+
+	siv::TelemetryReader reader(siv::GetTelemetryName());
+
+	assert(reader.isOpen());
+	assert(reader.processID() == static_cast<unsigned>(::getpid()));
+	assert(reader.readZones().empty());
+
+	for (int i = 0; i < 10; ++i)
+	{
+		Hot();
+
+		Cold();
+
+		Cold();
+	}
+
+	siv::GetZoneCollector().collect();
+
+	const auto zones = reader.readZones();
+
+	assert(zones.size() == 2);
+	assert(zones[0].name == "Hot" && zones[0].count == 10);
+	assert(zones[0].totalNanosec >= 10 * 100000ULL);
+	assert(zones[0].maxNanosec >= 100000ULL);
+	assert(zones[1].name == "Cold" && zones[1].count == 20);
+
+	// the ring keeps the 16 most recent events
+	const auto events = reader.readEvents(100);
+
+	assert(events.size() == 16);
+	assert(events.back().zone == "Cold");
+
+	for (size_t i = 1; i < events.size(); ++i)
+	{
+		assert(events[i - 1].endNanosec <= events[i].endNanosec);
+	}
+
+	assert(reader.readEvents(3).size() == 3);
+
+	// zones beyond the capacity are not published
+	{
+		SIV_PROFILE_ZONE("Third");
+	}
+
+	{
+		SIV_PROFILE_ZONE("Fourth");
+	}
+
+	{
+		SIV_PROFILE_ZONE("Fifth");
+	}
+
+	Hot();
+
+	siv::GetZoneCollector().collect();
+
+	const auto later = reader.readZones();
+
+	assert(later.size() == 4);
+
+	const auto delta = siv::MakeTelemetryDelta(zones, later);
+
+	assert(delta.front().name == "Hot" && delta.front().count == 1);
+
+	siv::WriteTelemetryTop(std::cout, delta, 10, 1.0);
+
+	// a publisher that died mid-update leaves the sequence odd: the zone is reported stale instead of hanging
+	{
+		const int fd = ::shm_open(siv::GetTelemetryName().c_str(), O_RDWR, 0);
+
+		assert(fd != -1);
+
+		struct stat st;
+
+		::fstat(fd, &st);
+
+		void* base = ::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+		::close(fd);
+
+		assert(base != MAP_FAILED);
+
+		std::atomic<std::uint32_t>& sequence = siv::detail::TelemetryZones(base)[0].sequence;
+
+		const std::uint32_t saved = sequence.load();
+
+		sequence.store(saved | 1);
+
+		const auto torn = reader.readZones();
+
+		assert(torn.size() == 4);
+		assert(torn[0].stale && !torn[1].stale);
+
+		sequence.store(saved);
+
+		assert(!reader.readZones()[0].stale);
+
+		::munmap(base, static_cast<size_t>(st.st_size));
+	}
+
+	siv::GetZoneCollector().removeSink(&publisher);
+
+	assert(!siv::TelemetryReader("/siv-telemetry-missing").isOpen());
+}
@@ -0,0 +1,105 @@
+﻿//------------------------------------------
+//	TraceExportTest.cpp
+//	Copyright (c) 2014 Reputeless
+//	<reputeless@gmail.com>
+//	Distributed under the MIT license.
+//------------------------------------------
+
+# include <iostream>
+# include <sstream>
+# include <fstream>
+# include <cassert>
+# include <thread>
+# include <siv/TraceExport.hpp>
+
+void Leaf()
+{
+	SIV_PROFILE_ZONE("Leaf");
+
+	std::this_thread::sleep_for(std::chrono::microseconds(50));
+}
+
+void Outer()
+{
+	SIV_PROFILE_ZONE("Outer \"quoted\"");
+
+	Leaf();
+
+	Leaf();
+}
+
+size_t Count(const std::string& s, const std::string& pattern)
+{
+	size_t count = 0;
+
+	for (size_t pos = s.find(pattern); pos != std::string::npos; pos = s.find(pattern, pos + 1))
+	{
+		++count;
+	}
+
+	return count;
+}
+
+int main()
+{
+	// chunked output
+	{
+		std::ostringstream os;
+
+		{
+			siv::TraceChunkWriter writer(os, 4);
+
+			writer.write("0123456789");
+			writer.writeUInt(42);
+			writer.writeMicrosec(1234567);
+			writer.writeJSONString("a\"b\\c\n");
+		}
+
+		assert(os.str() == "0123456789421234.567\"a\\\"b\\\\c\\u000a\"");
+	}
+
+	std::ostringstream chrome, collapsed;
+
+	{
+		siv::ChromeTraceWriter chromeWriter(chrome);
+		siv::CollapsedStackWriter collapsedWriter(collapsed);
+
+		siv::ZoneCollector& collector = siv::GetZoneCollector();
+
+		collector.addSink(&chromeWriter);
+		collector.addSink(&collapsedWriter);
+
+		std::thread([]()
+		{
+			for (int i = 0; i < 10; ++i)
+			{
+				Outer();
+			}
+		}).join();
+
+		collector.collect();
+
+		collector.removeSink(&chromeWriter);
+		collector.removeSink(&collapsedWriter);
+
+		chromeWriter.finish();
+		collapsedWriter.flush();
+	}
+
+	const std::string json = chrome.str();
+
+	std::cout << json.substr(0, 400) << "...\n";
+
+	assert(json.find("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[") == 0);
+	assert(json.substr(json.size() - 4) == "\n]}\n");
+	assert(Count(json, "\"ph\":\"X\"") == 30);
+	assert(Count(json, "\"ph\":\"M\"") == 1);
+	assert(Count(json, "\"name\":\"Outer \\\"quoted\\\"\"") == 10);
+
+	const std::string stacks = collapsed.str();
+
+	std::cout << stacks.substr(0, 200) << "...\n";
+
+	assert(Count(stacks, "Outer \"quoted\";Leaf ") == 10);
+	assert(Count(stacks, "\n") == 20);
+}